@@ -0,0 +1,275 @@
+/* allocators for the containers. the standard one is malloc, realloc and
+ * free. an arena hands out memory by bumping a pointer through large
+ * chunks and releases it all at once, a pool keeps a free list of blocks
+ * of one size. arenas and pools are not thread safe, give each thread
+ * its own. */
+
+#include "allocator.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+/* every allocation is aligned for any type */
+#define ALLOC_ALIGN _Alignof(max_align_t)
+#define ARENA_MIN_CHUNK 4096
+/* an arena allocation is preceded by its size, padded to ALLOC_ALIGN */
+#define ARENA_HDR aalign(sizeof(size_t))
+
+
+static size_t aalign(const size_t n) {
+  return (n + ALLOC_ALIGN - 1) / ALLOC_ALIGN * ALLOC_ALIGN;
+}
+
+
+static unsigned char *cdata(Chunk_ *const c) {
+  return (unsigned char *)c + aalign(sizeof(Chunk_));
+}
+
+
+/* a chunk with cap usable bytes pushed in front of *chunks */
+static Chunk_ *cpush(Chunk_ **const chunks, const size_t cap) {
+  if (cap > SIZE_MAX - aalign(sizeof(Chunk_))) {
+    return NULL;
+  }
+  Chunk_ *c = (Chunk_ *)malloc(aalign(sizeof(Chunk_)) + cap);
+  if (c == NULL) {
+    return NULL;
+  }
+  c->next = *chunks;
+  c->cap = cap;
+  c->used = 0;
+  *chunks = c;
+  return c;
+}
+
+
+static void cfree(Chunk_ *c) {
+  while (c != NULL) {
+    Chunk_ *next = c->next;
+    free(c);
+    c = next;
+  }
+}
+
+
+/*-- standard allocator --*/
+
+static void *stdalloc(void *ctx, size_t n) {
+  (void)ctx;
+  return malloc(n);
+}
+
+
+static void *stdrealloc(void *ctx, void *p, size_t n) {
+  (void)ctx;
+  return realloc(p, n);
+}
+
+
+static void stdfree(void *ctx, void *p) {
+  (void)ctx;
+  free(p);
+}
+
+
+const CADT_Allocator CADT_std_allocator = {
+    .alloc = stdalloc,
+    .realloc = stdrealloc,
+    .free = stdfree,
+    .ctx = NULL,
+};
+
+
+/*-- arena --*/
+
+static size_t *asize(void *p) {
+  return (size_t *)(void *)((unsigned char *)p - ARENA_HDR);
+}
+
+
+static void *aalloc(void *ctx, size_t n) {
+  CADT_Arena *a = (CADT_Arena *)ctx;
+  if (n > SIZE_MAX / 2) {
+    return NULL;
+  }
+  const size_t need = ARENA_HDR + aalign(n);
+  Chunk_ *c = a->chunks;
+  if (c == NULL || c->cap - c->used < need) {
+    c = cpush(&a->chunks, need > a->chunksz ? need : a->chunksz);
+    if (c == NULL) {
+      return NULL;
+    }
+  }
+  unsigned char *p = cdata(c) + c->used + ARENA_HDR;
+  c->used += need;
+  *asize(p) = n;
+  a->last = p;
+  return p;
+}
+
+
+/* the latest allocation is resized in place when the chunk has room,
+ * any other one is copied to a new allocation */
+static void *arealloc(void *ctx, void *p, size_t n) {
+  CADT_Arena *a = (CADT_Arena *)ctx;
+  if (p == NULL) {
+    return aalloc(ctx, n);
+  }
+  const size_t old = *asize(p);
+  if (p == a->last && n <= SIZE_MAX / 2) {
+    Chunk_ *c = a->chunks;
+    const size_t oldsz = aalign(old);
+    const size_t newsz = aalign(n);
+    if (newsz <= oldsz || c->cap - c->used >= newsz - oldsz) {
+      c->used = c->used - oldsz + newsz;
+      *asize(p) = n;
+      return p;
+    }
+  }
+  if (n <= old) {
+    return p;
+  }
+  void *q = aalloc(ctx, n);
+  if (q != NULL) {
+    memcpy(q, p, old);
+  }
+  return q;
+}
+
+
+/* only the latest allocation is given back, the rest waits for a reset */
+static void afree(void *ctx, void *p) {
+  CADT_Arena *a = (CADT_Arena *)ctx;
+  if (p == a->last) {
+    a->chunks->used -= ARENA_HDR + aalign(*asize(p));
+    a->last = NULL;
+  }
+}
+
+
+/*-- pool --*/
+
+static void *palloc(void *ctx, size_t n) {
+  CADT_Pool *p = (CADT_Pool *)ctx;
+  if (n > p->blocksz) {
+    return NULL;
+  }
+  if (p->freelist != NULL) {
+    void *b = p->freelist;
+    memcpy(&p->freelist, b, sizeof(void *));
+    return b;
+  }
+  if (p->chunks == NULL || p->carved == p->perchunk) {
+    if (cpush(&p->chunks, p->blocksz * p->perchunk) == NULL) {
+      return NULL;
+    }
+    p->carved = 0;
+  }
+  return cdata(p->chunks) + p->blocksz * p->carved++;
+}
+
+
+/* blocks never grow, a request that does not fit one fails */
+static void *prealloc(void *ctx, void *b, size_t n) {
+  CADT_Pool *p = (CADT_Pool *)ctx;
+  if (b == NULL) {
+    return palloc(ctx, n);
+  }
+  return n <= p->blocksz ? b : NULL;
+}
+
+
+static void pfree(void *ctx, void *b) {
+  CADT_Pool *p = (CADT_Pool *)ctx;
+  memcpy(b, &p->freelist, sizeof(void *));
+  p->freelist = b;
+}
+
+
+/*-- interface --*/
+
+/* memory is taken from the system chunksz bytes at a time, larger
+ * allocations get a chunk of their own */
+CADT_Arena *CADT_Arena_new(const size_t chunksz) {
+  CADT_Arena *a = (CADT_Arena *)malloc(sizeof(CADT_Arena));
+  if (a == NULL) {
+    return NULL;
+  }
+  a->chunks = NULL;
+  a->chunksz = chunksz > ARENA_MIN_CHUNK ? chunksz : ARENA_MIN_CHUNK;
+  a->last = NULL;
+  return a;
+}
+
+
+CADT_Allocator CADT_Arena_allocator(CADT_Arena *a) {
+  CADT_Allocator al = {
+      .alloc = aalloc, .realloc = arealloc, .free = afree, .ctx = a};
+  return al;
+}
+
+
+/* release everything allocated from a. the newest chunk is kept for
+ * reuse, so an arena reset per request stops touching the system
+ * allocator once it has warmed up. */
+void CADT_Arena_reset(CADT_Arena *a) {
+  if (a == NULL || a->chunks == NULL) {
+    return;
+  }
+  cfree(a->chunks->next);
+  a->chunks->next = NULL;
+  a->chunks->used = 0;
+  a->last = NULL;
+}
+
+
+void CADT_Arena_free(CADT_Arena *a) {
+  if (a == NULL) {
+    return;
+  }
+  cfree(a->chunks);
+  free(a);
+}
+
+
+/* blocks of blocksz bytes, perchunk of them taken from the system at a
+ * time. good for objects of one size such as the containers themselves. */
+CADT_Pool *CADT_Pool_new(const size_t blocksz, const size_t perchunk) {
+  if (blocksz == 0 || perchunk == 0) {
+    return NULL;
+  }
+  const size_t sz = aalign(blocksz > sizeof(void *) ? blocksz
+                                                    : sizeof(void *));
+  if (perchunk > SIZE_MAX / sz) {
+    return NULL;
+  }
+  CADT_Pool *p = (CADT_Pool *)malloc(sizeof(CADT_Pool));
+  if (p == NULL) {
+    return NULL;
+  }
+  p->chunks = NULL;
+  p->freelist = NULL;
+  p->blocksz = sz;
+  p->perchunk = perchunk;
+  p->carved = 0;
+  return p;
+}
+
+
+CADT_Allocator CADT_Pool_allocator(CADT_Pool *p) {
+  CADT_Allocator al = {
+      .alloc = palloc, .realloc = prealloc, .free = pfree, .ctx = p};
+  return al;
+}
+
+
+void CADT_Pool_free(CADT_Pool *p) {
+  if (p == NULL) {
+    return;
+  }
+  cfree(p->chunks);
+  free(p);
+}
+
+#undef ALLOC_ALIGN
+#undef ARENA_MIN_CHUNK
+#undef ARENA_HDR
@@ -0,0 +1,66 @@
+#ifndef _CADT_ALLOCATOR
+#define _CADT_ALLOCATOR
+
+#include "cadt.h"
+#include <stddef.h>
+#include <string.h>
+
+/* data written by different threads is kept this many bytes apart */
+#define CADT_CACHELINE 64
+
+/* a block of memory an arena or a pool carves allocations from. chunks
+ * of an allocator are chained so they can be released together. */
+typedef struct Chunk_ {
+  struct Chunk_ *next;
+  size_t cap;  /* usable bytes after the header */
+  size_t used; /* bytes handed out, arenas only */
+} Chunk_;
+
+typedef struct CADT_Arena {
+  Chunk_ *chunks; /* the newest chunk first, allocations come from it */
+  size_t chunksz;
+  void *last; /* most recent allocation, it can grow or shrink in place */
+} CADT_Arena;
+
+typedef struct CADT_Pool {
+  Chunk_ *chunks;
+  void *freelist; /* free blocks, each holds a pointer to the next one */
+  size_t blocksz;
+  size_t perchunk; /* blocks carved from each chunk */
+  size_t carved;   /* blocks handed out from the newest chunk */
+} CADT_Pool;
+
+/* containers keep a copy of their allocator and go through these. a NULL
+ * allocator given to a constructor means CADT_std_allocator. */
+static inline CADT_Allocator CADT_allocator_(const CADT_Allocator *a) {
+  return a != NULL ? *a : CADT_std_allocator;
+}
+
+
+static inline void *CADT_alloc_(const CADT_Allocator *a, const size_t n) {
+  return a->alloc(a->ctx, n);
+}
+
+
+static inline void *CADT_calloc_(const CADT_Allocator *a, const size_t n) {
+  void *p = a->alloc(a->ctx, n);
+  if (p != NULL) {
+    memset(p, 0, n);
+  }
+  return p;
+}
+
+
+static inline void *CADT_realloc_(const CADT_Allocator *a, void *p,
+                                  const size_t n) {
+  return a->realloc(a->ctx, p, n);
+}
+
+
+static inline void CADT_free_(const CADT_Allocator *a, void *p) {
+  if (p != NULL) {
+    a->free(a->ctx, p);
+  }
+}
+
+#endif /* ifndef _CADT_ALLOCATOR */
@@ -2,61 +2,321 @@
 #define _CADT
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct CADT_Dict CADT_Dict;
+typedef struct CADT_ShardDict CADT_ShardDict;
 typedef struct CADT_Vec CADT_Vec;
 typedef struct CADT_Deque CADT_Deque;
+typedef struct CADT_SPSCQueue CADT_SPSCQueue;
+typedef struct CADT_MPMCQueue CADT_MPMCQueue;
+typedef struct CADT_WSDeque CADT_WSDeque;
 typedef struct CADT_Set CADT_Set;
 typedef struct CADT_Heap CADT_Heap;
+typedef struct CADT_TopK CADT_TopK;
+typedef struct CADT_MultiQueue CADT_MultiQueue;
+typedef struct CADT_RadixHeap CADT_RadixHeap;
+typedef struct CADT_Arena CADT_Arena;
+typedef struct CADT_Pool CADT_Pool;
+
+/* allocator.c */
+/* where a container gets its memory from. ctx is passed back to every
+ * call. */
+typedef struct CADT_Allocator {
+  void *(*alloc)(void *ctx, size_t n);
+  void *(*realloc)(void *ctx, void *p, size_t n);
+  void (*free)(void *ctx, void *p);
+  void *ctx;
+} CADT_Allocator;
+extern const CADT_Allocator CADT_std_allocator;
+CADT_Arena *CADT_Arena_new(const size_t chunksz);
+CADT_Allocator CADT_Arena_allocator(CADT_Arena *);
+void CADT_Arena_reset(CADT_Arena *);
+void CADT_Arena_free(CADT_Arena *);
+CADT_Pool *CADT_Pool_new(const size_t blocksz, const size_t perchunk);
+CADT_Allocator CADT_Pool_allocator(CADT_Pool *);
+void CADT_Pool_free(CADT_Pool *);
 
 /* dict.c */
 typedef enum CADTDictMode {
   OVERWRITE,
   IGNORE,
 } CADTDictMode;
+/* hashes nbyte bytes of key, mixing in the per dict seed */
+typedef uint64_t (*CADT_Hasher)(const void *key, size_t nbyte, uint64_t seed);
+uint64_t CADT_hash(const void *key, size_t nbyte, uint64_t seed);
 CADT_Dict *CADT_Dict_new(const size_t keysz, const size_t valsz);
+CADT_Dict *CADT_Dict_new_hasher(const size_t keysz, const size_t valsz,
+                                CADT_Hasher);
+CADT_Dict *CADT_Dict_new_varkey(const size_t valsz);
+CADT_Dict *CADT_Dict_new_compact(const size_t keysz, const size_t valsz);
+CADT_Dict *CADT_Dict_new_compact_varkey(const size_t valsz);
+CADT_Dict *CADT_Dict_new_with(const size_t keysz, const size_t valsz,
+                              CADT_Hasher, const CADT_Allocator *);
 void CADT_Dict_put(CADT_Dict *, const void *key, void *val, CADTDictMode);
 void *CADT_Dict_get(CADT_Dict *, const void *key);
+size_t CADT_Dict_get_many(CADT_Dict *, const void *keys, const size_t n,
+                          void **vals);
+void CADT_Dict_put_many(CADT_Dict *, const void *keys, const void *vals,
+                        const size_t n, CADTDictMode);
 size_t CADT_Dict_update(CADT_Dict *, CADT_Dict *, CADTDictMode);
+bool CADT_Dict_next(CADT_Dict *, size_t *pos, const void **key,
+                    size_t *keylen, void **val);
 bool CADT_Dict_remove(CADT_Dict *, const void *const key);
+void CADT_Dict_put_bytes(CADT_Dict *, const void *key, const size_t keylen,
+                         void *val, CADTDictMode);
+void *CADT_Dict_get_bytes(CADT_Dict *, const void *key, const size_t keylen);
+bool CADT_Dict_remove_bytes(CADT_Dict *, const void *key,
+                            const size_t keylen);
 void CADT_Dict_free(CADT_Dict *);
+/* hits and misses count lookups by the number of groups probed, the last
+ * bucket holds every longer probe. */
+#define CADT_DICT_PROBE_BUCKETS 8
+typedef struct CADT_DictStats {
+  size_t size;
+  size_t len;   /* slots of both tables */
+  size_t tombs; /* deleted slots of both tables */
+  double load;  /* full and deleted slots over len */
+  size_t bytes; /* heap memory held by the dict */
+  uint64_t hits[CADT_DICT_PROBE_BUCKETS];
+  uint64_t misses[CADT_DICT_PROBE_BUCKETS];
+  uint64_t resizes;
+  uint64_t resize_ns; /* time spent moving items to a new table */
+} CADT_DictStats;
+bool CADT_Dict_stats(const CADT_Dict *, CADT_DictStats *);
+void CADT_Dict_stats_reset(CADT_Dict *);
+
+/* dictfile.c */
+bool CADT_Dict_save(CADT_Dict *, const char *path);
+CADT_Dict *CADT_Dict_open_mmap(const char *path, CADT_Hasher,
+                               const bool verify);
+
+/* sharddict.c */
+CADT_ShardDict *CADT_ShardDict_new(const size_t keysz, const size_t valsz,
+                                   const size_t nshards);
+CADT_ShardDict *CADT_ShardDict_new_hasher(const size_t keysz,
+                                          const size_t valsz,
+                                          const size_t nshards, CADT_Hasher);
+CADT_ShardDict *CADT_ShardDict_new_with(const size_t keysz,
+                                        const size_t valsz,
+                                        const size_t nshards, CADT_Hasher,
+                                        const CADT_Allocator *);
+bool CADT_ShardDict_put(CADT_ShardDict *, const void *key, const void *val,
+                        CADTDictMode);
+bool CADT_ShardDict_get(CADT_ShardDict *, const void *key, void *val);
+bool CADT_ShardDict_remove(CADT_ShardDict *, const void *key);
+size_t CADT_ShardDict_size(CADT_ShardDict *);
+void CADT_ShardDict_free(CADT_ShardDict *);
 
 /* vector.c */
+/* a borrowed view of size elements of memsz bytes. it does not own buf
+ * and is passed by value. */
+typedef struct CADT_VecSpan {
+  void *buf;
+  size_t size;
+  size_t memsz;
+} CADT_VecSpan;
+
+static inline void *CADT_VecSpan_at(const CADT_VecSpan s, const size_t idx) {
+  return (unsigned char *)s.buf + idx * s.memsz;
+}
+
+/* the elements [start, start + n) of s, clamped to its end */
+static inline CADT_VecSpan CADT_VecSpan_sub(const CADT_VecSpan s,
+                                            const size_t start, size_t n) {
+  if (start >= s.size) {
+    n = 0;
+  } else if (n > s.size - start) {
+    n = s.size - start;
+  }
+  CADT_VecSpan sub = {CADT_VecSpan_at(s, start < s.size ? start : s.size), n,
+                      s.memsz};
+  return sub;
+}
+
 CADT_Vec *CADT_Vec_new(const size_t size, const size_t memsz);
+CADT_Vec *CADT_Vec_new_with(const size_t size, const size_t memsz,
+                            const CADT_Allocator *);
+CADT_Vec *CADT_Vec_new_inline(const size_t size, const size_t memsz,
+                              const size_t inlinesz, const CADT_Allocator *);
 CADT_Vec *CADT_Vec_init(const size_t size, const size_t memsz, ...);
 void CADT_Vec_insert(CADT_Vec *, const size_t idx, void *val,
                      const size_t memsz);
 void *const CADT_Vec_get(CADT_Vec *, const size_t idx, const size_t memsz);
 void *const CADT_Vec_pop(CADT_Vec *, const size_t memsz);
+void *CADT_Vec_get_ref(CADT_Vec *, const size_t idx);
+void *CADT_Vec_at_unchecked(CADT_Vec *, const size_t idx);
+bool CADT_Vec_pop_into(CADT_Vec *, void *out);
+CADT_VecSpan CADT_Vec_span(CADT_Vec *, const size_t start, const size_t n);
 void CADT_Vec_push(CADT_Vec *, void *val, const size_t memsz);
+bool CADT_Vec_insert_range(CADT_Vec *, const size_t idx, const void *vals,
+                           const size_t n);
+bool CADT_Vec_append_n(CADT_Vec *, const void *vals, const size_t n);
+bool CADT_Vec_extend_from_buffer(CADT_Vec *, const void *buf,
+                                 const size_t nbyte);
+void *CADT_Vec_resize_uninit(CADT_Vec *, const size_t size);
 CADT_Vec *CADT_Vec_concat(CADT_Vec *, CADT_Vec *);
-bool CADT_Vec_contains(CADT_Vec *, const void *const val);
 void CADT_Vec_reserve(CADT_Vec *, const size_t size);
 void CADT_Vec_clear(CADT_Vec *);
 void *const CADT_Vec_begin(CADT_Vec *const);
 void *const CADT_Vec_end(CADT_Vec *const);
 void CADT_Vec_free(CADT_Vec *);
 
+/* vecmap.c */
+#define CADT_VEC_MAP_HUGETLB 0x1u
+#define CADT_VEC_MAP_THP 0x2u
+CADT_Vec *CADT_Vec_new_mapped(const size_t memsz, const size_t maxsize,
+                              const unsigned flags);
+CADT_Vec *CADT_Vec_open_file(const char *path, const size_t memsz,
+                             const size_t maxsize, const unsigned flags);
+bool CADT_Vec_sync(CADT_Vec *);
+
+/* vecsearch.c */
+#define CADT_VEC_NOTFOUND SIZE_MAX
+size_t CADT_Vec_find(CADT_Vec *, const void *val);
+bool CADT_Vec_contains(CADT_Vec *, const void *const val);
+size_t CADT_Vec_count(CADT_Vec *, const void *val);
+size_t CADT_Vec_find_all(CADT_Vec *, const void *val, size_t *idx,
+                         const size_t cap);
+
+/* vecsort.c */
+typedef enum CADTKeyType {
+  CADT_KEY_UINT,
+  CADT_KEY_INT,
+  CADT_KEY_FLOAT,
+} CADTKeyType;
+void CADT_Vec_sort(CADT_Vec *, int (*cmp)(const void *, const void *));
+bool CADT_Vec_radix_sort(CADT_Vec *, const CADTKeyType);
+void CADT_Vec_nth_element(CADT_Vec *, const size_t n,
+                          int (*cmp)(const void *, const void *));
+void CADT_Vec_partial_sort(CADT_Vec *, const size_t k,
+                           int (*cmp)(const void *, const void *));
+size_t CADT_Vec_lower_bound(CADT_Vec *, const void *val,
+                            int (*cmp)(const void *, const void *));
+size_t CADT_Vec_upper_bound(CADT_Vec *, const void *val,
+                            int (*cmp)(const void *, const void *));
+void CADT_Vec_equal_range(CADT_Vec *, const void *val,
+                          int (*cmp)(const void *, const void *), size_t *lo,
+                          size_t *hi);
+
 /* deque.c */
 CADT_Deque *CADT_Deque_new(const size_t memsz);
+CADT_Deque *CADT_Deque_new_with(const size_t memsz, const CADT_Allocator *);
 CADT_Deque *CADT_Deque_init(const size_t count, const size_t memsz, ...);
-void CADT_Deque_push(CADT_Deque *, void *const val);
-void CADT_Deque_pushl(CADT_Deque *, void *const val);
-void *CADT_Deque_pop(CADT_Deque *);
-void *CADT_Deque_popl(CADT_Deque *);
+bool CADT_Deque_set_maxlen(CADT_Deque *, const size_t maxlen);
+size_t CADT_Deque_size(const CADT_Deque *);
+bool CADT_Deque_push(CADT_Deque *, const void *const val);
+bool CADT_Deque_pushl(CADT_Deque *, const void *const val);
+bool CADT_Deque_pop(CADT_Deque *, void *out);
+bool CADT_Deque_popl(CADT_Deque *, void *out);
+void *CADT_Deque_get(CADT_Deque *, const size_t idx);
 bool CADT_Deque_remove(CADT_Deque *, const void *const val);
 void CADT_Deque_rotate(CADT_Deque *, const size_t n);
 void CADT_Deque_free(CADT_Deque *);
 
+/* wsdeque.c */
+/* called by CADT_parallel_for on the indices [lo, hi) */
+typedef void (*CADT_RangeFn)(size_t lo, size_t hi, void *arg);
+CADT_WSDeque *CADT_WSDeque_new(const size_t capacity);
+bool CADT_WSDeque_push(CADT_WSDeque *, void *task);
+void *CADT_WSDeque_pop(CADT_WSDeque *);
+void *CADT_WSDeque_steal(CADT_WSDeque *);
+size_t CADT_WSDeque_size(CADT_WSDeque *);
+void CADT_WSDeque_free(CADT_WSDeque *);
+bool CADT_parallel_for(const size_t begin, const size_t end,
+                       const size_t grain, size_t nthreads, CADT_RangeFn fn,
+                       void *arg);
+
+/* queue.c */
+CADT_SPSCQueue *CADT_SPSCQueue_new(const size_t capacity, const size_t memsz);
+bool CADT_SPSCQueue_push(CADT_SPSCQueue *, const void *val);
+size_t CADT_SPSCQueue_push_n(CADT_SPSCQueue *, const void *vals,
+                             const size_t n);
+bool CADT_SPSCQueue_pop(CADT_SPSCQueue *, void *out);
+size_t CADT_SPSCQueue_pop_n(CADT_SPSCQueue *, void *out, const size_t n);
+size_t CADT_SPSCQueue_size(CADT_SPSCQueue *);
+void CADT_SPSCQueue_free(CADT_SPSCQueue *);
+CADT_MPMCQueue *CADT_MPMCQueue_new(const size_t capacity, const size_t memsz);
+bool CADT_MPMCQueue_push(CADT_MPMCQueue *, const void *val);
+size_t CADT_MPMCQueue_push_n(CADT_MPMCQueue *, const void *vals,
+                             const size_t n);
+bool CADT_MPMCQueue_pop(CADT_MPMCQueue *, void *out);
+size_t CADT_MPMCQueue_pop_n(CADT_MPMCQueue *, void *out, const size_t n);
+size_t CADT_MPMCQueue_size(CADT_MPMCQueue *);
+void CADT_MPMCQueue_free(CADT_MPMCQueue *);
+
 /* heap.c */
 typedef enum CADTHeapType { MAX, MIN } CADTHeapType;
+/* children per element of a new heap, see CADT_Heap_set_arity */
+#define CADT_HEAP_ARITY 4
+/* no element of an indexed heap has this handle */
+#define CADT_HEAP_NOHANDLE SIZE_MAX
 
 CADT_Heap *CADT_Heap_new(const size_t capacity, const size_t memsz,
                          const CADTHeapType,
                          int (*cmp)(const void *, const void *));
+CADT_Heap *CADT_Heap_new_with(const size_t capacity, const size_t memsz,
+                              const CADTHeapType,
+                              int (*cmp)(const void *, const void *),
+                              const CADT_Allocator *);
+CADT_Heap *CADT_Heap_new_indexed(const size_t capacity, const size_t memsz,
+                                 const CADTHeapType,
+                                 int (*cmp)(const void *, const void *),
+                                 const CADT_Allocator *);
+bool CADT_Heap_set_arity(CADT_Heap *, const size_t arity);
+size_t CADT_Heap_size(const CADT_Heap *);
+void *CADT_Heap_peek(const CADT_Heap *);
 bool CADT_Heap_insert(CADT_Heap *, const void *val);
+bool CADT_Heap_push_many(CADT_Heap *, const void *vals, const size_t n);
+bool CADT_Heap_heapify(CADT_Heap *, const void *buf, const size_t n);
+bool CADT_Heap_heapify_vec(CADT_Heap *, CADT_Vec *);
 void CADT_Heap_bottomup(CADT_Heap *, const size_t index);
 void CADT_Heap_topdown(CADT_Heap *, const size_t parent_index);
 void *CADT_Heap_popmin(CADT_Heap *);
+bool CADT_Heap_replace_top(CADT_Heap *, const void *val);
+size_t CADT_Heap_pop_into(CADT_Heap *, void *out, const size_t n);
+size_t CADT_Heap_insert_handle(CADT_Heap *, const void *val);
+size_t CADT_Heap_top_handle(const CADT_Heap *);
+void *CADT_Heap_get_handle(const CADT_Heap *, const size_t handle);
+bool CADT_Heap_update(CADT_Heap *, const size_t handle, const void *val);
+bool CADT_Heap_decrease_key(CADT_Heap *, const size_t handle,
+                            const void *val);
+bool CADT_Heap_increase_key(CADT_Heap *, const size_t handle,
+                            const void *val);
+bool CADT_Heap_remove(CADT_Heap *, const size_t handle, void *out);
+void CADT_Heap_free(CADT_Heap *);
+
+/* topk.c */
+CADT_TopK *CADT_TopK_new(const size_t k, const size_t memsz,
+                         const CADTHeapType,
+                         int (*cmp)(const void *, const void *),
+                         const CADT_Allocator *);
+bool CADT_TopK_push(CADT_TopK *, const void *val);
+size_t CADT_TopK_push_many(CADT_TopK *, const void *vals, const size_t n);
+size_t CADT_TopK_size(const CADT_TopK *);
+void *CADT_TopK_threshold(const CADT_TopK *);
+size_t CADT_TopK_take(CADT_TopK *, void *out);
+void CADT_TopK_free(CADT_TopK *);
+
+/* multiqueue.c */
+CADT_MultiQueue *CADT_MultiQueue_new(size_t nqueues, const size_t memsz,
+                                     const CADTHeapType,
+                                     int (*cmp)(const void *, const void *));
+bool CADT_MultiQueue_push(CADT_MultiQueue *, const void *val);
+bool CADT_MultiQueue_pop(CADT_MultiQueue *, void *out);
+size_t CADT_MultiQueue_size(CADT_MultiQueue *);
+void CADT_MultiQueue_free(CADT_MultiQueue *);
+
+/* radixheap.c */
+CADT_RadixHeap *CADT_RadixHeap_new(const size_t memsz);
+CADT_RadixHeap *CADT_RadixHeap_new_with(const size_t memsz,
+                                        const CADT_Allocator *);
+size_t CADT_RadixHeap_size(const CADT_RadixHeap *);
+uint64_t CADT_RadixHeap_last(const CADT_RadixHeap *);
+bool CADT_RadixHeap_insert(CADT_RadixHeap *, const void *val);
+void *CADT_RadixHeap_peek(CADT_RadixHeap *);
+void *CADT_RadixHeap_popmin(CADT_RadixHeap *);
+size_t CADT_RadixHeap_pop_into(CADT_RadixHeap *, void *out, const size_t n);
+void CADT_RadixHeap_free(CADT_RadixHeap *);
 
 #endif /* ifndef _CADT */
@@ -1,43 +1,127 @@
 #include "deque.h"
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+/* a chunk holds as many elements as fit in this many bytes, rounded down
+ * to a power of 2, and at least one */
+#define CADT_DEQUE_CHUNK_BYTES 4096
+#define CADT_DEQUE_MIN_CHUNKS 8
 
-static Block_ *newblock_(Block_ other) {
-  Block_ *block = (Block_ *)malloc(sizeof(Block_));
-  block->next = other.next;
-  block->prev = other.prev;
-  block->value = other.value;
-  return block;
+
+/*-- addressing --*/
+
+static size_t cnum(const CADT_Deque *const d, const size_t pos) {
+  return pos >> d->meta.shift;
+}
+
+
+/* chunks touched by size elements from slot begin. chunk numbers wrap
+ * around along with slots. */
+static size_t dspan(const CADT_Deque *const d, const size_t begin,
+                    const size_t size) {
+  if (size == 0) {
+    return 0;
+  }
+  const size_t first = cnum(d, begin);
+  const size_t last = cnum(d, begin + size - 1);
+  return ((last - first) & (SIZE_MAX >> d->meta.shift)) + 1;
+}
+
+
+static unsigned char **dchunkp(const CADT_Deque *const d, const size_t pos) {
+  return &d->chunks[cnum(d, pos) & (d->nchunks - 1)];
 }
 
 
-static void bfree(Block_ *b) {
-  free(b->value);
-  free(b);
+static unsigned char *dslot(const CADT_Deque *const d, const size_t pos) {
+  const size_t off = pos & (((size_t)1 << d->meta.shift) - 1);
+  return *dchunkp(d, pos) + off * d->meta.memsz;
 }
 
 
-#define newblock(...)                                                          \
-  newblock_((Block_){.next = NULL, .prev = NULL, .value = NULL, __VA_ARGS__})
+static unsigned char *dat(const CADT_Deque *const d, const size_t idx) {
+  return dslot(d, d->begin + idx);
+}
 
 
-static CADT_Deque *deqalloc(const size_t memsz) {
-  CADT_Deque *d = (CADT_Deque *)malloc(sizeof(CADT_Deque));
-  d->head = newblock(.next = d->tail);
-  d->tail = newblock(.prev = d->head);
+/*-- mem management --*/
 
+/* double the chunk ring. chunks in use move to their slot in the bigger
+ * ring, spare chunks are freed. */
+static bool dgrow(CADT_Deque *const d) {
+  const size_t n = d->nchunks * 2;
+  unsigned char **chunks = (unsigned char **)CADT_calloc_(
+      &d->alloc, n * sizeof(unsigned char *));
+  if (chunks == NULL) {
+    return false;
+  }
+  const size_t span = dspan(d, d->begin, d->meta.size);
+  for (size_t i = 0; i < span; i++) {
+    const size_t c = cnum(d, d->begin) + i;
+    unsigned char **p = &d->chunks[c & (d->nchunks - 1)];
+    chunks[c & (n - 1)] = *p;
+    *p = NULL;
+  }
+  for (size_t i = 0; i < d->nchunks; i++) {
+    CADT_free_(&d->alloc, d->chunks[i]);
+  }
+  CADT_free_(&d->alloc, d->chunks);
+  d->chunks = chunks;
+  d->nchunks = n;
+  return true;
+}
+
+
+/* make slot pos usable for a deque about to span begin and size */
+static bool dreserve(CADT_Deque *const d, const size_t pos,
+                     const size_t begin, const size_t size) {
+  if (dspan(d, begin, size) > d->nchunks && !dgrow(d)) {
+    return false;
+  }
+  unsigned char **p = dchunkp(d, pos);
+  if (*p == NULL) {
+    *p = (unsigned char *)CADT_alloc_(
+        &d->alloc, ((size_t)1 << d->meta.shift) * d->meta.memsz);
+  }
+  return *p != NULL;
+}
+
+
+static CADT_Deque *deqalloc(const size_t memsz,
+                            const CADT_Allocator *const alloc) {
+  const CADT_Allocator a = CADT_allocator_(alloc);
+  if (memsz == 0) {
+    return NULL;
+  }
+  CADT_Deque *d = (CADT_Deque *)CADT_alloc_(&a, sizeof(CADT_Deque));
+  if (d == NULL) {
+    return NULL;
+  }
+  d->alloc = a;
+  d->chunks = (unsigned char **)CADT_calloc_(
+      &a, CADT_DEQUE_MIN_CHUNKS * sizeof(unsigned char *));
+  if (d->chunks == NULL) {
+    CADT_free_(&a, d);
+    return NULL;
+  }
+  d->nchunks = CADT_DEQUE_MIN_CHUNKS;
+  d->begin = 0;
   d->meta.size = 0;
   d->meta.memsz = memsz;
   d->meta.maxlen = 0;
+  d->meta.shift = 0;
+  while (((size_t)2 << d->meta.shift) * memsz <= CADT_DEQUE_CHUNK_BYTES) {
+    d->meta.shift++;
+  }
   return d;
 }
 
 
 static bool deqmaxlen(CADT_Deque *const d, const size_t maxlen) {
-  if (d == NULL) {
+  if (d == NULL || (maxlen != 0 && maxlen < d->meta.size)) {
     return false;
   }
   d->meta.maxlen = maxlen;
@@ -45,107 +129,219 @@ static bool deqmaxlen(CADT_Deque *const d, const size_t maxlen) {
 }
 
 
-CADT_Deque *CADT_Deque_new(const size_t memsz) { return deqalloc(memsz); }
+static bool deqfull(const CADT_Deque *const d) {
+  return d->meta.maxlen != 0 && d->meta.size >= d->meta.maxlen;
+}
+
+
+/*-- operations --*/
+
+static bool dpush_head(CADT_Deque *const d, const void *const val) {
+  const size_t pos = d->begin - 1;
+  if (!dreserve(d, pos, pos, d->meta.size + 1)) {
+    return false;
+  }
+  memcpy(dslot(d, pos), val, d->meta.memsz);
+  d->begin = pos;
+  d->meta.size++;
+  return true;
+}
+
+
+static bool dpush_tail(CADT_Deque *const d, const void *const val) {
+  const size_t pos = d->begin + d->meta.size;
+  if (!dreserve(d, pos, d->begin, d->meta.size + 1)) {
+    return false;
+  }
+  memcpy(dslot(d, pos), val, d->meta.memsz);
+  d->meta.size++;
+  return true;
+}
+
+
+/* the whole ring is in use, so every slot of it holds an element */
+static bool dring_full(const CADT_Deque *const d) {
+  return d->meta.size == d->nchunks << d->meta.shift;
+}
+
+
+/*-- interface --*/
+
+CADT_Deque *CADT_Deque_new(const size_t memsz) {
+  return deqalloc(memsz, NULL);
+}
 
 
+/* d and its chunks are allocated from alloc, NULL for the standard one */
+CADT_Deque *CADT_Deque_new_with(const size_t memsz,
+                                const CADT_Allocator *alloc) {
+  return deqalloc(memsz, alloc);
+}
+
+
+/* the count values are pointers to memsz bytes, appended in order */
 CADT_Deque *CADT_Deque_init(const size_t count, const size_t memsz, ...) {
-  CADT_Deque *deq = deqalloc(memsz);
+  CADT_Deque *deq = deqalloc(memsz, NULL);
+  if (deq == NULL) {
+    return NULL;
+  }
   va_list args;
   va_start(args, memsz);
-  for (int i = 0; i < count; i++) {
-    void *val = va_arg(args, void *);
-    Block_ *block =
-        newblock(.prev = deq->tail->prev, .next = deq->tail, .value = val);
-    deq->tail->prev->next = block;
-    deq->tail->prev = block;
+  for (size_t i = 0; i < count; i++) {
+    const void *val = va_arg(args, const void *);
+    if (!dpush_tail(deq, val)) {
+      CADT_Deque_free(deq);
+      deq = NULL;
+      break;
+    }
   }
   va_end(args);
-  deq->meta.size = count;
   return deq;
 }
 
 
-void CADT_Deque_push(CADT_Deque *d, void *const val) {
-  if (d->meta.size >= d->meta.maxlen || d == NULL) {
-    return;
+/* pushes fail once the deque holds maxlen elements, 0 lifts the limit */
+bool CADT_Deque_set_maxlen(CADT_Deque *d, const size_t maxlen) {
+  return deqmaxlen(d, maxlen);
+}
+
+
+size_t CADT_Deque_size(const CADT_Deque *d) {
+  return d == NULL ? 0 : d->meta.size;
+}
+
+
+bool CADT_Deque_push(CADT_Deque *d, const void *const val) {
+  if (d == NULL || val == NULL || deqfull(d)) {
+    return false;
   }
-  Block_ *newhead = newblock(.prev = NULL, .next = d->head, .value = val);
-  d->head->prev = newhead;
-  d->meta.size++;
+  return dpush_head(d, val);
 }
 
 
-void CADT_Deque_pushl(CADT_Deque *d, void *val) {
-  if (d->meta.size >= d->meta.maxlen || d == NULL) {
-    return;
+bool CADT_Deque_pushl(CADT_Deque *d, const void *const val) {
+  if (d == NULL || val == NULL || deqfull(d)) {
+    return false;
   }
-  Block_ *newhead =
-      newblock(.prev = d->tail->prev, .next = d->tail, .value = val);
-  d->tail->prev = newhead;
-  d->meta.size++;
+  return dpush_tail(d, val);
 }
 
 
-void *CADT_Deque_pop(CADT_Deque *d) {
-  if (d->meta.size == 0 || d == NULL) {
-    return NULL;
+/* copy the head into out and remove it */
+bool CADT_Deque_pop(CADT_Deque *d, void *out) {
+  if (d == NULL || d->meta.size == 0) {
+    return false;
+  }
+  if (out != NULL) {
+    memcpy(out, dat(d, 0), d->meta.memsz);
   }
+  d->begin++;
+  d->meta.size--;
+  return true;
+}
+
 
-  void * value = d->head->value;
-  d->head->next->prev = NULL;
-  d->head = d->head->next;
-  free(d->head);
-  return value;
+/* copy the tail into out and remove it */
+bool CADT_Deque_popl(CADT_Deque *d, void *out) {
+  if (d == NULL || d->meta.size == 0) {
+    return false;
+  }
+  if (out != NULL) {
+    memcpy(out, dat(d, d->meta.size - 1), d->meta.memsz);
+  }
+  d->meta.size--;
+  return true;
 }
 
 
-void *CADT_Deque_popl(CADT_Deque *d) {
-  if (d->meta.size == 0 || d == NULL) {
+/* borrowed pointer to element idx, valid until the next push or pop */
+void *CADT_Deque_get(CADT_Deque *d, const size_t idx) {
+  if (d == NULL || idx >= d->meta.size) {
     return NULL;
   }
-
-  void *value = d->tail->value;
-  d->tail->prev->next = NULL;
-  d->tail = d->tail->prev;
-  free(d->tail);
-  return value;
+  return dat(d, idx);
 }
 
 
+/* remove the first element equal to val. the elements on the shorter
+ * side of it move over by one. */
 bool CADT_Deque_remove(CADT_Deque *d, const void *const val) {
-  Block_ *current = d->head;
-  while(current != NULL) {
-    if (!memcmp(current->value, val, d->meta.memsz)) {
-      current->prev->next = current->next;
-      current->next->prev = current->prev;
-      free(current->value);
-      return true;
+  if (d == NULL || val == NULL) {
+    return false;
+  }
+  const size_t memsz = d->meta.memsz;
+  size_t i = 0;
+  while (i < d->meta.size && memcmp(dat(d, i), val, memsz)) {
+    i++;
+  }
+  if (i == d->meta.size) {
+    return false;
+  }
+  if (i < d->meta.size / 2) {
+    for (size_t k = i; k > 0; k--) {
+      memcpy(dat(d, k), dat(d, k - 1), memsz);
+    }
+    d->begin++;
+  } else {
+    for (size_t k = i; k + 1 < d->meta.size; k++) {
+      memcpy(dat(d, k), dat(d, k + 1), memsz);
     }
-    current = current->next;
   }
-  return false;
+  d->meta.size--;
+  return true;
 }
 
 
+/* rotate so element n becomes the head, see deque.h for the cost. the
+ * shorter side is moved one element at a time to the other end; when
+ * every slot of the ring is in use the elements already sit in rotated
+ * order and only begin moves, as long as it moves by whole chunks. a
+ * begin inside a chunk would have the head and the tail share the chunk,
+ * which growing cannot split. */
 void CADT_Deque_rotate(CADT_Deque *d, const size_t n) {
-  const size_t offset = n % d->meta.size;
-  Block_ *current = d->head;
-  current = current + offset;
-  d->tail->next = d->head;
-  d->head->prev = d->tail;
-
-  d->head = current;
-  d->tail = current->prev;
-  d->head->prev = NULL;
-  d->tail->next = NULL;
+  if (d == NULL || d->meta.size == 0) {
+    return;
+  }
+  const size_t k = n % d->meta.size;
+  if (k == 0) {
+    return;
+  }
+  if (dring_full(d) && (k & (((size_t)1 << d->meta.shift) - 1)) == 0) {
+    d->begin += k;
+    return;
+  }
+  if (k <= d->meta.size - k) {
+    for (size_t i = 0; i < k; i++) {
+      /* the slot after the tail is never the head's while the ring has a
+       * free slot, and growing only moves chunk pointers */
+      if (!dpush_tail(d, dat(d, 0))) {
+        return;
+      }
+      d->begin++;
+      d->meta.size--;
+    }
+  } else {
+    for (size_t i = 0; i < d->meta.size - k; i++) {
+      if (!dpush_head(d, dat(d, d->meta.size - 1))) {
+        return;
+      }
+      d->meta.size--;
+    }
+  }
 }
 
 
 void CADT_Deque_free(CADT_Deque *d) {
-  Block_ *current = d->head;
-  while (current != NULL) {
-    free(current->value);
-    current = current->next;
-    free(current->prev);
+  if (d == NULL) {
+    return;
+  }
+  const CADT_Allocator a = d->alloc;
+  for (size_t i = 0; i < d->nchunks; i++) {
+    CADT_free_(&a, d->chunks[i]);
   }
+  CADT_free_(&a, d->chunks);
+  CADT_free_(&a, d);
 }
+
+#undef CADT_DEQUE_CHUNK_BYTES
+#undef CADT_DEQUE_MIN_CHUNKS
@@ -1,22 +1,34 @@
 #ifndef _CADT_DEQUE
 #define _CADT_DEQUE
 
+#include "allocator.h"
 #include "cadt.h"
 
-typedef struct Block_ {
-  void *value;
-  struct Block_ *next;
-  struct Block_ *prev;
-} Block_;
-
+/* elements are stored inline in chunks of equal size. element i of the
+ * deque sits at position begin + i of an unbounded sequence of slots;
+ * slot pos lives in chunk pos / per, which is kept at index
+ * (pos / per) % nchunks of the chunk ring. pushing at either end only
+ * moves begin or size, and a full ring is doubled by moving chunk
+ * pointers, never elements.
+ * the head is element 0, push and pop work there; the tail is the last
+ * element, pushl and popl work there.
+ * CADT_Deque_rotate by k costs O(min(k, size - k)) element copies, not an
+ * index shift. relinking chunks keeps each element at its offset within
+ * its chunk, but rotating moves one side by size slots relative to the
+ * other, so unless size is a whole number of chunks that side has to be
+ * copied to its new offsets. only a full ring rotated by whole chunks is
+ * O(1), as its elements already sit in rotated order. */
 typedef struct CADT_Deque {
-  Block_ *head;
-  Block_ *tail;
+  unsigned char **chunks; /* the chunk ring, NULL where none is allocated */
+  size_t nchunks;         /* a power of 2 */
+  size_t begin;           /* slot of the head, wraps around freely */
   struct {
     size_t size;
-    size_t maxlen;
+    size_t maxlen; /* 0 for no limit */
     size_t memsz;
+    size_t shift; /* a chunk holds 1 << shift elements */
   } meta;
+  CADT_Allocator alloc;
 } CADT_Deque;
 
 #endif /* ifndef _CADT_DEQUE */
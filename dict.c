@@ -1,7 +1,9 @@
 /* This dictionary implementation use open space addressing to handle
- * collisions. Large collision can drastically decrease the performance
- * of such technique, so the collision threshold is as small as 256
- * if there are more collisions the dictionary needs to be resized */
+ * collisions. Slots are split into groups of CADT_DICT_GROUP_WIDTH, and
+ * every slot has a control byte in a separate array. A lookup compares
+ * the 7 bit hash tag against a whole group of control bytes at once and
+ * only touches the entries whose tag matches, so a miss usually costs a
+ * single cache line of control bytes. */
 
 #include "dict.h"
 #include <assert.h>
@@ -9,8 +11,21 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #define CADT_DICT_RESIZE_THRESHOLD 0.8
+/* a table whose live items fill less than this is rehashed at the same
+ * size (to drop tombstones) or shrunk rather than grown. */
+#define CADT_DICT_SPARSE_THRESHOLD 0.4
+#define CADT_DICT_SHRINK_THRESHOLD 0.1
+/* groups of ht[0] moved to ht[1] per dictionary operation */
+#define CADT_DICT_REHASH_STEP 1
+/* keys hashed and prefetched ahead by the batch interface */
+#define CADT_DICT_BATCH 16
 
 /* on resize the buffer will growth by 4 times before
  * it reach size of 50000 * 8 bytes (this is the fast growth phase).
@@ -19,54 +34,307 @@
 #define CADT_DICT_FAST_GROWTH_SZ_LIMIT 50000 * (sizeof(void *))
 #define CADT_DICT_FAST_GROWTH_RATE 4
 #define CADT_DICT_SLOW_GROWTH_RATE 2
-/* minimum size of dictionary buffer */
-#define CADT_DICT_MIN_MEMSZ 64
-#define EMPTY_ITEM 0
+/* minimum number of slots, one group */
+#define CADT_DICT_MIN_LEN CADT_DICT_GROUP_WIDTH
+#define NOTFOUND SIZE_MAX
+/* layout flags of dictmalloc */
+#define DICT_VARKEY 0x1u
+#define DICT_COMPACT 0x2u
+/* first allocation of the key arena in bytes */
+#define CADT_DICT_MIN_ARENA 256
+/* statements that only exist in a stats build */
+#if CADT_DICT_STATS
+#define DSTAT(stmt) stmt
+#else
+#define DSTAT(stmt)
+#endif
+
+/* control bytes. a full slot stores the low 7 bits of its hash so the
+ * high bit tells free slots (empty or deleted) from full ones. */
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xfe
 
 /* -- hash function -- */
-/* Using FNV-1a hash function. othe candidates are Murmur and FNV-1
- * Murmur has better specs, but it use 4 byte hashing. It is hard to use
- * it for a general purpose hashing function. FNV-1 is a little bit slower. */
+/* A wyhash style hash. It folds 16 bytes per multiply, and 48 bytes per
+ * round on long keys with three independent lanes. Keys up to 16 bytes
+ * are read with at most four overlapping loads and no loop. Every dict
+ * mixes its own random seed in, so colliding keys can not be precomputed
+ * to flood a table. */
+
+static const uint64_t wyp[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                0x8ebc6af09c88c6dbull, 0x589965cc75374cc3ull};
+
+
+/* 64x64 -> 128 bit multiply, returns the two halves xor-ed together */
+static inline uint64_t wymix(const uint64_t a, const uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  const __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+  const uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a,
+                 lb = (uint32_t)b;
+  const uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  const uint64_t t = rl + (rm0 << 32);
+  const uint64_t lo = t + (rm1 << 32);
+  const uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+  return lo ^ hi;
+#endif
+}
+
+
+static inline uint64_t wyr8(const uint8_t *const p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+
+static inline uint64_t wyr4(const uint8_t *const p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+
+/* inline so calls with a constant nbyte fold into a straight line path */
+static inline uint64_t whash(const void *const data, const size_t nbyte,
+                             uint64_t seed) {
+  const uint8_t *p = (const uint8_t *)data;
+  size_t i = nbyte;
+  uint64_t a, b;
+
+  seed ^= wymix(seed ^ wyp[0], wyp[1]);
+  if (nbyte <= 16) {
+    if (nbyte >= 4) {
+      const size_t off = (nbyte >> 3) << 2;
+      a = (wyr4(p) << 32) | wyr4(p + off);
+      b = (wyr4(p + nbyte - 4) << 32) | wyr4(p + nbyte - 4 - off);
+    } else if (nbyte > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[nbyte >> 1] << 8) |
+          p[nbyte - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    if (i > 48) {
+      uint64_t see1 = seed, see2 = seed;
+      do {
+        seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+        see1 = wymix(wyr8(p + 16) ^ wyp[2], wyr8(p + 24) ^ see1);
+        see2 = wymix(wyr8(p + 32) ^ wyp[3], wyr8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16) {
+      seed = wymix(wyr8(p) ^ wyp[1], wyr8(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
+  }
+  return wymix(wyp[1] ^ nbyte, wymix(a ^ wyp[1], b ^ seed));
+}
+
+
+uint64_t CADT_hash(const void *key, size_t nbyte, uint64_t seed) {
+  return whash(key, nbyte, seed);
+}
+
+
+/* pick a seed per dict. there is no portable entropy source in C11, so
+ * mix the clock with the address of the dict. */
+static uint64_t dseed(const CADT_Dict *const d) {
+  struct timespec ts = {0, 0};
+  timespec_get(&ts, TIME_UTC);
+  return wymix((uint64_t)(uintptr_t)d ^ wyp[2],
+               ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^ wyp[3]);
+}
+
+
+#if CADT_DICT_STATS
+static uint64_t dclock(void) {
+  struct timespec ts = {0, 0};
+  timespec_get(&ts, TIME_UTC);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
 
-/* fnv-1a 64 bit hash function */
-static inline uint64_t fnv1a_1byte(const uint8_t byte, uint64_t hash) {
-  const static uint64_t prime = 0x100000001b3;
-  return (byte ^ hash) * prime;
+/* count a lookup that probed the given number of groups */
+static void dstat_probe(CADT_Dict *const d, const bool hit,
+                        const size_t probes) {
+  const size_t b = probes < CADT_DICT_PROBE_BUCKETS
+                       ? probes - 1
+                       : CADT_DICT_PROBE_BUCKETS - 1;
+  if (hit) {
+    d->stats.hits[b]++;
+  } else {
+    d->stats.misses[b]++;
+  }
 }
+#endif
 
 
-static uint64_t hash(const void *const data, size_t nbyte) {
-  /* fnv ofset basis */
-  uint64_t hash = 0xcbf29ce484222325;
-  const uint8_t *ptr = (const uint8_t *)data;
-  while (nbyte--) {
-    hash = fnv1a_1byte(*ptr, hash);
-    ptr++;
+/* hash n bytes of key. the common key widths get their own copy of the
+ * default hash */
+static uint64_t dhash(const CADT_Dict *const d, const void *const key,
+                      const size_t n) {
+  if (d->hasher != NULL) {
+    return d->hasher(key, n, d->seed);
+  }
+  switch (n) {
+    case 4:
+      return whash(key, 4, d->seed);
+    case 8:
+      return whash(key, 8, d->seed);
+    case 16:
+      return whash(key, 16, d->seed);
+    default:
+      return whash(key, n, d->seed);
   }
-  return hash;
+}
+
+
+/* the low 7 bits go to the control byte, the rest pick the group. */
+static inline uint8_t htag(const uint64_t h) { return (uint8_t)(h & 0x7f); }
+
+
+static inline size_t hgroup(const uint64_t h) { return (size_t)(h >> 7); }
+
+
+/* -- group matching -- */
+/* each function returns a bit mask, bit i is set if slot i of the group
+ * matches. */
+
+#if defined(__SSE2__)
+static inline uint32_t gmatch(const uint8_t *const g, const uint8_t tag) {
+  const __m128i ctrl = _mm_loadu_si128((const __m128i *)g);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+}
+
+
+/* empty and deleted slots are the only ones with the high bit set */
+static inline uint32_t gmatch_free(const uint8_t *const g) {
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+}
+#else
+static inline uint32_t gmatch(const uint8_t *const g, const uint8_t tag) {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < CADT_DICT_GROUP_WIDTH; i++) {
+    mask |= (uint32_t)(g[i] == tag) << i;
+  }
+  return mask;
+}
+
+
+static inline uint32_t gmatch_free(const uint8_t *const g) {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < CADT_DICT_GROUP_WIDTH; i++) {
+    mask |= (uint32_t)(g[i] >> 7) << i;
+  }
+  return mask;
+}
+#endif
+
+
+static inline uint32_t gmatch_full(const uint8_t *const g) {
+  return ~gmatch_free(g) & ((1u << CADT_DICT_GROUP_WIDTH) - 1);
+}
+
+
+/* index of the lowest set bit of a non zero mask */
+static inline size_t mlowest(const uint32_t mask) {
+#if defined(__GNUC__)
+  return (size_t)__builtin_ctz(mask);
+#else
+  size_t i = 0;
+  while (!(mask & (1u << i))) {
+    i++;
+  }
+  return i;
+#endif
 }
 
 
 /* -- helper functions -- */
 
-/* hash address within d->meta.len */
-static size_t dhash_idx(const CADT_Dict *const d, const void *const key) {
-  return hash(key, d->meta.keysz) % d->meta.len;
+static size_t ditem_sz(const CADT_Dict *const d) {
+  return d->meta.keysz + d->meta.valsz;
 }
 
 
-static size_t ditem_sz(const CADT_Dict *const d) { return d->meta.size + d->meta.valsz; }
+static size_t tgroups(const Table_ *const t) {
+  return t->len / CADT_DICT_GROUP_WIDTH;
+}
 
 
-/* total memory space occupied by d->entries */
-static size_t dbufmemspace(const CADT_Dict *const d) {
-  return ditem_sz(d) * d->meta.len;
+/* bytes of a dense index, large enough to address every slot of t */
+static size_t tiwidth(const Table_ *const t) {
+  const size_t top = t->len - 1;
+  if (top <= UINT8_MAX) {
+    return 1;
+  } else if (top <= UINT16_MAX) {
+    return 2;
+  } else if (top <= UINT32_MAX) {
+    return 4;
+  }
+  return 8;
 }
 
 
-/* return an unsigned char * point to the given idx of entries in d */
-static Item_ ditem(const CADT_Dict *const d, const size_t idx) {
-  return (unsigned char *)d->entries + idx * ditem_sz(d);
+static size_t tslotsz(const CADT_Dict *const d, const Table_ *const t) {
+  return d->meta.compact ? tiwidth(t) : ditem_sz(d);
+}
+
+
+static size_t tindex(const Table_ *const t, const size_t idx) {
+  switch (tiwidth(t)) {
+    case 1:
+      return ((const uint8_t *)t->entries)[idx];
+    case 2:
+      return ((const uint16_t *)(void *)t->entries)[idx];
+    case 4:
+      return ((const uint32_t *)(void *)t->entries)[idx];
+    default:
+      return (size_t)((const uint64_t *)(void *)t->entries)[idx];
+  }
+}
+
+
+static void tindex_set(Table_ *const t, const size_t idx, const size_t pos) {
+  switch (tiwidth(t)) {
+    case 1:
+      ((uint8_t *)t->entries)[idx] = (uint8_t)pos;
+      break;
+    case 2:
+      ((uint16_t *)(void *)t->entries)[idx] = (uint16_t)pos;
+      break;
+    case 4:
+      ((uint32_t *)(void *)t->entries)[idx] = (uint32_t)pos;
+      break;
+    default:
+      ((uint64_t *)(void *)t->entries)[idx] = pos;
+      break;
+  }
+}
+
+
+static Item_ ddense(const CADT_Dict *const d, const size_t pos) {
+  return d->dense.buf + pos * ditem_sz(d);
+}
+
+
+/* return an unsigned char * point to the given idx of entries in t */
+static Item_ titem(const CADT_Dict *const d, const Table_ *const t,
+                   const size_t idx) {
+  if (d->meta.compact) {
+    return ddense(d, tindex(t, idx));
+  }
+  return (unsigned char *)t->entries + idx * ditem_sz(d);
 }
 
 
@@ -78,162 +346,731 @@ static unsigned char *dval(void *item, const size_t offset) {
 }
 
 
-/* check if a block is empty */
-static bool dempty(const CADT_Dict *const d, const size_t idx) {
-  unsigned char *item = ditem(d, idx);
-  return item[0] == EMPTY_ITEM && !memcmp(item, item + 1, ditem_sz(d));
+/* the key reference of a variable length key item. items are packed so
+ * the reference is copied out rather than read in place. */
+static KeyRef_ dkeyref(const Item_ item) {
+  KeyRef_ ref;
+  memcpy(&ref, item, sizeof(KeyRef_));
+  return ref;
 }
 
 
-/* to check if d[idx] has the same key as item
- * note: if item has empty it return false */
-static bool samekey(const Item_ item, const void *const key,
-                    const size_t keysz) {
-  return (!memcmp(key, item, keysz));
+/* to check if item holds the n byte key with hash h. a variable length
+ * key is only read from the arena when its cached hash and length match */
+static bool samekey(const CADT_Dict *const d, const Item_ item,
+                    const void *const key, const size_t n, const uint64_t h) {
+  if (!d->meta.varkey) {
+    return (!memcmp(key, item, d->meta.keysz));
+  }
+  const KeyRef_ ref = dkeyref(item);
+  return ref.hash == h && ref.len == n &&
+         !memcmp(key, d->arena.buf + ref.off, n);
 }
 
 
-/* -- addressing and mem management -- */
+/* hash of the key stored in item */
+static uint64_t dithash(const CADT_Dict *const d, const Item_ item) {
+  if (d->meta.varkey) {
+    return dkeyref(item).hash;
+  }
+  return dhash(d, dkey(item), d->meta.keysz);
+}
+
+
+static bool drehashing(const CADT_Dict *const d) {
+  return d->ht[1].ctrl != NULL;
+}
+
+
+/* a dict opened from a snapshot serves lookups from read only pages */
+static bool dreadonly(const CADT_Dict *const d) { return d->map.addr != NULL; }
 
-/* open addressing overwrite mode.
- * it return the address when block contains the same key. */
-static unsigned char *dfind_open_addr(CADT_Dict *const d, size_t idx,
-                                      const void *const key) {
-  assert(d != NULL);
 
-  while (!dempty(d, idx)) {
-    idx = hash(&idx, sizeof(size_t)) % d->meta.len;
-    Item_ item = ditem(d, idx);
-    if (samekey(item, key, d->meta.keysz)) {
-      return item;
+/* -- addressing -- */
+
+/* probe group by group with triangular steps. with a power of 2 number of
+ * groups this visits every group exactly once.
+ * it return the slot that contains the same key, the number of groups
+ * probed is added to *probes. */
+static size_t tfind(const CADT_Dict *const d, const Table_ *const t,
+                    const void *const key, const size_t n, const uint64_t h,
+                    size_t *const probes) {
+  const size_t gmask = tgroups(t) - 1;
+  const uint8_t tag = htag(h);
+  size_t g = hgroup(h) & gmask;
+
+  for (size_t step = 1; step <= tgroups(t); step++) {
+    const uint8_t *ctrl = t->ctrl + g * CADT_DICT_GROUP_WIDTH;
+    for (uint32_t m = gmatch(ctrl, tag); m; m &= m - 1) {
+      const size_t idx = g * CADT_DICT_GROUP_WIDTH + mlowest(m);
+      if (samekey(d, titem(d, t, idx), key, n, h)) {
+        *probes += step;
+        return idx;
+      }
+    }
+    /* an empty slot ends the probe sequence, the key is not here */
+    if (gmatch(ctrl, CTRL_EMPTY)) {
+      *probes += step;
+      return NOTFOUND;
     }
-    d->collisions += 1;
+    g = (g + step) & gmask;
   }
 
-  return NULL;
+  *probes += tgroups(t);
+  return NOTFOUND;
+}
+
+
+/* first free slot on the probe sequence of h. the load factor keeps
+ * at least one slot free so this always terminates. */
+static size_t tfind_free(const Table_ *const t, const uint64_t h) {
+  const size_t gmask = tgroups(t) - 1;
+  size_t g = hgroup(h) & gmask;
+  uint32_t m;
+
+  for (size_t step = 1; !(m = gmatch_free(t->ctrl + g * CADT_DICT_GROUP_WIDTH));
+       step++) {
+    g = (g + step) & gmask;
+  }
+  return g * CADT_DICT_GROUP_WIDTH + mlowest(m);
+}
+
+
+/* store key and val in the free slot idx. a compact dict appends the item
+ * to the dense array, the caller makes sure it has room. */
+static void tfill(CADT_Dict *const d, Table_ *const t, const size_t idx,
+                  const uint64_t h, const void *const key,
+                  const void *const val) {
+  if (d->meta.compact) {
+    assert(d->dense.len < d->dense.cap);
+    d->dense.alive[d->dense.len] = 1;
+    tindex_set(t, idx, d->dense.len++);
+  }
+  Item_ item = titem(d, t, idx);
+  if (t->ctrl[idx] == CTRL_DELETED) {
+    t->tombs--;
+  }
+  t->ctrl[idx] = htag(h);
+  memcpy(dkey(item), key, d->meta.keysz);
+  memcpy(dval(item, d->meta.keysz), val, d->meta.valsz);
+  t->used++;
+}
+
+
+/* free the slot idx. a probe only moves past a group that has no empty
+ * slot, so if the group still has one no probe sequence depends on this
+ * slot and it can go back to empty instead of becoming a tombstone. */
+static void terase(CADT_Dict *const d, Table_ *const t, const size_t idx) {
+  if (d->meta.compact) {
+    d->dense.alive[tindex(t, idx)] = 0;
+    d->dense.dead++;
+  }
+  const uint8_t *g = t->ctrl + idx / CADT_DICT_GROUP_WIDTH *
+                                   CADT_DICT_GROUP_WIDTH;
+  if (gmatch(g, CTRL_EMPTY)) {
+    t->ctrl[idx] = CTRL_EMPTY;
+  } else {
+    t->ctrl[idx] = CTRL_DELETED;
+    t->tombs++;
+  }
+  t->used--;
+}
+
+
+/* find the slot of key in either table. *tp is set to the table holding
+ * it. while rehashing a key lives in exactly one of the two. */
+static size_t dlookup(CADT_Dict *const d, const void *const key,
+                      const size_t n, const uint64_t h, Table_ **tp) {
+  size_t idx = NOTFOUND;
+  size_t probes = 0;
+  for (size_t i = 0; idx == NOTFOUND && i <= (size_t)drehashing(d); i++) {
+    idx = tfind(d, &d->ht[i], key, n, h, &probes);
+    *tp = &d->ht[i];
+  }
+  DSTAT(dstat_probe(d, idx != NOTFOUND, probes));
+  return idx;
+}
+
+
+/* -- batching -- */
+
+#if defined(__GNUC__)
+#define dprefetch(p) __builtin_prefetch((p), 0, 3)
+#else
+#define dprefetch(p) ((void)(p))
+#endif
+
+
+/* fetch the control bytes of the home group of h in every live table */
+static void dprefetch_ctrl(const CADT_Dict *const d, const uint64_t h) {
+  for (size_t i = 0; i <= (size_t)drehashing(d); i++) {
+    const Table_ *t = &d->ht[i];
+    dprefetch(t->ctrl + (hgroup(h) & (tgroups(t) - 1)) * CADT_DICT_GROUP_WIDTH);
+  }
+}
+
+
+/* fetch the entry of the first tag match in the home group of h. the
+ * control bytes are expected to be in cache by now. */
+static void dprefetch_item(const CADT_Dict *const d, const uint64_t h) {
+  for (size_t i = 0; i <= (size_t)drehashing(d); i++) {
+    const Table_ *t = &d->ht[i];
+    const size_t base =
+        (hgroup(h) & (tgroups(t) - 1)) * CADT_DICT_GROUP_WIDTH;
+    const uint32_t m = gmatch(t->ctrl + base, htag(h));
+    if (m) {
+      dprefetch(t->entries + (base + mlowest(m)) * tslotsz(d, t));
+    }
+  }
+}
+
+
+/* -- mem management -- */
+
+static bool talloc(const CADT_Dict *const d, Table_ *const t,
+                   const size_t len) {
+  t->len = len;
+  uint8_t *ctrl = (uint8_t *)CADT_alloc_(&d->alloc, len);
+  /* zeroed so a saved snapshot never carries stale heap memory */
+  Item_ entries = (Item_)CADT_calloc_(&d->alloc, len * tslotsz(d, t));
+  if (ctrl == NULL || entries == NULL) {
+    CADT_free_(&d->alloc, ctrl);
+    CADT_free_(&d->alloc, entries);
+    return false;
+  }
+  memset(ctrl, CTRL_EMPTY, len);
+  t->ctrl = ctrl;
+  t->entries = entries;
+  t->used = 0;
+  t->tombs = 0;
+  return true;
+}
+
+
+static void tfree(const CADT_Dict *const d, Table_ *const t) {
+  CADT_free_(&d->alloc, t->ctrl);
+  CADT_free_(&d->alloc, t->entries);
+  memset(t, 0, sizeof(Table_));
+}
+
+
+/* smallest table that holds size items below the sparse threshold */
+static size_t dfitlen(const size_t size) {
+  size_t len = CADT_DICT_MIN_LEN;
+  while (size >= len * CADT_DICT_SPARSE_THRESHOLD) {
+    len *= 2;
+  }
+  return len;
+}
+
+
+/* items a compact dict can append before its index is rebuilt. it stays
+ * below len so every table keeps an empty slot. */
+static size_t ddensecap(const size_t len) {
+  return (size_t)(len * CADT_DICT_RESIZE_THRESHOLD);
+}
+
+
+static bool ddensealloc(CADT_Dict *const d, const size_t cap) {
+  Item_ buf = (Item_)CADT_realloc_(&d->alloc, d->dense.buf, cap * ditem_sz(d));
+  if (buf == NULL) {
+    return false;
+  }
+  d->dense.buf = buf;
+  uint8_t *alive = (uint8_t *)CADT_realloc_(&d->alloc, d->dense.alive, cap);
+  if (alive == NULL) {
+    return false;
+  }
+  d->dense.alive = alive;
+  d->dense.cap = cap;
+  return true;
 }
 
 
 static CADT_Dict *dictmalloc(const size_t size, const size_t keysz,
-                             const size_t valsz) {
-  const size_t itemsz = keysz + valsz;
-  CADT_Dict *d = (CADT_Dict *)malloc(sizeof(CADT_Dict));
+                             const size_t valsz, CADT_Hasher hasher,
+                             const unsigned flags,
+                             const CADT_Allocator *const alloc) {
+  const CADT_Allocator a = CADT_allocator_(alloc);
+  CADT_Dict *d = (CADT_Dict *)CADT_calloc_(&a, sizeof(CADT_Dict));
+  if (d == NULL) {
+    return NULL;
+  }
 
-  d->meta.size = size;
+  d->alloc = a;
   d->meta.keysz = keysz;
   d->meta.valsz = valsz;
-  if (itemsz * size < CADT_DICT_MIN_MEMSZ / 2) {
-    d->meta.len = (size_t)(CADT_DICT_MIN_MEMSZ / itemsz);
-  } else {
-    d->meta.len = 2 * size;
+  d->meta.varkey = flags & DICT_VARKEY;
+  d->meta.compact = flags & DICT_COMPACT;
+  d->hasher = hasher;
+  d->seed = dseed(d);
+  if (!talloc(d, &d->ht[0], dfitlen(size))) {
+    CADT_free_(&a, d);
+    return NULL;
+  }
+  if (d->meta.compact && !ddensealloc(d, ddensecap(d->ht[0].len))) {
+    tfree(d, &d->ht[0]);
+    CADT_free_(&a, d->dense.buf);
+    CADT_free_(&a, d);
+    return NULL;
   }
-  d->entries = (Item_)malloc(dbufmemspace(d));
-  memset(d->entries, EMPTY_ITEM, dbufmemspace(d));
   return d;
 }
 
 
-/* resize the buffer either when the size fill up 80% of entries or
- * because it has accumulated more than 256 collisions */
-static bool dbufresize(CADT_Dict *d) {
-  assert(d != NULL);
-  if (d->collisions >= 0 && (d->meta.size / d->meta.len) < CADT_DICT_RESIZE_THRESHOLD) {
+/* a compact dict replaces its index in one pass over the dense array.
+ * removed items are squeezed out on the way, so live items move at most
+ * once towards the front and keep their insertion order. */
+static bool drebuild(CADT_Dict *const d, const size_t len) {
+  Table_ t;
+  const size_t cap = ddensecap(len);
+  DSTAT(const uint64_t t0 = dclock());
+  if (!talloc(d, &t, len)) {
+    return false;
+  }
+  if (cap > d->dense.cap && !ddensealloc(d, cap)) {
+    tfree(d, &t);
     return false;
   }
 
-  /* reset collision counter */
-  if (d->collisions < 0) {
-    d->collisions = 0;
+  size_t n = 0;
+  for (size_t pos = 0; pos < d->dense.len; pos++) {
+    if (!d->dense.alive[pos]) {
+      continue;
+    }
+    if (n != pos) {
+      memcpy(ddense(d, n), ddense(d, pos), ditem_sz(d));
+      d->dense.alive[n] = 1;
+    }
+    const uint64_t h = dithash(d, ddense(d, n));
+    const size_t idx = tfind_free(&t, h);
+    t.ctrl[idx] = htag(h);
+    tindex_set(&t, idx, n);
+    t.used++;
+    n++;
   }
-  if (d->meta.size < CADT_DICT_FAST_GROWTH_SZ_LIMIT) {
-    d->meta.len = d->meta.len * CADT_DICT_FAST_GROWTH_RATE;
-  } else {
-    d->meta.len = d->meta.len * CADT_DICT_SLOW_GROWTH_RATE;
+  d->dense.len = n;
+  d->dense.dead = 0;
+  /* shrinking the buffer is optional, the index only needs cap entries */
+  if (cap < d->dense.cap) {
+    ddensealloc(d, cap);
   }
-  d->entries = (Item_)realloc(d->entries, ditem_sz(d) * d->meta.len);
+  d->dense.cap = cap;
+
+  tfree(d, &d->ht[0]);
+  d->ht[0] = t;
+  DSTAT(d->stats.resizes++);
+  DSTAT(d->stats.resize_ns += dclock() - t0);
   return true;
 }
 
 
-/* open addressing to resolve collision. get new address by
- * double hashing */
-static bool dput(CADT_Dict *const d, const Item_ item, CADTDictMode mode) {
-  assert(d != NULL);
-  unsigned char *key = dkey(item);
-  unsigned char *ptr = dfind_open_addr(d, dhash_idx(d, key), key);
+/* -- key arena -- */
+/* variable length keys are appended to one growing buffer and referred to
+ * by offset, so growing the buffer never invalidates a reference. when the
+ * buffer is full and more than half of it belongs to removed keys, the
+ * live keys are compacted instead of growing it. */
 
-  if (ptr == NULL) {
+/* copy the live keys into a fresh buffer and point their items at it */
+static bool darena_compact(CADT_Dict *const d) {
+  const size_t live = d->arena.len - d->arena.dead;
+  const size_t cap = live * 2 > CADT_DICT_MIN_ARENA ? live * 2
+                                                    : CADT_DICT_MIN_ARENA;
+  unsigned char *buf = (unsigned char *)CADT_alloc_(&d->alloc, cap);
+  size_t len = 0;
+  if (buf == NULL) {
     return false;
   }
 
-  d->meta.size += 1;
-  dbufresize(d);
+  for (size_t i = 0; i <= (size_t)drehashing(d); i++) {
+    const Table_ *t = &d->ht[i];
+    for (size_t g = 0; g < tgroups(t); g++) {
+      const size_t base = g * CADT_DICT_GROUP_WIDTH;
+      for (uint32_t m = gmatch_full(t->ctrl + base); m; m &= m - 1) {
+        Item_ item = titem(d, t, base + mlowest(m));
+        KeyRef_ ref = dkeyref(item);
+        memcpy(buf + len, d->arena.buf + ref.off, ref.len);
+        ref.off = len;
+        len += ref.len;
+        memcpy(item, &ref, sizeof(KeyRef_));
+      }
+    }
+  }
+  CADT_free_(&d->alloc, d->arena.buf);
+  d->arena.buf = buf;
+  d->arena.len = len;
+  d->arena.cap = cap;
+  d->arena.dead = 0;
+  return true;
+}
 
-  switch (mode) {
-    case IGNORE:
-      break;
 
-    case OVERWRITE:
-      memcpy(ptr, item, ditem_sz(d));
-      break;
+/* append n bytes of key, return their offset or NOTFOUND */
+static size_t darena_push(CADT_Dict *const d, const void *const key,
+                          const size_t n) {
+  if (d->arena.len + n > d->arena.cap && d->arena.dead > d->arena.len / 2) {
+    darena_compact(d);
+  }
+  if (d->arena.len + n > d->arena.cap) {
+    size_t cap = d->arena.cap ? d->arena.cap : CADT_DICT_MIN_ARENA;
+    while (d->arena.len + n > cap) {
+      cap *= 2;
+    }
+    unsigned char *buf =
+        (unsigned char *)CADT_realloc_(&d->alloc, d->arena.buf, cap);
+    if (buf == NULL) {
+      return NOTFOUND;
+    }
+    d->arena.buf = buf;
+    d->arena.cap = cap;
+  }
+  const size_t off = d->arena.len;
+  memcpy(d->arena.buf + off, key, n);
+  d->arena.len += n;
+  return off;
+}
 
-    default:
+
+/* move up to n groups of ht[0] into ht[1]. moved slots are erased from
+ * ht[0] so lookups of keys not moved yet still probe correctly. once
+ * ht[0] is drained ht[1] takes its place. */
+static void drehash(CADT_Dict *const d, size_t n) {
+  if (!drehashing(d)) {
+    return;
+  }
+  Table_ *from = &d->ht[0];
+  Table_ *to = &d->ht[1];
+  DSTAT(const uint64_t t0 = dclock());
+
+  for (; n > 0 && d->rehashidx < tgroups(from); n--, d->rehashidx++) {
+    const size_t base = d->rehashidx * CADT_DICT_GROUP_WIDTH;
+    for (uint32_t m = gmatch_full(from->ctrl + base); m; m &= m - 1) {
+      const size_t idx = base + mlowest(m);
+      Item_ item = titem(d, from, idx);
+      const uint64_t h = dithash(d, item);
+      tfill(d, to, tfind_free(to, h), h, dkey(item),
+            dval(item, d->meta.keysz));
+      terase(d, from, idx);
+    }
+  }
+
+  if (d->rehashidx == tgroups(from)) {
+    tfree(d, from);
+    *from = *to;
+    memset(to, 0, sizeof(Table_));
+    d->rehashidx = 0;
+  }
+  DSTAT(d->stats.resize_ns += dclock() - t0);
+}
+
+
+/* start moving items into a new table of len slots */
+static bool dexpand(CADT_Dict *const d, const size_t len) {
+  if (drehashing(d) || !talloc(d, &d->ht[1], len)) {
+    return false;
+  }
+  d->rehashidx = 0;
+  DSTAT(d->stats.resizes++);
+  return true;
+}
+
+
+/* length of the table that replaces a full ht[0]. if most of it are
+ * tombstones or removed items the table keeps its size, otherwise it
+ * grows. */
+static size_t dgrowlen(const CADT_Dict *const d) {
+  size_t len = d->ht[0].len;
+  if (d->meta.size >= len * CADT_DICT_SPARSE_THRESHOLD) {
+    if (d->meta.size < CADT_DICT_FAST_GROWTH_SZ_LIMIT) {
+      len *= CADT_DICT_FAST_GROWTH_RATE;
+    } else {
+      len *= CADT_DICT_SLOW_GROWTH_RATE;
+    }
+  }
+  return len;
+}
+
+
+/* make room for one more item. ht[0] is replaced once full and deleted
+ * slots fill up 80% of it, or a compact dict runs out of dense room. */
+static void dreserve(CADT_Dict *const d) {
+  if (d->meta.compact) {
+    if (d->dense.len >= d->dense.cap) {
+      drebuild(d, dgrowlen(d));
+    }
+    return;
+  }
+  if (drehashing(d)) {
+    const Table_ *t = &d->ht[1];
+    if (t->used + t->tombs + 1 < t->len * CADT_DICT_RESIZE_THRESHOLD) {
+      return;
+    }
+    /* ht[1] filled up before ht[0] was drained, finish the move now */
+    drehash(d, SIZE_MAX);
+  }
+
+  const Table_ *t = &d->ht[0];
+  if (t->used + t->tombs + 1 < t->len * CADT_DICT_RESIZE_THRESHOLD) {
+    return;
+  }
+  if (dexpand(d, dgrowlen(d))) {
+    drehash(d, CADT_DICT_REHASH_STEP);
+  }
+}
+
+
+/* give memory back once most of the items are removed */
+static void dshrink(CADT_Dict *const d) {
+  const Table_ *t = &d->ht[0];
+  if (drehashing(d) || t->len <= CADT_DICT_MIN_LEN ||
+      d->meta.size >= t->len * CADT_DICT_SHRINK_THRESHOLD) {
+    return;
+  }
+  if (d->meta.compact) {
+    drebuild(d, dfitlen(d->meta.size));
+  } else {
+    dexpand(d, dfitlen(d->meta.size));
+  }
+}
+
+
+/* insert the n byte key with hash h, or resolve it against an existing
+ * item with the same key according to mode. */
+static bool dput(CADT_Dict *const d, const void *const key, const size_t n,
+                 const void *const val, const uint64_t h, CADTDictMode mode) {
+  assert(d != NULL);
+  Table_ *t;
+  if (dreadonly(d)) {
+    return false;
+  }
+
+  drehash(d, CADT_DICT_REHASH_STEP);
+  const size_t idx = dlookup(d, key, n, h, &t);
+  if (idx != NOTFOUND) {
+    switch (mode) {
+      case IGNORE:
+        break;
+
+      case OVERWRITE:
+        memcpy(dval(titem(d, t, idx), d->meta.keysz), val, d->meta.valsz);
+        break;
+
+      default:
+        return false;
+    }
+    return true;
+  }
+
+  dreserve(d);
+  /* new keys always go to the newest table */
+  t = &d->ht[drehashing(d) ? 1 : 0];
+  /* keep one slot empty so probe sequences always terminate */
+  if (t->used + t->tombs + 1 >= t->len ||
+      (d->meta.compact && d->dense.len >= d->dense.cap)) {
+    return false;
+  }
+  if (d->meta.varkey) {
+    KeyRef_ ref = {.hash = h, .off = darena_push(d, key, n), .len = n};
+    if (ref.off == NOTFOUND) {
       return false;
+    }
+    tfill(d, t, tfind_free(t, h), h, &ref, val);
+  } else {
+    tfill(d, t, tfind_free(t, h), h, key, val);
   }
+  d->meta.size += 1;
   return true;
 }
 
 
 /* lookup element with open addressing.
- * the returned pointer point to */
-static Item_ dget(CADT_Dict *const d, const void *const key) {
+ * the returned pointer point to the value of the item */
+static Item_ dget(CADT_Dict *const d, const void *const key, const size_t n,
+                  const uint64_t h) {
   assert(d != NULL);
-  size_t idx = dhash_idx(d, key);
-  unsigned char *val = NULL;
-  Item_ item = ditem(d, idx);
-
-  while (memcmp(item, key, d->meta.keysz)) {
-    idx = hash(&idx, sizeof(size_t)) % d->meta.len;
-    /* if hit empty a empty block means key not found */
-    if (dempty(d, idx)) {
-      return NULL;
+  Table_ *t;
+  const size_t idx = dlookup(d, key, n, h, &t);
+  if (idx == NOTFOUND) {
+    return NULL;
+  }
+  return (Item_)dval(titem(d, t, idx), d->meta.keysz);
+}
+
+
+static bool dremove(CADT_Dict *const d, const void *const key,
+                    const size_t n, const uint64_t h) {
+  assert(d != NULL);
+  Table_ *t;
+  if (dreadonly(d)) {
+    return false;
+  }
+
+  drehash(d, CADT_DICT_REHASH_STEP);
+  const size_t idx = dlookup(d, key, n, h, &t);
+  if (idx == NOTFOUND) {
+    return false;
+  }
+  if (d->meta.varkey) {
+    d->arena.dead += n;
+  }
+  terase(d, t, idx);
+  d->meta.size -= 1;
+  dshrink(d);
+  return true;
+}
+
+
+/* the next item at or after *pos, NULL once every item was visited. a
+ * compact dict walks its dense array in insertion order, otherwise the
+ * slots of both tables are scanned. */
+static Item_ dnext(const CADT_Dict *const d, size_t *const pos) {
+  if (d->meta.compact) {
+    while (*pos < d->dense.len) {
+      const size_t p = (*pos)++;
+      if (d->dense.alive[p]) {
+        return ddense(d, p);
+      }
     }
-    item = ditem(d, idx);
+    return NULL;
   }
 
-  val = dval(item, d->meta.keysz);
-  return (Item_)val;
+  const size_t len0 = d->ht[0].len;
+  while (*pos < len0 + d->ht[1].len) {
+    const size_t i = (*pos)++;
+    const Table_ *t = &d->ht[i < len0 ? 0 : 1];
+    const size_t idx = i < len0 ? i : i - len0;
+    if (!(t->ctrl[idx] & CTRL_EMPTY)) {
+      return titem(d, t, idx);
+    }
+  }
+  return NULL;
 }
 
 
 /* -- interface -- */
 
 CADT_Dict *CADT_Dict_new(const size_t keysz, const size_t valsz) {
-  if (keysz < 0 || valsz < 0) {
+  if (keysz == 0) {
+    return NULL;
+  }
+  return dictmalloc(0, keysz, valsz, NULL, 0, NULL);
+}
+
+
+CADT_Dict *CADT_Dict_new_hasher(const size_t keysz, const size_t valsz,
+                                CADT_Hasher hasher) {
+  if (keysz == 0) {
+    return NULL;
+  }
+  return dictmalloc(0, keysz, valsz, hasher, 0, NULL);
+}
+
+
+CADT_Dict *CADT_Dict_new_varkey(const size_t valsz) {
+  return dictmalloc(0, sizeof(KeyRef_), valsz, NULL, DICT_VARKEY, NULL);
+}
+
+
+CADT_Dict *CADT_Dict_new_compact(const size_t keysz, const size_t valsz) {
+  if (keysz == 0) {
     return NULL;
   }
-  return dictmalloc(keysz, valsz, 0);
+  return dictmalloc(0, keysz, valsz, NULL, DICT_COMPACT, NULL);
 }
 
 
+CADT_Dict *CADT_Dict_new_compact_varkey(const size_t valsz) {
+  return dictmalloc(0, sizeof(KeyRef_), valsz, NULL,
+                    DICT_VARKEY | DICT_COMPACT, NULL);
+}
+
+
+/* d and its tables are allocated from alloc, NULL for the standard one.
+ * hasher may be NULL for the built in hash. */
+CADT_Dict *CADT_Dict_new_with(const size_t keysz, const size_t valsz,
+                              CADT_Hasher hasher,
+                              const CADT_Allocator *alloc) {
+  if (keysz == 0) {
+    return NULL;
+  }
+  return dictmalloc(0, keysz, valsz, hasher, 0, alloc);
+}
+
+
+/* the fixed size key interface does not apply to variable length keys */
 void CADT_Dict_put(CADT_Dict *d, const void *key, void *val,
                    CADTDictMode mode) {
-  if (d == NULL) {
+  if (d == NULL || d->meta.varkey) {
     return;
   }
-  unsigned char item[ditem_sz(d)];
-
-  memcpy(item, key, d->meta.keysz);
-  memcpy(&item[d->meta.keysz], val, d->meta.valsz);
-  dput(d, item, mode);
+  dput(d, key, d->meta.keysz, val, dhash(d, key, d->meta.keysz), mode);
 }
 
 
+/* lookups never move items, the pointer stays valid until the next put
+ * or remove on d. */
 void *CADT_Dict_get(CADT_Dict *d, const void *key) {
-  if (d == NULL || key == NULL) {
+  if (d == NULL || key == NULL || d->meta.varkey) {
     return NULL;
   }
-  return (void *)dval(dget(d, key), d->meta.keysz);
+  return (void *)dget(d, key, d->meta.keysz, dhash(d, key, d->meta.keysz));
+}
+
+
+/* keys are resolved CADT_DICT_BATCH at a time. all keys of a batch are
+ * hashed and their control bytes prefetched, then their first candidate
+ * entries, so the cache misses of a batch overlap instead of stalling one
+ * after another. */
+size_t CADT_Dict_get_many(CADT_Dict *d, const void *keys, const size_t n,
+                          void **vals) {
+  if (d == NULL || keys == NULL || vals == NULL || d->meta.varkey) {
+    return 0;
+  }
+  const unsigned char *k = (const unsigned char *)keys;
+  const size_t keysz = d->meta.keysz;
+  uint64_t hs[CADT_DICT_BATCH];
+  size_t found = 0;
+
+  for (size_t i = 0; i < n; i += CADT_DICT_BATCH) {
+    const size_t m = n - i < CADT_DICT_BATCH ? n - i : CADT_DICT_BATCH;
+    for (size_t j = 0; j < m; j++) {
+      hs[j] = dhash(d, k + (i + j) * keysz, keysz);
+      dprefetch_ctrl(d, hs[j]);
+    }
+    for (size_t j = 0; j < m; j++) {
+      dprefetch_item(d, hs[j]);
+    }
+    for (size_t j = 0; j < m; j++) {
+      vals[i + j] = (void *)dget(d, k + (i + j) * keysz, keysz, hs[j]);
+      found += vals[i + j] != NULL;
+    }
+  }
+  return found;
+}
+
+
+/* vals holds n values of valsz bytes, in the same order as keys */
+void CADT_Dict_put_many(CADT_Dict *d, const void *keys, const void *vals,
+                        const size_t n, CADTDictMode mode) {
+  if (d == NULL || keys == NULL || vals == NULL || d->meta.varkey) {
+    return;
+  }
+  const unsigned char *k = (const unsigned char *)keys;
+  const unsigned char *v = (const unsigned char *)vals;
+  const size_t keysz = d->meta.keysz;
+  uint64_t hs[CADT_DICT_BATCH];
+
+  for (size_t i = 0; i < n; i += CADT_DICT_BATCH) {
+    const size_t m = n - i < CADT_DICT_BATCH ? n - i : CADT_DICT_BATCH;
+    for (size_t j = 0; j < m; j++) {
+      hs[j] = dhash(d, k + (i + j) * keysz, keysz);
+      dprefetch_ctrl(d, hs[j]);
+    }
+    for (size_t j = 0; j < m; j++) {
+      dput(d, k + (i + j) * keysz, keysz, v + (i + j) * d->meta.valsz, hs[j],
+           mode);
+    }
+  }
 }
 
 
@@ -241,38 +1078,201 @@ size_t CADT_Dict_update(CADT_Dict *d1, CADT_Dict *d2, CADTDictMode mode) {
   if (d1 == NULL || d2 == NULL) {
     return 0;
   }
-  for (size_t i = 0; i < d2->meta.len; i++) {
-    if (!dempty(d2, i)) {
-      unsigned char *top = ditem(d2, i);
-      CADT_Dict_put(d1, dkey(top), dval(top, d2->meta.keysz), mode);
-    }
+  if (d1 == d2) {
+    return d1->meta.size;
+  }
+  if (d1->meta.varkey != d2->meta.varkey || d1->meta.keysz != d2->meta.keysz ||
+      d1->meta.valsz != d2->meta.valsz) {
+    return 0;
+  }
+  const void *key;
+  size_t keylen;
+  void *val;
+  for (size_t pos = 0; CADT_Dict_next(d2, &pos, &key, &keylen, &val);) {
+    CADT_Dict_put_bytes(d1, key, keylen, val, mode);
   }
   return d1->meta.size;
 }
 
 
-/* because of open space addressing, keys cannot be deleted */
+/* iterate with pos starting at 0. d must not be modified while iterating.
+ * for a variable length key dict key points into the key arena and is
+ * not NUL terminated, keylen may be NULL for fixed size keys. */
+bool CADT_Dict_next(CADT_Dict *d, size_t *pos, const void **key,
+                    size_t *keylen, void **val) {
+  if (d == NULL || pos == NULL) {
+    return false;
+  }
+  Item_ item = dnext(d, pos);
+  if (item == NULL) {
+    return false;
+  }
+  if (d->meta.varkey) {
+    const KeyRef_ ref = dkeyref(item);
+    *key = d->arena.buf + ref.off;
+    if (keylen != NULL) {
+      *keylen = ref.len;
+    }
+  } else {
+    *key = dkey(item);
+    if (keylen != NULL) {
+      *keylen = d->meta.keysz;
+    }
+  }
+  *val = dval(item, d->meta.keysz);
+  return true;
+}
+
+
 bool CADT_Dict_remove(CADT_Dict *d, const void *const key) {
-  if (d == NULL || key == NULL) {
+  if (d == NULL || key == NULL || d->meta.varkey) {
+    return false;
+  }
+  return dremove(d, key, d->meta.keysz, dhash(d, key, d->meta.keysz));
+}
+
+
+/* -- byte string keys -- */
+/* on a variable length key dict any keylen works. on a fixed size key
+ * dict keylen must be keysz. */
+
+static bool dkeylen_ok(const CADT_Dict *const d, const size_t keylen) {
+  return d->meta.varkey || keylen == d->meta.keysz;
+}
+
+
+void CADT_Dict_put_bytes(CADT_Dict *d, const void *key, const size_t keylen,
+                         void *val, CADTDictMode mode) {
+  if (d == NULL || key == NULL || !dkeylen_ok(d, keylen)) {
+    return;
+  }
+  dput(d, key, keylen, val, dhash(d, key, keylen), mode);
+}
+
+
+void *CADT_Dict_get_bytes(CADT_Dict *d, const void *key, const size_t keylen) {
+  if (d == NULL || key == NULL || !dkeylen_ok(d, keylen)) {
+    return NULL;
+  }
+  return (void *)dget(d, key, keylen, dhash(d, key, keylen));
+}
+
+
+bool CADT_Dict_remove_bytes(CADT_Dict *d, const void *key,
+                            const size_t keylen) {
+  if (d == NULL || key == NULL || !dkeylen_ok(d, keylen)) {
     return false;
   }
-  void *val = CADT_Dict_get(d, key);
-  if (val == NULL) {
+  return dremove(d, key, keylen, dhash(d, key, keylen));
+}
+
+
+/* -- hashed interface -- */
+
+uint64_t CADT_Dict_hash_(const CADT_Dict *d, const void *key) {
+  return dhash(d, key, d->meta.keysz);
+}
+
+
+bool CADT_Dict_put_(CADT_Dict *d, const void *key, const void *val,
+                    const uint64_t h, CADTDictMode mode) {
+  return dput(d, key, d->meta.keysz, val, h, mode);
+}
+
+
+void *CADT_Dict_get_(CADT_Dict *d, const void *key, const uint64_t h) {
+  return (void *)dget(d, key, d->meta.keysz, h);
+}
+
+
+bool CADT_Dict_remove_(CADT_Dict *d, const void *key, const uint64_t h) {
+  return dremove(d, key, d->meta.keysz, h);
+}
+
+
+void CADT_Dict_rehash_(CADT_Dict *d, const size_t n) { drehash(d, n); }
+
+
+size_t CADT_Dict_slotsz_(const CADT_Dict *d, const Table_ *t) {
+  return tslotsz(d, t);
+}
+
+
+/* size, load and memory are always filled in. the probe and resize
+ * counters are only kept by a stats build, otherwise they are zero and
+ * false is returned. lookups bump the counters without synchronization,
+ * so on a dict read by several threads at once they are approximate. */
+bool CADT_Dict_stats(const CADT_Dict *d, CADT_DictStats *out) {
+  if (d == NULL || out == NULL) {
     return false;
   }
-  memset(val, EMPTY_ITEM, d->meta.valsz);
+  memset(out, 0, sizeof(CADT_DictStats));
+  out->size = d->meta.size;
+  out->bytes = sizeof(CADT_Dict);
+  for (size_t i = 0; i <= (size_t)drehashing(d); i++) {
+    const Table_ *t = &d->ht[i];
+    out->len += t->len;
+    out->tombs += t->tombs;
+    out->load += t->used + t->tombs;
+    if (!dreadonly(d)) {
+      out->bytes += t->len * (1 + tslotsz(d, t));
+    }
+  }
+  out->load /= out->len;
+  if (!dreadonly(d)) {
+    out->bytes += d->arena.cap + d->dense.cap * (ditem_sz(d) + 1);
+  }
+#if CADT_DICT_STATS
+  memcpy(out->hits, d->stats.hits, sizeof(out->hits));
+  memcpy(out->misses, d->stats.misses, sizeof(out->misses));
+  out->resizes = d->stats.resizes;
+  out->resize_ns = d->stats.resize_ns;
   return true;
+#else
+  return false;
+#endif
+}
+
+
+void CADT_Dict_stats_reset(CADT_Dict *d) {
+#if CADT_DICT_STATS
+  if (d != NULL) {
+    memset(&d->stats, 0, sizeof(d->stats));
+  }
+#else
+  (void)d;
+#endif
 }
 
 
 void CADT_Dict_free(CADT_Dict *d) {
-  free(d->entries);
-  free(d);
+  if (dreadonly(d)) {
+    d->map.release(d->map.addr, d->map.len);
+  } else {
+    tfree(d, &d->ht[0]);
+    tfree(d, &d->ht[1]);
+    CADT_free_(&d->alloc, d->arena.buf);
+    CADT_free_(&d->alloc, d->dense.buf);
+    CADT_free_(&d->alloc, d->dense.alive);
+  }
+  const CADT_Allocator a = d->alloc;
+  CADT_free_(&a, d);
 }
 
 #undef CADT_DICT_RESIZE_THRESHOLD
+#undef CADT_DICT_SPARSE_THRESHOLD
+#undef CADT_DICT_SHRINK_THRESHOLD
+#undef CADT_DICT_REHASH_STEP
+#undef CADT_DICT_BATCH
 #undef CADT_DICT_FAST_GROWTH_SZ_LIMIT
 #undef CADT_DICT_FAST_GROWTH_RATE
 #undef CADT_DICT_SLOW_GROWTH_RATE
-#undef CADT_DICT_MIN_MEMSZ
-#undef EMPTY_ITEM
+#undef CADT_DICT_MIN_LEN
+#undef NOTFOUND
+#undef CADT_DICT_MIN_ARENA
+#undef DSTAT
+#undef DICT_VARKEY
+#undef DICT_COMPACT
+#undef dprefetch
+#undef CTRL_EMPTY
+#undef CTRL_DELETED
@@ -1,23 +1,101 @@
 #ifndef _CADT_DICT
 #define _CADT_DICT
 
+#include "allocator.h"
 #include "cadt.h"
 #include <stddef.h>
 #include <stdint.h>
 
 typedef unsigned char *Item_;
 
+/* slots are probed one group at a time. a group is as wide as a SSE2
+ * register so one compare checks every control byte of the group. */
+#define CADT_DICT_GROUP_WIDTH 16
+
+/* build with -DCADT_DICT_STATS=1 to count probe lengths and resizes, see
+ * CADT_Dict_stats. without it the counters compile to nothing. */
+#ifndef CADT_DICT_STATS
+#define CADT_DICT_STATS 0
+#endif
+
+/* ctrl keeps one byte per slot: empty, deleted, or the low 7 bits of the
+ * hash of the key stored there. entries are only read on a tag match.
+ * in a compact dict entries only holds, per slot, the position of the
+ * item in the dense array, 1, 2, 4 or 8 bytes wide depending on len. */
+typedef struct Table_ {
+  uint8_t *ctrl; /* one control byte per slot. */
+  Item_ entries; /* each block is a (key, val) tuple, or a dense index */
+  size_t len;    /* entries length, a power of 2 multiple of group width */
+  size_t used;   /* full slots */
+  size_t tombs;  /* deleted slots, they still lengthen probe sequences */
+} Table_;
+
+/* the key of an item in a variable length key dict. the bytes live in
+ * the key arena, the hash is cached so probing and rehashing never read
+ * them unless the hash matches. */
+typedef struct KeyRef_ {
+  uint64_t hash;
+  size_t off; /* offset into the key arena */
+  size_t len;
+} KeyRef_;
+
 /* use a consecutive array to store both key and data. each element is
- * a key value tuple. Use a offset and type conversion to get value. */
+ * a key value tuple. Use a offset and type conversion to get value.
+ * A resize allocates ht[1] and moves a few groups of ht[0] into it on
+ * every operation, so the cost of rehashing is spread over many calls.
+ * ht[1] is only allocated while rehashing. */
 typedef struct CADT_Dict {
-  Item_ entries;      /* each block is a (key, val) tuple. */
-  uint8_t collisions; /* resize if it accumulates more than 256 collisions */
+  Table_ ht[2];
+  CADT_Hasher hasher; /* NULL for the built in hash */
+  CADT_Allocator alloc;
+  uint64_t seed;
+  size_t rehashidx; /* next group of ht[0] to move while rehashing */
+  struct {
+    void *addr; /* NULL unless the tables live in a read only file mapping */
+    size_t len;
+    int (*release)(void *, size_t); /* unmaps addr on free */
+  } map;
   struct {
-    size_t len;  /* entries length */
-    size_t size; /* number of element stored */
-    size_t keysz;
+    unsigned char *buf; /* keys of a variable length key dict */
+    size_t len;
+    size_t cap;
+    size_t dead; /* bytes of removed keys */
+  } arena;
+  struct {
+    Item_ buf;      /* items of a compact dict in insertion order */
+    uint8_t *alive; /* 0 for items that were removed */
+    size_t len;     /* items appended, removed ones included */
+    size_t cap;
+    size_t dead;
+  } dense;
+  struct {
+    size_t size;  /* number of element stored */
+    size_t keysz; /* sizeof(KeyRef_) if varkey */
     size_t valsz;
+    bool varkey;
+    bool compact;
   } meta;
+#if CADT_DICT_STATS
+  struct {
+    uint64_t hits[CADT_DICT_PROBE_BUCKETS];
+    uint64_t misses[CADT_DICT_PROBE_BUCKETS];
+    uint64_t resizes;
+    uint64_t resize_ns;
+  } stats;
+#endif
 } CADT_Dict;
 
+/* for containers built on top of CADT_Dict that hash a key once and pass
+ * the hash along. h must come from CADT_Dict_hash_ on a dict with the same
+ * hasher and seed. */
+uint64_t CADT_Dict_hash_(const CADT_Dict *, const void *key);
+bool CADT_Dict_put_(CADT_Dict *, const void *key, const void *val,
+                    const uint64_t h, CADTDictMode);
+void *CADT_Dict_get_(CADT_Dict *, const void *key, const uint64_t h);
+bool CADT_Dict_remove_(CADT_Dict *, const void *key, const uint64_t h);
+/* move up to n groups of a pending resize, SIZE_MAX finishes it */
+void CADT_Dict_rehash_(CADT_Dict *, const size_t n);
+/* bytes of t->entries per slot */
+size_t CADT_Dict_slotsz_(const CADT_Dict *, const Table_ *);
+
 #endif /* ifndef SYMBOL */
@@ -0,0 +1,321 @@
+/* Snapshot files for CADT_Dict. The file is the arrays of a dict written
+ * as they are in memory, behind a small header. Opening a snapshot maps
+ * the file and points a read only dict at the mapped pages, so no entry
+ * is parsed or copied and startup cost does not depend on the size of the
+ * table.
+ *
+ * layout, every section starts on a CADT_DICT_FILE_ALIGN boundary:
+ *   DictFileHeader_
+ *   ctrl              len bytes
+ *   slots             len entries of the table, items or dense indices
+ *   dense             dense_len items of a compact dict
+ *   alive             dense_len bytes
+ *   arena             arena_len bytes, keys of a variable length key dict
+ *
+ * integers are stored in host byte order, a file written on a machine of
+ * the other endianness is rejected. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "dict.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CADT_DICT_FILE_MAGIC "CADTDICT"
+#define CADT_DICT_FILE_VERSION 3
+#define CADT_DICT_FILE_ENDIAN 0x01020304u
+#define CADT_DICT_FILE_ALIGN 64
+/* flags */
+#define CADT_DICT_FILE_CUSTOM_HASHER 0x1u
+#define CADT_DICT_FILE_VARKEY 0x2u
+#define CADT_DICT_FILE_COMPACT 0x4u
+
+enum { SEC_CTRL, SEC_SLOTS, SEC_DENSE, SEC_ALIVE, SEC_ARENA, NSECTIONS };
+
+typedef struct FileSection_ {
+  uint64_t off;
+  uint64_t len;
+} FileSection_;
+
+typedef struct DictFileHeader_ {
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;
+  uint32_t flags;
+  uint32_t group_width;
+  uint64_t keysz;
+  uint64_t valsz;
+  uint64_t len;
+  uint64_t size;
+  uint64_t tombs;
+  uint64_t seed;
+  uint64_t dense_len;
+  uint64_t dense_dead;
+  uint64_t arena_dead;
+  FileSection_ sec[NSECTIONS];
+  uint64_t file_size;
+  uint64_t payload_sum; /* checksum of every section */
+  uint64_t header_sum;  /* checksum of every field above */
+} DictFileHeader_;
+
+
+static uint64_t falign(const uint64_t n) {
+  return (n + CADT_DICT_FILE_ALIGN - 1) / CADT_DICT_FILE_ALIGN *
+         CADT_DICT_FILE_ALIGN;
+}
+
+
+static uint64_t fheader_sum(const DictFileHeader_ *const hd) {
+  return CADT_hash(hd, offsetof(DictFileHeader_, header_sum),
+                   CADT_DICT_FILE_VERSION);
+}
+
+
+static uint64_t fpayload_sum(const DictFileHeader_ *const hd,
+                             const void *const data[NSECTIONS]) {
+  uint64_t sum = CADT_DICT_FILE_VERSION;
+  for (size_t i = 0; i < NSECTIONS; i++) {
+    sum = CADT_hash(data[i], hd->sec[i].len, sum);
+  }
+  return sum;
+}
+
+
+/* place the sections back to back from the end of the header */
+static void flayout(DictFileHeader_ *const hd) {
+  uint64_t off = sizeof(DictFileHeader_);
+  for (size_t i = 0; i < NSECTIONS; i++) {
+    hd->sec[i].off = falign(off);
+    off = hd->sec[i].off + hd->sec[i].len;
+  }
+  hd->file_size = off;
+}
+
+
+static bool fpad(FILE *f, const uint64_t from, const uint64_t to) {
+  for (uint64_t i = from; i < to; i++) {
+    if (fputc(0, f) == EOF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* n * sz with n * sz <= limit, or UINT64_MAX */
+static uint64_t fmul(const uint64_t n, const uint64_t sz,
+                     const uint64_t limit) {
+  if (sz != 0 && n > limit / sz) {
+    return UINT64_MAX;
+  }
+  return n * sz;
+}
+
+
+static bool fcheck_header(const DictFileHeader_ *const hd,
+                          const uint64_t file_size, CADT_Hasher hasher) {
+  if (memcmp(hd->magic, CADT_DICT_FILE_MAGIC, sizeof(hd->magic)) ||
+      hd->version != CADT_DICT_FILE_VERSION ||
+      hd->endian != CADT_DICT_FILE_ENDIAN ||
+      hd->header_sum != fheader_sum(hd) || hd->file_size != file_size) {
+    return false;
+  }
+  if (hd->group_width != CADT_DICT_GROUP_WIDTH || hd->keysz == 0 ||
+      hd->len < CADT_DICT_GROUP_WIDTH || (hd->len & (hd->len - 1)) ||
+      hd->size > hd->len || hd->len > file_size ||
+      hd->keysz > file_size || hd->valsz > file_size) {
+    return false;
+  }
+  /* the table must be read back with the kind of hasher it was built with */
+  if (!(hd->flags & CADT_DICT_FILE_CUSTOM_HASHER) != (hasher == NULL)) {
+    return false;
+  }
+  return !(hd->flags & CADT_DICT_FILE_VARKEY) || hd->keysz == sizeof(KeyRef_);
+}
+
+
+/* every section must have the size the header implies and sit where
+ * flayout puts it */
+static bool fcheck_sections(const DictFileHeader_ *const hd,
+                            const uint64_t slotsz) {
+  const uint64_t itemsz = hd->keysz + hd->valsz;
+  DictFileHeader_ want = *hd;
+  want.sec[SEC_CTRL].len = hd->len;
+  want.sec[SEC_SLOTS].len = fmul(hd->len, slotsz, hd->file_size);
+  want.sec[SEC_DENSE].len = fmul(hd->dense_len, itemsz, hd->file_size);
+  want.sec[SEC_ALIVE].len = hd->dense_len;
+  want.sec[SEC_ARENA].len = hd->sec[SEC_ARENA].len;
+  for (size_t i = 0; i < NSECTIONS; i++) {
+    if (want.sec[i].len > hd->file_size) {
+      return false;
+    }
+  }
+  flayout(&want);
+  return !memcmp(want.sec, hd->sec, sizeof(want.sec)) &&
+         want.file_size == hd->file_size &&
+         hd->dense_dead <= hd->dense_len &&
+         hd->arena_dead <= hd->sec[SEC_ARENA].len;
+}
+
+
+/* -- interface -- */
+
+/* a pending resize is finished first so the file holds a single table.
+ * the file is written next to path and renamed over it once complete, so
+ * a reader never maps a half written snapshot. */
+bool CADT_Dict_save(CADT_Dict *d, const char *path) {
+  if (d == NULL || path == NULL) {
+    return false;
+  }
+  CADT_Dict_rehash_(d, SIZE_MAX);
+
+  const Table_ *t = &d->ht[0];
+  const uint64_t itemsz = d->meta.keysz + d->meta.valsz;
+  DictFileHeader_ hd;
+  memset(&hd, 0, sizeof(hd));
+  memcpy(hd.magic, CADT_DICT_FILE_MAGIC, sizeof(hd.magic));
+  hd.version = CADT_DICT_FILE_VERSION;
+  hd.endian = CADT_DICT_FILE_ENDIAN;
+  hd.flags = (d->hasher != NULL ? CADT_DICT_FILE_CUSTOM_HASHER : 0) |
+             (d->meta.varkey ? CADT_DICT_FILE_VARKEY : 0) |
+             (d->meta.compact ? CADT_DICT_FILE_COMPACT : 0);
+  hd.group_width = CADT_DICT_GROUP_WIDTH;
+  hd.keysz = d->meta.keysz;
+  hd.valsz = d->meta.valsz;
+  hd.len = t->len;
+  hd.size = d->meta.size;
+  hd.tombs = t->tombs;
+  hd.seed = d->seed;
+  hd.dense_len = d->dense.len;
+  hd.dense_dead = d->dense.dead;
+  hd.arena_dead = d->arena.dead;
+  hd.sec[SEC_CTRL].len = t->len;
+  hd.sec[SEC_SLOTS].len = t->len * CADT_Dict_slotsz_(d, t);
+  hd.sec[SEC_DENSE].len = d->dense.len * itemsz;
+  hd.sec[SEC_ALIVE].len = d->dense.len;
+  hd.sec[SEC_ARENA].len = d->arena.len;
+  flayout(&hd);
+
+  const void *data[NSECTIONS] = {t->ctrl, t->entries, d->dense.buf,
+                                 d->dense.alive, d->arena.buf};
+  hd.payload_sum = fpayload_sum(&hd, data);
+  hd.header_sum = fheader_sum(&hd);
+
+  const size_t tmplen = strlen(path) + sizeof(".tmp");
+  char *tmp = (char *)malloc(tmplen);
+  if (tmp == NULL) {
+    return false;
+  }
+  snprintf(tmp, tmplen, "%s.tmp", path);
+
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL) {
+    free(tmp);
+    return false;
+  }
+  bool ok = fwrite(&hd, sizeof(hd), 1, f) == 1;
+  uint64_t at = sizeof(hd);
+  for (size_t i = 0; ok && i < NSECTIONS; i++) {
+    const size_t len = (size_t)hd.sec[i].len;
+    ok = fpad(f, at, hd.sec[i].off) &&
+         (len == 0 || fwrite(data[i], 1, len, f) == len);
+    at = hd.sec[i].off + len;
+  }
+  ok = fclose(f) == 0 && ok;
+  ok = ok && rename(tmp, path) == 0;
+  if (!ok) {
+    remove(tmp);
+  }
+  free(tmp);
+  return ok;
+}
+
+
+/* hasher must be the hasher the dict was saved with, NULL for the default
+ * one. verify checks the payload checksum, which reads the whole file;
+ * without it only the header is checked and pages are read on demand.
+ * the returned dict is read only: put and remove on it fail. */
+CADT_Dict *CADT_Dict_open_mmap(const char *path, CADT_Hasher hasher,
+                               const bool verify) {
+  if (path == NULL) {
+    return NULL;
+  }
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(DictFileHeader_)) {
+    close(fd);
+    return NULL;
+  }
+  const size_t mapsz = (size_t)st.st_size;
+  unsigned char *addr =
+      (unsigned char *)mmap(NULL, mapsz, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return NULL;
+  }
+
+  const DictFileHeader_ *hd = (const DictFileHeader_ *)(void *)addr;
+  CADT_Dict *d = NULL;
+  if (!fcheck_header(hd, mapsz, hasher) ||
+      (d = (CADT_Dict *)calloc(1, sizeof(CADT_Dict))) == NULL) {
+    munmap(addr, mapsz);
+    return NULL;
+  }
+  d->ht[0].len = hd->len;
+  d->meta.keysz = hd->keysz;
+  d->meta.valsz = hd->valsz;
+  d->meta.varkey = hd->flags & CADT_DICT_FILE_VARKEY;
+  d->meta.compact = hd->flags & CADT_DICT_FILE_COMPACT;
+  if (!fcheck_sections(hd, CADT_Dict_slotsz_(d, &d->ht[0]))) {
+    free(d);
+    munmap(addr, mapsz);
+    return NULL;
+  }
+
+  const void *data[NSECTIONS];
+  for (size_t i = 0; i < NSECTIONS; i++) {
+    data[i] = addr + hd->sec[i].off;
+  }
+  if (verify && fpayload_sum(hd, data) != hd->payload_sum) {
+    free(d);
+    munmap(addr, mapsz);
+    return NULL;
+  }
+
+  d->ht[0].ctrl = addr + hd->sec[SEC_CTRL].off;
+  d->ht[0].entries = addr + hd->sec[SEC_SLOTS].off;
+  d->ht[0].used = hd->size;
+  d->ht[0].tombs = hd->tombs;
+  d->hasher = hasher;
+  d->alloc = CADT_std_allocator;
+  d->seed = hd->seed;
+  d->meta.size = hd->size;
+  d->dense.buf = addr + hd->sec[SEC_DENSE].off;
+  d->dense.alive = addr + hd->sec[SEC_ALIVE].off;
+  d->dense.len = hd->dense_len;
+  d->dense.cap = hd->dense_len;
+  d->dense.dead = hd->dense_dead;
+  d->arena.buf = addr + hd->sec[SEC_ARENA].off;
+  d->arena.len = hd->sec[SEC_ARENA].len;
+  d->arena.cap = hd->sec[SEC_ARENA].len;
+  d->arena.dead = hd->arena_dead;
+  d->map.addr = addr;
+  d->map.len = mapsz;
+  d->map.release = munmap;
+  return d;
+}
+
+#undef CADT_DICT_FILE_MAGIC
+#undef CADT_DICT_FILE_VERSION
+#undef CADT_DICT_FILE_ENDIAN
+#undef CADT_DICT_FILE_ALIGN
+#undef CADT_DICT_FILE_CUSTOM_HASHER
+#undef CADT_DICT_FILE_VARKEY
+#undef CADT_DICT_FILE_COMPACT
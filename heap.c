@@ -2,94 +2,528 @@
 #include <stdlib.h>
 #include <string.h>
 
-static void *get(const CADT_Heap *const h, const size_t index) {
-  return (unsigned char *)h->data + index * h->meta.memsz;
+/* storage for this many elements is allocated by the first insert */
+#define CADT_HEAP_MIN_CAPACITY 16
+
+
+static unsigned char *get(const CADT_Heap *const h, const size_t index) {
+  return h->data + index * h->meta.memsz;
 }
 
+
 static void set(CADT_Heap *h, const void *val, const size_t index) {
-  memcpy((unsigned char *)h->data + index, val, h->meta.memsz);
+  memcpy(get(h, index), val, h->meta.memsz);
 }
 
-CADT_Heap *CADT_Heap_new(const size_t capacity, const size_t memsz,
-                         const CADTHeapType heap_type,
-                         int (*cmp)(const void *, const void *)) {
 
-  CADT_Heap *h = (CADT_Heap *)malloc(sizeof(CADT_Heap));
-  h->meta.capacity = capacity;
+static bool indexed(const CADT_Heap *const h) {
+  return h->idx.pos != NULL;
+}
+
+
+/* put val, the element with handle vh, at index */
+static void place(CADT_Heap *h, const void *val, const size_t vh,
+                  const size_t index) {
+  set(h, val, index);
+  if (indexed(h)) {
+    h->idx.of[index] = vh;
+    h->idx.pos[vh] = index;
+  }
+}
+
+
+/* the handle of the element at index, CADT_HEAP_NOHANDLE if not indexed */
+static size_t handleat(const CADT_Heap *const h, const size_t index) {
+  return indexed(h) ? h->idx.of[index] : CADT_HEAP_NOHANDLE;
+}
+
+
+/* a goes above b */
+static bool before(const CADT_Heap *const h, const void *a, const void *b) {
+  const int c = h->meta.cmp(a, b);
+  return h->meta.heap_type == MIN ? c < 0 : c > 0;
+}
+
+
+static bool grow(const CADT_Heap *const h, size_t **p, const size_t cap) {
+  size_t *q = (size_t *)CADT_realloc_(&h->alloc, *p, cap * sizeof(size_t));
+  if (q == NULL) {
+    return false;
+  }
+  *p = q;
+  return true;
+}
+
+
+static bool hreserve(CADT_Heap *h, const size_t n) {
+  if (n <= h->meta.capacity) {
+    return true;
+  }
+  size_t cap = h->meta.capacity ? h->meta.capacity : CADT_HEAP_MIN_CAPACITY;
+  while (cap < n) {
+    cap = cap > SIZE_MAX / 2 ? n : cap * 2;
+  }
+  if (cap > SIZE_MAX / h->meta.memsz || cap > SIZE_MAX / sizeof(size_t)) {
+    return false;
+  }
+  /* live handles never outnumber the elements, the handle arrays grow
+   * along with data */
+  if (indexed(h) &&
+      (!grow(h, &h->idx.pos, cap) || !grow(h, &h->idx.of, cap) ||
+       !grow(h, &h->idx.free, cap))) {
+    return false;
+  }
+  unsigned char *data = (unsigned char *)CADT_realloc_(
+      &h->alloc, h->data, cap * h->meta.memsz);
+  if (data == NULL) {
+    return false;
+  }
+  h->data = data;
+  h->meta.capacity = cap;
+  return true;
+}
+
+
+/* a handle for a new element, room for it must be reserved */
+static size_t hnew(CADT_Heap *h) {
+  if (!indexed(h)) {
+    return CADT_HEAP_NOHANDLE;
+  }
+  return h->idx.nfree > 0 ? h->idx.free[--h->idx.nfree] : h->idx.next++;
+}
+
+
+static void hrelease(CADT_Heap *h, const size_t handle) {
+  if (indexed(h)) {
+    h->idx.pos[handle] = CADT_HEAP_NOHANDLE;
+    h->idx.free[h->idx.nfree++] = handle;
+  }
+}
+
+
+/* give the elements [0, size) new handles 0 to size - 1 */
+static void hrenumber(CADT_Heap *h) {
+  if (!indexed(h)) {
+    return;
+  }
+  for (size_t i = 0; i < h->idx.next; i++) {
+    h->idx.pos[i] = CADT_HEAP_NOHANDLE;
+  }
+  for (size_t i = 0; i < h->meta.size; i++) {
+    h->idx.of[i] = i;
+    h->idx.pos[i] = i;
+  }
+  h->idx.next = h->meta.size;
+  h->idx.nfree = 0;
+}
+
+
+/* move the hole at index up until val fits there, then fill it with val
+ * and its handle vh. val must not point into the heap above index. */
+static void siftup(CADT_Heap *h, size_t index, const void *val,
+                   const size_t vh) {
+  while (index > 0) {
+    const size_t parent = (index - 1) / h->meta.arity;
+    if (!before(h, val, get(h, parent))) {
+      break;
+    }
+    place(h, get(h, parent), handleat(h, parent), index);
+    index = parent;
+  }
+  place(h, val, vh, index);
+}
+
+
+/* move the hole at index down until val fits there, then fill it. val
+ * must not point into the heap below index. */
+static void siftdown(CADT_Heap *h, size_t index, const void *val,
+                     const size_t vh) {
+  const size_t size = h->meta.size;
+  const size_t arity = h->meta.arity;
+  while (size > 1 && index <= (size - 2) / arity) {
+    const size_t first = index * arity + 1;
+    const size_t last = size - first < arity ? size : first + arity;
+    size_t best = first;
+    for (size_t c = first + 1; c < last; c++) {
+      if (before(h, get(h, c), get(h, best))) {
+        best = c;
+      }
+    }
+    if (!before(h, get(h, best), val)) {
+      break;
+    }
+    place(h, get(h, best), handleat(h, best), index);
+    index = best;
+  }
+  place(h, val, vh, index);
+}
+
+
+/* Floyd's bottom up construction, O(size) */
+static void heapify(CADT_Heap *h) {
+  if (h->meta.size < 2) {
+    return;
+  }
+  for (size_t i = (h->meta.size - 2) / h->meta.arity + 1; i-- > 0;) {
+    CADT_Heap_topdown(h, i);
+  }
+}
+
+
+/* remove the element at index, which is left in tmp. the tail element
+ * fills the hole and moves whichever way it has to. */
+static void hremove(CADT_Heap *h, const size_t index) {
+  memcpy(h->tmp, get(h, index), h->meta.memsz);
+  hrelease(h, handleat(h, index));
+  h->meta.size--;
+  if (index == h->meta.size) {
+    return;
+  }
+  const unsigned char *tail = get(h, h->meta.size);
+  const size_t th = handleat(h, h->meta.size);
+  if (index > 0 &&
+      before(h, tail, get(h, (index - 1) / h->meta.arity))) {
+    siftup(h, index, tail, th);
+  } else {
+    siftdown(h, index, tail, th);
+  }
+}
+
+
+/* insert val, reserving room first, and return its handle */
+static bool hinsert(CADT_Heap *h, const void *val, size_t *handle) {
+  /* val may be a pointer returned by CADT_Heap_popmin */
+  const unsigned char *p = (const unsigned char *)val;
+  if (h->data != NULL && p >= h->data &&
+      p < h->data + h->meta.capacity * h->meta.memsz) {
+    memcpy(h->tmp, val, h->meta.memsz);
+    val = h->tmp;
+  }
+  if (!hreserve(h, h->meta.size + 1)) {
+    return false;
+  }
+  *handle = hnew(h);
+  h->meta.size++;
+  siftup(h, h->meta.size - 1, val, *handle);
+  return true;
+}
+
+
+static CADT_Heap *heapalloc(const size_t capacity, const size_t memsz,
+                            const CADTHeapType heap_type,
+                            int (*cmp)(const void *, const void *),
+                            const CADT_Allocator *alloc, const bool index) {
+  const CADT_Allocator a = CADT_allocator_(alloc);
+  if (memsz == 0 || cmp == NULL) {
+    return NULL;
+  }
+  CADT_Heap *h = (CADT_Heap *)CADT_calloc_(&a, sizeof(CADT_Heap));
+  if (h == NULL) {
+    return NULL;
+  }
+  h->alloc = a;
   h->meta.memsz = memsz;
+  h->meta.arity = CADT_HEAP_ARITY;
   h->meta.heap_type = heap_type;
-  h->meta.size = 0;
   h->meta.cmp = cmp;
 
-  h->data = malloc(sizeof(capacity) * memsz);
-
-  if (h->data == NULL || h->meta.cmp == NULL) {
-    free(h);
+  h->tmp = (unsigned char *)CADT_alloc_(&a, memsz);
+  if (index && h->tmp != NULL) {
+    /* the handle arrays hold no entries yet, hreserve sizes them */
+    h->idx.pos = (size_t *)CADT_alloc_(&a, sizeof(size_t));
+  }
+  if (h->tmp == NULL || (index && h->idx.pos == NULL) ||
+      !hreserve(h, capacity)) {
+    CADT_Heap_free(h);
     return NULL;
   }
-
   return h;
 }
 
+
+CADT_Heap *CADT_Heap_new(const size_t capacity, const size_t memsz,
+                         const CADTHeapType heap_type,
+                         int (*cmp)(const void *, const void *)) {
+  return heapalloc(capacity, memsz, heap_type, cmp, NULL, false);
+}
+
+
+/* h and its storage are allocated from alloc, NULL for the standard one.
+ * capacity is only a hint, the heap grows as needed. */
+CADT_Heap *CADT_Heap_new_with(const size_t capacity, const size_t memsz,
+                              const CADTHeapType heap_type,
+                              int (*cmp)(const void *, const void *),
+                              const CADT_Allocator *alloc) {
+  return heapalloc(capacity, memsz, heap_type, cmp, alloc, false);
+}
+
+
+/* a heap whose elements can be found, changed and removed by the handle
+ * CADT_Heap_insert_handle returns, in O(log size) */
+CADT_Heap *CADT_Heap_new_indexed(const size_t capacity, const size_t memsz,
+                                 const CADTHeapType heap_type,
+                                 int (*cmp)(const void *, const void *),
+                                 const CADT_Allocator *alloc) {
+  return heapalloc(capacity, memsz, heap_type, cmp, alloc, true);
+}
+
+
+/* children per element, at least 2. the heap is rebuilt in O(size) */
+bool CADT_Heap_set_arity(CADT_Heap *h, const size_t arity) {
+  if (h == NULL || arity < 2) {
+    return false;
+  }
+  h->meta.arity = arity;
+  heapify(h);
+  return true;
+}
+
+
+size_t CADT_Heap_size(const CADT_Heap *h) {
+  return h == NULL ? 0 : h->meta.size;
+}
+
+
+/* the top element, NULL if empty */
+void *CADT_Heap_peek(const CADT_Heap *h) {
+  if (h == NULL || h->meta.size == 0) {
+    return NULL;
+  }
+  return get(h, 0);
+}
+
+
 bool CADT_Heap_insert(CADT_Heap *h, const void *val) {
-  if (h->meta.size < h->meta.capacity) {
-    set(h, val, h->meta.size);
-    CADT_Heap_bottomup(h, h->meta.size);
-    h->meta.size++;
+  size_t handle;
+  return h != NULL && val != NULL && hinsert(h, val, &handle);
+}
+
+
+/* insert n elements. a batch at least as large as the heap is appended
+ * and the whole heap rebuilt in O(size + n) */
+bool CADT_Heap_push_many(CADT_Heap *h, const void *vals, const size_t n) {
+  if (h == NULL || (vals == NULL && n > 0) ||
+      n > SIZE_MAX - h->meta.size || !hreserve(h, h->meta.size + n)) {
+    return false;
+  }
+  const unsigned char *src = (const unsigned char *)vals;
+  if (n < h->meta.size) {
+    for (size_t i = 0; i < n; i++) {
+      const size_t vh = hnew(h);
+      h->meta.size++;
+      siftup(h, h->meta.size - 1, src + i * h->meta.memsz, vh);
+    }
     return true;
   }
-  return false;
+  for (size_t i = 0; i < n; i++) {
+    place(h, src + i * h->meta.memsz, hnew(h), h->meta.size + i);
+  }
+  h->meta.size += n;
+  heapify(h);
+  return true;
 }
 
+
+/* replace the elements of h with the n elements of buf, in O(n). in an
+ * indexed heap old handles are dropped and the element buf[i] gets
+ * handle i. */
+bool CADT_Heap_heapify(CADT_Heap *h, const void *buf, const size_t n) {
+  if (h == NULL || (buf == NULL && n > 0) || !hreserve(h, n)) {
+    return false;
+  }
+  if (n > 0) {
+    memcpy(h->data, buf, n * h->meta.memsz);
+  }
+  h->meta.size = n;
+  hrenumber(h);
+  heapify(h);
+  return true;
+}
+
+
+/* replace the elements of h with those of v, their sizes must match */
+bool CADT_Heap_heapify_vec(CADT_Heap *h, CADT_Vec *v) {
+  if (h == NULL || v == NULL) {
+    return false;
+  }
+  const CADT_VecSpan s = CADT_Vec_span(v, 0, SIZE_MAX);
+  if (s.size > 0 && s.memsz != h->meta.memsz) {
+    return false;
+  }
+  return CADT_Heap_heapify(h, s.buf, s.size);
+}
+
+
+/* the element at index may be above its place, move it up */
 void CADT_Heap_bottomup(CADT_Heap *h, const size_t index) {
-  const size_t parent_index = (index - 1) / 2;
-  void *parent = get(h, parent_index);
-  void *self = get(h, index);
-  if (h->meta.cmp(parent, self) == 1) {
-    char temp[h->meta.memsz];
-    memcpy(temp, parent, h->meta.memsz);
-    memcpy(parent, self, h->meta.memsz);
-    memcpy(self, temp, h->meta.memsz);
-    CADT_Heap_bottomup(h, parent_index);
+  if (h == NULL || index >= h->meta.size) {
+    return;
   }
+  memcpy(h->tmp, get(h, index), h->meta.memsz);
+  siftup(h, index, h->tmp, handleat(h, index));
 }
 
+
+/* the element at parent_index may be above its place, move it down */
 void CADT_Heap_topdown(CADT_Heap *h, const size_t parent_index) {
-  int left = parent_index * 2 + 1;
-  int right = left + 1;
-  int min;
+  if (h == NULL || parent_index >= h->meta.size) {
+    return;
+  }
+  memcpy(h->tmp, get(h, parent_index), h->meta.memsz);
+  siftdown(h, parent_index, h->tmp, handleat(h, parent_index));
+}
+
+
+/* remove the top element. it is moved to the slot just past the heap and
+ * the pointer returned is valid until the next insert. NULL if empty */
+void *CADT_Heap_popmin(CADT_Heap *h) {
+  if (h == NULL || h->meta.size == 0) {
+    return NULL;
+  }
+  hremove(h, 0);
+  set(h, h->tmp, h->meta.size);
+  return get(h, h->meta.size);
+}
+
+
+/* replace the top element with val, cheaper than a pop and an insert. in
+ * an indexed heap val keeps the handle of the old top. false if empty */
+bool CADT_Heap_replace_top(CADT_Heap *h, const void *val) {
+  if (h == NULL || val == NULL || h->meta.size == 0) {
+    return false;
+  }
+  memcpy(h->tmp, val, h->meta.memsz);
+  siftdown(h, 0, h->tmp, handleat(h, 0));
+  return true;
+}
+
 
-  if (left >= h->meta.size || left < 0) {
-    left = -1;
+/* pop up to n elements into out in heap order, return how many */
+size_t CADT_Heap_pop_into(CADT_Heap *h, void *out, const size_t n) {
+  if (h == NULL || out == NULL) {
+    return 0;
   }
-  if (right >= h->meta.size || right < 0) {
-    right = -1;
+  unsigned char *dst = (unsigned char *)out;
+  size_t i = 0;
+  for (; i < n && h->meta.size > 0; i++) {
+    hremove(h, 0);
+    memcpy(dst + i * h->meta.memsz, h->tmp, h->meta.memsz);
   }
+  return i;
+}
+
+
+/*-- handles --*/
+
+static bool hvalid(const CADT_Heap *const h, const size_t handle) {
+  return h != NULL && indexed(h) && handle < h->idx.next &&
+         h->idx.pos[handle] != CADT_HEAP_NOHANDLE;
+}
 
-  if (left != -1 && h->meta.cmp(get(h, left), get(h, parent_index)) == -1) {
-    min = left;
+
+/* the element's new value val goes to its place */
+static void hupdate(CADT_Heap *h, const size_t handle, const void *val) {
+  const size_t index = h->idx.pos[handle];
+  memcpy(h->tmp, val, h->meta.memsz);
+  if (index > 0 && before(h, h->tmp, get(h, (index - 1) / h->meta.arity))) {
+    siftup(h, index, h->tmp, handle);
   } else {
-    min = parent_index;
+    siftdown(h, index, h->tmp, handle);
   }
-  if (right != -1 && h->meta.cmp(get(h, right), get(h, min)) == -1) {
-    min = right;
+}
+
+
+/* insert val into an indexed heap and return its handle,
+ * CADT_HEAP_NOHANDLE if it could not be inserted. the handle stays valid
+ * until the element is popped or removed, then it may be handed out
+ * again. */
+size_t CADT_Heap_insert_handle(CADT_Heap *h, const void *val) {
+  size_t handle;
+  if (h == NULL || val == NULL || !indexed(h) || !hinsert(h, val, &handle)) {
+    return CADT_HEAP_NOHANDLE;
   }
+  return handle;
+}
 
-  if (min != parent_index) {
-    char *temp[h->meta.memsz];
-    memcpy(temp, get(h, parent_index), h->meta.memsz);
-    memcpy(get(h, min), get(h, parent_index), h->meta.memsz);
-    memcpy(get(h, parent_index), temp, h->meta.memsz);
 
-    CADT_Heap_topdown(h, min);
+/* the handle of the top element, CADT_HEAP_NOHANDLE if empty */
+size_t CADT_Heap_top_handle(const CADT_Heap *h) {
+  if (h == NULL || !indexed(h) || h->meta.size == 0) {
+    return CADT_HEAP_NOHANDLE;
   }
+  return h->idx.of[0];
 }
 
-void *CADT_Heap_popmin(CADT_Heap *h) {
-  if (h->meta.size == 0)
+
+/* the element of handle, NULL if it is not in the heap. change it only
+ * through CADT_Heap_update */
+void *CADT_Heap_get_handle(const CADT_Heap *h, const size_t handle) {
+  if (!hvalid(h, handle)) {
     return NULL;
-  void *val = get(h, 0);
-  h->meta.size--;
-  CADT_Heap_topdown(h, 0);
-  return val;
+  }
+  return get(h, h->idx.pos[handle]);
+}
+
+
+/* replace the element of handle with val, which may go either way */
+bool CADT_Heap_update(CADT_Heap *h, const size_t handle, const void *val) {
+  if (!hvalid(h, handle) || val == NULL) {
+    return false;
+  }
+  hupdate(h, handle, val);
+  return true;
+}
+
+
+/* replace the element of handle with val, which must not compare greater.
+ * in a MIN heap it moves up, in a MAX heap down. */
+bool CADT_Heap_decrease_key(CADT_Heap *h, const size_t handle,
+                            const void *val) {
+  if (!hvalid(h, handle) || val == NULL ||
+      h->meta.cmp(val, CADT_Heap_get_handle(h, handle)) > 0) {
+    return false;
+  }
+  hupdate(h, handle, val);
+  return true;
+}
+
+
+/* replace the element of handle with val, which must not compare less */
+bool CADT_Heap_increase_key(CADT_Heap *h, const size_t handle,
+                            const void *val) {
+  if (!hvalid(h, handle) || val == NULL ||
+      h->meta.cmp(val, CADT_Heap_get_handle(h, handle)) < 0) {
+    return false;
+  }
+  hupdate(h, handle, val);
+  return true;
 }
+
+
+/* remove the element of handle, copying it into out unless out is NULL */
+bool CADT_Heap_remove(CADT_Heap *h, const size_t handle, void *out) {
+  if (!hvalid(h, handle)) {
+    return false;
+  }
+  hremove(h, h->idx.pos[handle]);
+  if (out != NULL) {
+    memcpy(out, h->tmp, h->meta.memsz);
+  }
+  return true;
+}
+
+
+void CADT_Heap_free(CADT_Heap *h) {
+  if (h == NULL) {
+    return;
+  }
+  const CADT_Allocator a = h->alloc;
+  CADT_free_(&a, h->data);
+  CADT_free_(&a, h->tmp);
+  CADT_free_(&a, h->idx.pos);
+  CADT_free_(&a, h->idx.of);
+  CADT_free_(&a, h->idx.free);
+  CADT_free_(&a, h);
+}
+
+#undef CADT_HEAP_MIN_CAPACITY
@@ -1,16 +1,41 @@
 #ifndef _CADT_HEAP
+#define _CADT_HEAP
+
+#include "allocator.h"
 #include "cadt.h"
 
+/* an implicit d-ary heap. the children of element i are the arity
+ * elements from arity * i + 1, so a wider heap is shallower and the
+ * children compared at each level of a sift lie next to each other. */
 typedef struct CADT_Heap {
-  void *data;
+  unsigned char *data;
+  unsigned char *tmp; /* memsz bytes, the element being sifted or popped */
   struct {
     size_t size;
     size_t capacity;
     size_t memsz;
-    CADTHeapType heap_type; // 0 min, 1 max
-    int (*cmp)(const void *, const void *);  // 0 eq, 1 greater -1 smaller
+    size_t arity;
+    CADTHeapType heap_type; /* MIN keeps the smallest on top */
+    int (*cmp)(const void *, const void *); /* like qsort's */
   } meta;
+  /* handles of an indexed heap, all NULL otherwise. a handle names an
+   * element for as long as it is in the heap, wherever sifts move it. */
+  struct {
+    size_t *pos;  /* heap index of each handle, CADT_HEAP_NOHANDLE if free */
+    size_t *of;   /* handle of each heap index */
+    size_t *free; /* stack of handles to reuse */
+    size_t nfree;
+    size_t next; /* handles from here on were never handed out */
+  } idx;
+  CADT_Allocator alloc;
 } CADT_Heap;
 
-#define _CADT_HEAP
+/* the k best elements seen so far, held in a heap with the worst of them
+ * on top. a candidate that is not better than the top is rejected with a
+ * single compare. */
+typedef struct CADT_TopK {
+  CADT_Heap *heap;
+  size_t k;
+} CADT_TopK;
+
 #endif /* ifndef _CADT_HEAP */
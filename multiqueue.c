@@ -0,0 +1,213 @@
+/* A MultiQueue: a concurrent priority queue that trades exact order for
+ * throughput. It is made of several CADT_Heaps, a few per thread, each
+ * behind its own mutex. A push locks a random heap. A pop tries the locks
+ * of two random heaps and pops the better of their tops, so an element
+ * popped is close to the best one with high probability, and more heaps
+ * per thread mean less contention but a looser order. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "multiqueue.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+/* heaps per online cpu when the caller does not ask for a number */
+#define CADT_MULTIQUEUE_FACTOR 2
+/* random lock attempts before a pop sweeps every heap, or a push waits */
+#define CADT_MULTIQUEUE_TRIES 8
+
+static atomic_uint_fast64_t mqseed = 0x853c49e6748fea9bull;
+
+
+/* per thread xorshift, seeded once from a shared counter */
+static size_t mqrand(const size_t n) {
+  static _Thread_local uint64_t s = 0;
+  if (s == 0) {
+    uint64_t z = atomic_fetch_add_explicit(&mqseed, 0x9e3779b97f4a7c15ull,
+                                           memory_order_relaxed);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    s = (z ^ (z >> 31)) | 1;
+  }
+  s ^= s << 13;
+  s ^= s >> 7;
+  s ^= s << 17;
+  return (size_t)(s % n);
+}
+
+
+static void mqfree(CADT_MultiQueue *mq, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    pthread_mutex_destroy(&mq->queues[i].lock);
+    CADT_Heap_free(mq->queues[i].heap);
+  }
+  free(mq->queues);
+  free(mq);
+}
+
+
+/* the top of a locked queue is better than the one of b, an empty queue
+ * is worse than any */
+static bool mqbetter(const CADT_MultiQueue *const mq, const MQueue_ *a,
+                     const MQueue_ *b) {
+  const void *ta = CADT_Heap_peek(a->heap);
+  const void *tb = CADT_Heap_peek(b->heap);
+  if (ta == NULL || tb == NULL) {
+    return tb == NULL && ta != NULL;
+  }
+  const int c = mq->meta.cmp(ta, tb);
+  return mq->meta.heap_type == MIN ? c < 0 : c > 0;
+}
+
+
+static bool mqpop(CADT_MultiQueue *mq, MQueue_ *q, void *out) {
+  if (CADT_Heap_pop_into(q->heap, out, 1) == 0) {
+    return false;
+  }
+  atomic_fetch_sub_explicit(&mq->size, 1, memory_order_relaxed);
+  return true;
+}
+
+
+/* pop the best top found by locking every queue in turn */
+static bool mqsweep(CADT_MultiQueue *mq, void *out) {
+  MQueue_ *best = NULL;
+  for (size_t i = 0; i < mq->meta.nqueues; i++) {
+    MQueue_ *q = &mq->queues[i];
+    pthread_mutex_lock(&q->lock);
+    if (best == NULL || mqbetter(mq, q, best)) {
+      if (best != NULL) {
+        pthread_mutex_unlock(&best->lock);
+      }
+      best = q;
+    } else {
+      pthread_mutex_unlock(&q->lock);
+    }
+  }
+  const bool ok = mqpop(mq, best, out);
+  pthread_mutex_unlock(&best->lock);
+  return ok;
+}
+
+
+/*-- interface --*/
+
+/* nqueues heaps, 0 for CADT_MULTIQUEUE_FACTOR per online cpu. about two
+ * to four per thread using the queue keeps lock collisions rare. */
+CADT_MultiQueue *CADT_MultiQueue_new(size_t nqueues, const size_t memsz,
+                                     const CADTHeapType heap_type,
+                                     int (*cmp)(const void *, const void *)) {
+  if (memsz == 0 || cmp == NULL) {
+    return NULL;
+  }
+  if (nqueues == 0) {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    nqueues = CADT_MULTIQUEUE_FACTOR * (n > 0 ? (size_t)n : 1);
+  }
+  CADT_MultiQueue *mq = (CADT_MultiQueue *)malloc(sizeof(CADT_MultiQueue));
+  if (mq == NULL) {
+    return NULL;
+  }
+  mq->queues =
+      (MQueue_ *)aligned_alloc(_Alignof(MQueue_), nqueues * sizeof(MQueue_));
+  if (mq->queues == NULL) {
+    free(mq);
+    return NULL;
+  }
+  atomic_init(&mq->size, 0);
+  mq->meta.nqueues = nqueues;
+  mq->meta.memsz = memsz;
+  mq->meta.heap_type = heap_type;
+  mq->meta.cmp = cmp;
+  for (size_t i = 0; i < nqueues; i++) {
+    MQueue_ *q = &mq->queues[i];
+    q->heap = CADT_Heap_new(0, memsz, heap_type, cmp);
+    if (q->heap == NULL || pthread_mutex_init(&q->lock, NULL) != 0) {
+      CADT_Heap_free(q->heap);
+      mqfree(mq, i);
+      return NULL;
+    }
+  }
+  return mq;
+}
+
+
+/* insert val into a random heap. false if it could not grow */
+bool CADT_MultiQueue_push(CADT_MultiQueue *mq, const void *val) {
+  if (mq == NULL || val == NULL) {
+    return false;
+  }
+  MQueue_ *q = NULL;
+  for (size_t i = 0; i < CADT_MULTIQUEUE_TRIES && q == NULL; i++) {
+    q = &mq->queues[mqrand(mq->meta.nqueues)];
+    if (pthread_mutex_trylock(&q->lock) != 0) {
+      q = NULL;
+    }
+  }
+  if (q == NULL) {
+    q = &mq->queues[mqrand(mq->meta.nqueues)];
+    pthread_mutex_lock(&q->lock);
+  }
+  /* counted before it can be popped, so size never drops below zero */
+  atomic_fetch_add_explicit(&mq->size, 1, memory_order_relaxed);
+  const bool ok = CADT_Heap_insert(q->heap, val);
+  pthread_mutex_unlock(&q->lock);
+  if (!ok) {
+    atomic_fetch_sub_explicit(&mq->size, 1, memory_order_relaxed);
+  }
+  return ok;
+}
+
+
+/* copy an element close to the best into out and remove it. false only
+ * if every heap was found empty. */
+bool CADT_MultiQueue_pop(CADT_MultiQueue *mq, void *out) {
+  if (mq == NULL || out == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < CADT_MULTIQUEUE_TRIES; i++) {
+    if (atomic_load_explicit(&mq->size, memory_order_relaxed) == 0) {
+      return false;
+    }
+    MQueue_ *a = &mq->queues[mqrand(mq->meta.nqueues)];
+    MQueue_ *b = &mq->queues[mqrand(mq->meta.nqueues)];
+    if (pthread_mutex_trylock(&a->lock) != 0) {
+      a = NULL;
+    }
+    if (b == a || pthread_mutex_trylock(&b->lock) != 0) {
+      b = NULL;
+    }
+    MQueue_ *q = a == NULL ? b : b == NULL || mqbetter(mq, a, b) ? a : b;
+    const bool ok = q != NULL && mqpop(mq, q, out);
+    if (a != NULL) {
+      pthread_mutex_unlock(&a->lock);
+    }
+    if (b != NULL) {
+      pthread_mutex_unlock(&b->lock);
+    }
+    if (ok) {
+      return true;
+    }
+  }
+  return mqsweep(mq, out);
+}
+
+
+/* a snapshot, it may be stale by the time it returns */
+size_t CADT_MultiQueue_size(CADT_MultiQueue *mq) {
+  if (mq == NULL) {
+    return 0;
+  }
+  return atomic_load_explicit(&mq->size, memory_order_relaxed);
+}
+
+
+/* no other thread may use mq any more */
+void CADT_MultiQueue_free(CADT_MultiQueue *mq) {
+  if (mq == NULL) {
+    return;
+  }
+  mqfree(mq, mq->meta.nqueues);
+}
+
+#undef CADT_MULTIQUEUE_FACTOR
+#undef CADT_MULTIQUEUE_TRIES
@@ -0,0 +1,32 @@
+#ifndef _CADT_MULTIQUEUE
+#define _CADT_MULTIQUEUE
+
+#include "allocator.h"
+#include "cadt.h"
+#include "heap.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* like the shards of a CADT_ShardDict, each heap and its lock sit on
+ * their own cache lines */
+typedef struct MQueue_ {
+  _Alignas(CADT_CACHELINE) pthread_mutex_t lock;
+  CADT_Heap *heap;
+} MQueue_;
+
+/* a relaxed priority queue made of independently locked heaps. a push
+ * goes to a random heap, a pop takes the better top of two random heaps.
+ * locks are only tried, a thread that finds one taken picks another
+ * heap instead of waiting. */
+typedef struct CADT_MultiQueue {
+  MQueue_ *queues;
+  atomic_size_t size;
+  struct {
+    size_t nqueues;
+    size_t memsz;
+    CADTHeapType heap_type;
+    int (*cmp)(const void *, const void *);
+  } meta;
+} CADT_MultiQueue;
+
+#endif /* ifndef _CADT_MULTIQUEUE */
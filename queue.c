@@ -0,0 +1,322 @@
+/* Bounded lock free queues of memsz byte elements stored inline. Like a
+ * CADT_Deque with a maxlen, a push onto a full queue fails instead of
+ * blocking or growing. CADT_SPSCQueue allows one producer and one consumer
+ * thread and needs no read-modify-write, CADT_MPMCQueue allows any number
+ * of both. The batch calls move as many elements as fit at once and pay
+ * for the synchronisation once per batch. */
+
+#include "queue.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* slots for capacity elements, 0 on overflow */
+static size_t qslots(const size_t capacity) {
+  size_t n = 1;
+  while (n < capacity) {
+    if (n > SIZE_MAX / 2) {
+      return 0;
+    }
+    n *= 2;
+  }
+  return n;
+}
+
+
+/* aligned_alloc wants a size that is a multiple of the alignment */
+static void *qalloc(const size_t n) {
+  if (n > SIZE_MAX - CADT_CACHELINE) {
+    return NULL;
+  }
+  return aligned_alloc(CADT_CACHELINE, (n + CADT_CACHELINE - 1) /
+                                           CADT_CACHELINE * CADT_CACHELINE);
+}
+
+
+/*-- spsc --*/
+
+static unsigned char *sslot(const CADT_SPSCQueue *const q, const size_t pos) {
+  return q->buf + (pos & q->mask) * q->memsz;
+}
+
+
+/* copy n elements between the ring at pos and a flat buffer, in two
+ * pieces when the range wraps around */
+static void sput(CADT_SPSCQueue *const q, const size_t pos,
+                 const unsigned char *src, const size_t n) {
+  const size_t first = q->mask + 1 - (pos & q->mask);
+  const size_t k = n < first ? n : first;
+  memcpy(sslot(q, pos), src, k * q->memsz);
+  memcpy(q->buf, src + k * q->memsz, (n - k) * q->memsz);
+}
+
+
+static void sget(const CADT_SPSCQueue *const q, const size_t pos,
+                 unsigned char *dst, const size_t n) {
+  const size_t first = q->mask + 1 - (pos & q->mask);
+  const size_t k = n < first ? n : first;
+  memcpy(dst, sslot(q, pos), k * q->memsz);
+  memcpy(dst + k * q->memsz, q->buf, (n - k) * q->memsz);
+}
+
+
+/* room for up to n more elements, seen from the producer */
+static size_t sroom(CADT_SPSCQueue *const q, const size_t tail,
+                    const size_t n) {
+  const size_t slots = q->mask + 1;
+  if (slots - (tail - q->headc) < n) {
+    q->headc = atomic_load_explicit(&q->head, memory_order_acquire);
+  }
+  const size_t room = slots - (tail - q->headc);
+  return room < n ? room : n;
+}
+
+
+/* elements available up to n, seen from the consumer */
+static size_t savail(CADT_SPSCQueue *const q, const size_t head,
+                     const size_t n) {
+  if (q->tailc - head < n) {
+    q->tailc = atomic_load_explicit(&q->tail, memory_order_acquire);
+  }
+  const size_t avail = q->tailc - head;
+  return avail < n ? avail : n;
+}
+
+
+/* capacity is rounded up to a power of 2 */
+CADT_SPSCQueue *CADT_SPSCQueue_new(const size_t capacity, const size_t memsz) {
+  const size_t slots = qslots(capacity);
+  if (memsz == 0 || slots == 0 || slots > SIZE_MAX / memsz) {
+    return NULL;
+  }
+  CADT_SPSCQueue *q = (CADT_SPSCQueue *)qalloc(sizeof(CADT_SPSCQueue));
+  if (q == NULL) {
+    return NULL;
+  }
+  q->buf = (unsigned char *)qalloc(slots * memsz);
+  if (q->buf == NULL) {
+    free(q);
+    return NULL;
+  }
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->head, 0);
+  q->headc = 0;
+  q->tailc = 0;
+  q->mask = slots - 1;
+  q->memsz = memsz;
+  return q;
+}
+
+
+/* producer only. false if the queue is full */
+bool CADT_SPSCQueue_push(CADT_SPSCQueue *q, const void *val) {
+  return CADT_SPSCQueue_push_n(q, val, 1) == 1;
+}
+
+
+/* producer only. push the first elements of vals that fit, in order, and
+ * return how many */
+size_t CADT_SPSCQueue_push_n(CADT_SPSCQueue *q, const void *vals,
+                             const size_t n) {
+  if (q == NULL || vals == NULL) {
+    return 0;
+  }
+  const size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  const size_t k = sroom(q, tail, n);
+  sput(q, tail, (const unsigned char *)vals, k);
+  atomic_store_explicit(&q->tail, tail + k, memory_order_release);
+  return k;
+}
+
+
+/* consumer only. copy the oldest element into out, false if empty */
+bool CADT_SPSCQueue_pop(CADT_SPSCQueue *q, void *out) {
+  return CADT_SPSCQueue_pop_n(q, out, 1) == 1;
+}
+
+
+/* consumer only. copy up to n of the oldest elements into out and return
+ * how many */
+size_t CADT_SPSCQueue_pop_n(CADT_SPSCQueue *q, void *out, const size_t n) {
+  if (q == NULL || out == NULL) {
+    return 0;
+  }
+  const size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+  const size_t k = savail(q, head, n);
+  sget(q, head, (unsigned char *)out, k);
+  atomic_store_explicit(&q->head, head + k, memory_order_release);
+  return k;
+}
+
+
+/* a snapshot, it may be stale by the time it returns */
+size_t CADT_SPSCQueue_size(CADT_SPSCQueue *q) {
+  if (q == NULL) {
+    return 0;
+  }
+  const size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  const size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  return tail - head;
+}
+
+
+void CADT_SPSCQueue_free(CADT_SPSCQueue *q) {
+  if (q == NULL) {
+    return;
+  }
+  free(q->buf);
+  free(q);
+}
+
+
+/*-- mpmc --*/
+
+static atomic_size_t *mseq(const CADT_MPMCQueue *const q, const size_t pos) {
+  return (atomic_size_t *)(q->cells + (pos & q->mask) * q->stride);
+}
+
+
+static unsigned char *mval(const CADT_MPMCQueue *const q, const size_t pos) {
+  return (unsigned char *)mseq(q, pos) + sizeof(atomic_size_t);
+}
+
+
+/* claim up to n consecutive positions from *idx whose cells have sequence
+ * pos + lag, the ones ready for this side. return how many were claimed,
+ * the first one is stored in *pos. */
+static size_t mclaim(CADT_MPMCQueue *const q, atomic_size_t *idx,
+                     const size_t lag, const size_t n, size_t *pos) {
+  size_t p = atomic_load_explicit(idx, memory_order_relaxed);
+  for (;;) {
+    size_t k = 0;
+    intptr_t diff = 0;
+    while (k < n) {
+      const size_t seq =
+          atomic_load_explicit(mseq(q, p + k), memory_order_acquire);
+      diff = (intptr_t)(seq - (p + k + lag));
+      if (diff != 0) {
+        break;
+      }
+      k++;
+    }
+    if (k == 0 && diff > 0) {
+      /* another thread claimed p already */
+      p = atomic_load_explicit(idx, memory_order_relaxed);
+      continue;
+    }
+    if (k == 0) {
+      return 0;
+    }
+    if (atomic_compare_exchange_weak_explicit(idx, &p, p + k,
+                                              memory_order_relaxed,
+                                              memory_order_relaxed)) {
+      *pos = p;
+      return k;
+    }
+  }
+}
+
+
+/* capacity is rounded up to a power of 2 */
+CADT_MPMCQueue *CADT_MPMCQueue_new(const size_t capacity, const size_t memsz) {
+  const size_t slots = qslots(capacity);
+  const size_t align = _Alignof(max_align_t);
+  if (memsz == 0 || slots == 0 || memsz > SIZE_MAX / 2) {
+    return NULL;
+  }
+  const size_t stride =
+      (sizeof(atomic_size_t) + memsz + align - 1) / align * align;
+  if (slots > SIZE_MAX / stride) {
+    return NULL;
+  }
+  CADT_MPMCQueue *q = (CADT_MPMCQueue *)qalloc(sizeof(CADT_MPMCQueue));
+  if (q == NULL) {
+    return NULL;
+  }
+  q->cells = (unsigned char *)qalloc(slots * stride);
+  if (q->cells == NULL) {
+    free(q);
+    return NULL;
+  }
+  q->mask = slots - 1;
+  q->stride = stride;
+  q->memsz = memsz;
+  for (size_t i = 0; i < slots; i++) {
+    atomic_init(mseq(q, i), i);
+  }
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->head, 0);
+  return q;
+}
+
+
+/* false if the queue is full */
+bool CADT_MPMCQueue_push(CADT_MPMCQueue *q, const void *val) {
+  return CADT_MPMCQueue_push_n(q, val, 1) == 1;
+}
+
+
+/* push the first elements of vals that fit and return how many. they are
+ * claimed together, so a batch is never interleaved with the elements of
+ * other producers. */
+size_t CADT_MPMCQueue_push_n(CADT_MPMCQueue *q, const void *vals,
+                             const size_t n) {
+  if (q == NULL || vals == NULL || n == 0) {
+    return 0;
+  }
+  size_t pos;
+  const size_t k = mclaim(q, &q->tail, 0, n, &pos);
+  const unsigned char *src = (const unsigned char *)vals;
+  for (size_t i = 0; i < k; i++) {
+    memcpy(mval(q, pos + i), src + i * q->memsz, q->memsz);
+    atomic_store_explicit(mseq(q, pos + i), pos + i + 1,
+                          memory_order_release);
+  }
+  return k;
+}
+
+
+/* copy the oldest element into out, false if empty */
+bool CADT_MPMCQueue_pop(CADT_MPMCQueue *q, void *out) {
+  return CADT_MPMCQueue_pop_n(q, out, 1) == 1;
+}
+
+
+/* copy up to n consecutive elements into out and return how many */
+size_t CADT_MPMCQueue_pop_n(CADT_MPMCQueue *q, void *out, const size_t n) {
+  if (q == NULL || out == NULL || n == 0) {
+    return 0;
+  }
+  size_t pos;
+  const size_t k = mclaim(q, &q->head, 1, n, &pos);
+  unsigned char *dst = (unsigned char *)out;
+  for (size_t i = 0; i < k; i++) {
+    memcpy(dst + i * q->memsz, mval(q, pos + i), q->memsz);
+    /* free the cell for the producer one lap ahead */
+    atomic_store_explicit(mseq(q, pos + i), pos + i + q->mask + 1,
+                          memory_order_release);
+  }
+  return k;
+}
+
+
+/* a snapshot, it may be stale by the time it returns */
+size_t CADT_MPMCQueue_size(CADT_MPMCQueue *q) {
+  if (q == NULL) {
+    return 0;
+  }
+  const size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+  const size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+  /* head can pass the tail read before it */
+  return tail - head <= q->mask + 1 ? tail - head : 0;
+}
+
+
+void CADT_MPMCQueue_free(CADT_MPMCQueue *q) {
+  if (q == NULL) {
+    return;
+  }
+  free(q->cells);
+  free(q);
+}
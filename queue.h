@@ -0,0 +1,36 @@
+#ifndef _CADT_QUEUE
+#define _CADT_QUEUE
+
+#include "allocator.h"
+#include "cadt.h"
+#include <stdatomic.h>
+
+/* head and tail only ever grow, a position maps to slot pos & mask. each
+ * side keeps its own copy of the other side's index and only reloads the
+ * shared one when the copy says the ring is full or empty. the fields of
+ * the producer, of the consumer, and the read only ones each get their
+ * own cache line. */
+typedef struct CADT_SPSCQueue {
+  _Alignas(CADT_CACHELINE) atomic_size_t tail; /* next slot to push */
+  size_t headc; /* producer copy of head */
+  _Alignas(CADT_CACHELINE) atomic_size_t head; /* next slot to pop */
+  size_t tailc; /* consumer copy of tail */
+  _Alignas(CADT_CACHELINE) unsigned char *buf;
+  size_t mask; /* slots - 1, slots is a power of 2 */
+  size_t memsz;
+} CADT_SPSCQueue;
+
+/* a cell holds a sequence number followed by the element. a cell is free
+ * for the producer claiming position pos when its sequence is pos, and
+ * holds the element for the consumer claiming pos when it is pos + 1.
+ * producers and consumers claim positions with a CAS on tail and head. */
+typedef struct CADT_MPMCQueue {
+  _Alignas(CADT_CACHELINE) atomic_size_t tail;
+  _Alignas(CADT_CACHELINE) atomic_size_t head;
+  _Alignas(CADT_CACHELINE) unsigned char *cells;
+  size_t mask;
+  size_t stride; /* bytes per cell */
+  size_t memsz;
+} CADT_MPMCQueue;
+
+#endif /* ifndef _CADT_QUEUE */
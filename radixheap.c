@@ -0,0 +1,220 @@
+/* A radix heap: a min priority queue for unsigned integer keys that are
+ * never smaller than the last key popped, as with timestamps of an event
+ * simulation or distances in Dijkstra's algorithm. Elements are put in
+ * buckets by the highest bit in which their key differs from the last key
+ * popped, found with one xor and a count of leading zeros; no comparator
+ * is called. When bucket 0 runs empty the lowest other bucket is emptied
+ * into lower ones around its smallest key, so push is O(1) and pop is
+ * amortized O(log C) for keys spanning a range of C.
+ * The calls follow CADT_Heap's. Each element is memsz bytes, and its key
+ * is the uint64_t it starts with. */
+
+#include "radixheap.h"
+#include <string.h>
+
+
+static uint64_t rkey(const void *const val) {
+  uint64_t k;
+  memcpy(&k, val, sizeof(k));
+  return k;
+}
+
+
+/* bucket of a key not below last */
+static size_t rbucket(const CADT_RadixHeap *const rh, const uint64_t key) {
+  const uint64_t x = key ^ rh->last;
+  if (x == 0) {
+    return 0;
+  }
+#if defined(__GNUC__)
+  return (size_t)(64 - __builtin_clzll(x));
+#else
+  size_t b = 0;
+  for (uint64_t y = x; y != 0; y >>= 1) {
+    b++;
+  }
+  return b;
+#endif
+}
+
+
+static unsigned char *rat(const CADT_RadixHeap *const rh, const RBucket_ *b,
+                          const size_t i) {
+  return b->buf + i * rh->meta.memsz;
+}
+
+
+/* val may point into b itself, as a pointer returned by
+ * CADT_RadixHeap_peek does */
+static bool rappend(CADT_RadixHeap *rh, RBucket_ *b, const void *val) {
+  if (b->len == b->cap) {
+    const unsigned char *p = (const unsigned char *)val;
+    const bool inside =
+        b->buf != NULL && p >= b->buf && p < rat(rh, b, b->cap);
+    const size_t cap = b->cap ? b->cap * 2 : 8;
+    if (cap > SIZE_MAX / rh->meta.memsz) {
+      return false;
+    }
+    unsigned char *buf = (unsigned char *)CADT_realloc_(
+        &rh->alloc, b->buf, cap * rh->meta.memsz);
+    if (buf == NULL) {
+      return false;
+    }
+    if (inside) {
+      val = buf + (p - b->buf);
+    }
+    b->buf = buf;
+    b->cap = cap;
+  }
+  memmove(rat(rh, b, b->len), val, rh->meta.memsz);
+  b->len++;
+  return true;
+}
+
+
+/* fill bucket 0 if the heap is not empty. the lowest non empty bucket
+ * holds the smallest keys; its smallest one becomes last and every
+ * element of it moves to a lower bucket. false if a bucket could not
+ * grow, the elements not moved yet stay where they were. */
+static bool rsettle(CADT_RadixHeap *rh) {
+  if (rh->buckets[0].len > 0 || rh->meta.size == 0) {
+    return true;
+  }
+  size_t i = 1;
+  while (rh->buckets[i].len == 0) {
+    i++;
+  }
+  RBucket_ *b = &rh->buckets[i];
+  uint64_t min = rkey(rat(rh, b, 0));
+  for (size_t j = 1; j < b->len; j++) {
+    const uint64_t k = rkey(rat(rh, b, j));
+    min = k < min ? k : min;
+  }
+  rh->last = min;
+  while (b->len > 0) {
+    const void *val = rat(rh, b, b->len - 1);
+    if (!rappend(rh, &rh->buckets[rbucket(rh, rkey(val))], val)) {
+      return false;
+    }
+    b->len--;
+  }
+  return true;
+}
+
+
+/*-- interface --*/
+
+CADT_RadixHeap *CADT_RadixHeap_new(const size_t memsz) {
+  return CADT_RadixHeap_new_with(memsz, NULL);
+}
+
+
+/* rh and its buckets are allocated from alloc, NULL for the standard one.
+ * memsz covers the key */
+CADT_RadixHeap *CADT_RadixHeap_new_with(const size_t memsz,
+                                        const CADT_Allocator *alloc) {
+  const CADT_Allocator a = CADT_allocator_(alloc);
+  if (memsz < sizeof(uint64_t)) {
+    return NULL;
+  }
+  CADT_RadixHeap *rh =
+      (CADT_RadixHeap *)CADT_calloc_(&a, sizeof(CADT_RadixHeap));
+  if (rh == NULL) {
+    return NULL;
+  }
+  rh->tmp = (unsigned char *)CADT_alloc_(&a, memsz);
+  if (rh->tmp == NULL) {
+    CADT_free_(&a, rh);
+    return NULL;
+  }
+  rh->alloc = a;
+  rh->meta.memsz = memsz;
+  return rh;
+}
+
+
+size_t CADT_RadixHeap_size(const CADT_RadixHeap *rh) {
+  return rh == NULL ? 0 : rh->meta.size;
+}
+
+
+/* the key of the last element popped, inserts below it fail. a peek or
+ * pop that refills bucket 0 raises it to the smallest key held */
+uint64_t CADT_RadixHeap_last(const CADT_RadixHeap *rh) {
+  return rh == NULL ? 0 : rh->last;
+}
+
+
+/* false if the key of val is below the last key popped */
+bool CADT_RadixHeap_insert(CADT_RadixHeap *rh, const void *val) {
+  if (rh == NULL || val == NULL) {
+    return false;
+  }
+  const uint64_t key = rkey(val);
+  if (key < rh->last) {
+    return false;
+  }
+  if (!rappend(rh, &rh->buckets[rbucket(rh, key)], val)) {
+    return false;
+  }
+  rh->meta.size++;
+  return true;
+}
+
+
+/* the element with the smallest key, NULL if empty. it may move the
+ * elements between buckets, so it is not const */
+void *CADT_RadixHeap_peek(CADT_RadixHeap *rh) {
+  if (rh == NULL || rh->meta.size == 0 || !rsettle(rh)) {
+    return NULL;
+  }
+  RBucket_ *b = &rh->buckets[0];
+  return rat(rh, b, b->len - 1);
+}
+
+
+/* remove the element with the smallest key. it is copied out of the
+ * buckets, so the pointer returned stays valid through inserts and peeks
+ * until the next pop. NULL if empty */
+void *CADT_RadixHeap_popmin(CADT_RadixHeap *rh) {
+  if (rh == NULL || rh->meta.size == 0 || !rsettle(rh)) {
+    return NULL;
+  }
+  RBucket_ *b = &rh->buckets[0];
+  b->len--;
+  rh->meta.size--;
+  memcpy(rh->tmp, rat(rh, b, b->len), rh->meta.memsz);
+  return rh->tmp;
+}
+
+
+/* pop up to n elements into out in key order, return how many */
+size_t CADT_RadixHeap_pop_into(CADT_RadixHeap *rh, void *out,
+                               const size_t n) {
+  if (rh == NULL || out == NULL) {
+    return 0;
+  }
+  unsigned char *dst = (unsigned char *)out;
+  size_t i = 0;
+  for (; i < n; i++) {
+    const void *val = CADT_RadixHeap_popmin(rh);
+    if (val == NULL) {
+      break;
+    }
+    memcpy(dst + i * rh->meta.memsz, val, rh->meta.memsz);
+  }
+  return i;
+}
+
+
+void CADT_RadixHeap_free(CADT_RadixHeap *rh) {
+  if (rh == NULL) {
+    return;
+  }
+  const CADT_Allocator a = rh->alloc;
+  for (size_t i = 0; i < CADT_RADIXHEAP_BUCKETS; i++) {
+    CADT_free_(&a, rh->buckets[i].buf);
+  }
+  CADT_free_(&a, rh->tmp);
+  CADT_free_(&a, rh);
+}
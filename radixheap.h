@@ -0,0 +1,32 @@
+#ifndef _CADT_RADIXHEAP
+#define _CADT_RADIXHEAP
+
+#include "allocator.h"
+#include "cadt.h"
+#include <stdint.h>
+
+/* a key equal to last goes to bucket 0, any other one to bucket b, where
+ * b - 1 is the highest bit in which it differs from last */
+#define CADT_RADIXHEAP_BUCKETS 65
+
+typedef struct RBucket_ {
+  unsigned char *buf;
+  size_t len; /* elements */
+  size_t cap;
+} RBucket_;
+
+/* a min heap of elements keyed by an unsigned 64 bit integer, for keys
+ * that never go below the last key popped. last only grows, so an element
+ * moves to a lower bucket at most 64 times. */
+typedef struct CADT_RadixHeap {
+  RBucket_ buckets[CADT_RADIXHEAP_BUCKETS];
+  uint64_t last; /* the last key popped, no key in the heap is smaller */
+  unsigned char *tmp; /* memsz bytes, the element last popped */
+  struct {
+    size_t size;
+    size_t memsz;
+  } meta;
+  CADT_Allocator alloc;
+} CADT_RadixHeap;
+
+#endif /* ifndef _CADT_RADIXHEAP */
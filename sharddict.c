@@ -0,0 +1,194 @@
+/* A concurrent dictionary made of CADT_Dict shards. Each shard has its own
+ * reader writer lock, so readers of a shard run in parallel and writers
+ * only contend with operations on the same shard. Values are copied out
+ * under the lock because a pointer into a shard is invalidated as soon as
+ * another thread writes to it. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "sharddict.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* shards used when the caller does not ask for a number */
+#define CADT_SHARDDICT_DEFAULT_SHARDS 64
+
+
+static Shard_ *sdshard(const CADT_ShardDict *const sd, const uint64_t h) {
+  return &sd->shards[sd->meta.shift < 64 ? h >> sd->meta.shift : 0];
+}
+
+
+static uint64_t sdhash(const CADT_ShardDict *const sd, const void *const key) {
+  return CADT_Dict_hash_(sd->shards[0].dict, key);
+}
+
+
+static void sdfree(CADT_ShardDict *sd, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    pthread_rwlock_destroy(&sd->shards[i].lock);
+    CADT_Dict_free(sd->shards[i].dict);
+  }
+  free(sd->shards);
+  free(sd);
+}
+
+
+static CADT_ShardDict *sdalloc(const size_t keysz, const size_t valsz,
+                               const size_t nshards, CADT_Hasher hasher,
+                               const CADT_Allocator *const alloc) {
+  CADT_ShardDict *sd = (CADT_ShardDict *)malloc(sizeof(CADT_ShardDict));
+  if (sd == NULL) {
+    return NULL;
+  }
+
+  size_t n = 1;
+  unsigned bits = 0;
+  while (n < nshards) {
+    n *= 2;
+    bits++;
+  }
+  sd->meta.nshards = n;
+  sd->meta.shift = 64 - bits;
+  sd->meta.keysz = keysz;
+  sd->meta.valsz = valsz;
+  sd->shards = (Shard_ *)aligned_alloc(_Alignof(Shard_), n * sizeof(Shard_));
+  if (sd->shards == NULL) {
+    free(sd);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    Shard_ *s = &sd->shards[i];
+    s->dict = CADT_Dict_new_with(keysz, valsz, hasher, alloc);
+    if (s->dict == NULL) {
+      sdfree(sd, i);
+      return NULL;
+    }
+    if (pthread_rwlock_init(&s->lock, NULL) != 0) {
+      CADT_Dict_free(s->dict);
+      sdfree(sd, i);
+      return NULL;
+    }
+    /* a key must hash the same whichever shard computes it */
+    s->dict->seed = sd->shards[0].dict->seed;
+  }
+  return sd;
+}
+
+
+/* -- interface -- */
+
+CADT_ShardDict *CADT_ShardDict_new(const size_t keysz, const size_t valsz,
+                                   const size_t nshards) {
+  if (keysz == 0) {
+    return NULL;
+  }
+  return sdalloc(keysz, valsz,
+                 nshards ? nshards : CADT_SHARDDICT_DEFAULT_SHARDS, NULL,
+                 NULL);
+}
+
+
+CADT_ShardDict *CADT_ShardDict_new_hasher(const size_t keysz,
+                                          const size_t valsz,
+                                          const size_t nshards,
+                                          CADT_Hasher hasher) {
+  if (keysz == 0) {
+    return NULL;
+  }
+  return sdalloc(keysz, valsz,
+                 nshards ? nshards : CADT_SHARDDICT_DEFAULT_SHARDS, hasher,
+                 NULL);
+}
+
+
+/* the shard dicts are allocated from alloc, NULL for the standard one,
+ * and hasher may be NULL for the built in hash. shards are written under
+ * their own locks at the same time, so alloc must be thread safe unless
+ * a single thread writes; the arena and the pool are not. */
+CADT_ShardDict *CADT_ShardDict_new_with(const size_t keysz,
+                                        const size_t valsz,
+                                        const size_t nshards,
+                                        CADT_Hasher hasher,
+                                        const CADT_Allocator *alloc) {
+  if (keysz == 0) {
+    return NULL;
+  }
+  return sdalloc(keysz, valsz,
+                 nshards ? nshards : CADT_SHARDDICT_DEFAULT_SHARDS, hasher,
+                 alloc);
+}
+
+
+bool CADT_ShardDict_put(CADT_ShardDict *sd, const void *key, const void *val,
+                        CADTDictMode mode) {
+  if (sd == NULL || key == NULL) {
+    return false;
+  }
+  const uint64_t h = sdhash(sd, key);
+  Shard_ *s = sdshard(sd, h);
+
+  pthread_rwlock_wrlock(&s->lock);
+  const bool ok = CADT_Dict_put_(s->dict, key, val, h, mode);
+  pthread_rwlock_unlock(&s->lock);
+  return ok;
+}
+
+
+/* copy the value of key into val. return false if key is not stored */
+bool CADT_ShardDict_get(CADT_ShardDict *sd, const void *key, void *val) {
+  if (sd == NULL || key == NULL) {
+    return false;
+  }
+  const uint64_t h = sdhash(sd, key);
+  Shard_ *s = sdshard(sd, h);
+
+  pthread_rwlock_rdlock(&s->lock);
+  const void *p = CADT_Dict_get_(s->dict, key, h);
+  if (p != NULL && val != NULL) {
+    memcpy(val, p, sd->meta.valsz);
+  }
+  pthread_rwlock_unlock(&s->lock);
+  return p != NULL;
+}
+
+
+bool CADT_ShardDict_remove(CADT_ShardDict *sd, const void *key) {
+  if (sd == NULL || key == NULL) {
+    return false;
+  }
+  const uint64_t h = sdhash(sd, key);
+  Shard_ *s = sdshard(sd, h);
+
+  pthread_rwlock_wrlock(&s->lock);
+  const bool ok = CADT_Dict_remove_(s->dict, key, h);
+  pthread_rwlock_unlock(&s->lock);
+  return ok;
+}
+
+
+/* shards are summed one at a time, the result is only exact when no other
+ * thread is writing. */
+size_t CADT_ShardDict_size(CADT_ShardDict *sd) {
+  if (sd == NULL) {
+    return 0;
+  }
+  size_t size = 0;
+  for (size_t i = 0; i < sd->meta.nshards; i++) {
+    Shard_ *s = &sd->shards[i];
+    pthread_rwlock_rdlock(&s->lock);
+    size += s->dict->meta.size;
+    pthread_rwlock_unlock(&s->lock);
+  }
+  return size;
+}
+
+
+void CADT_ShardDict_free(CADT_ShardDict *sd) {
+  if (sd == NULL) {
+    return;
+  }
+  sdfree(sd, sd->meta.nshards);
+}
+
+#undef CADT_SHARDDICT_DEFAULT_SHARDS
@@ -0,0 +1,28 @@
+#ifndef _CADT_SHARDDICT
+#define _CADT_SHARDDICT
+
+#include "cadt.h"
+#include "dict.h"
+#include <pthread.h>
+
+/* every shard sits on its own cache lines so writers of one shard do not
+ * invalidate the lock of its neighbours. */
+typedef struct Shard_ {
+  _Alignas(CADT_CACHELINE) pthread_rwlock_t lock;
+  CADT_Dict *dict;
+} Shard_;
+
+/* a CADT_Dict split into independently locked shards. a key is hashed
+ * once, its high bits pick the shard and the rest is used by the shard
+ * dict. all shards share the same hasher and seed. */
+typedef struct CADT_ShardDict {
+  Shard_ *shards;
+  struct {
+    size_t nshards; /* a power of 2 */
+    unsigned shift; /* 64 - log2(nshards) */
+    size_t keysz;
+    size_t valsz;
+  } meta;
+} CADT_ShardDict;
+
+#endif /* ifndef _CADT_SHARDDICT */
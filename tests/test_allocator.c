@@ -0,0 +1,184 @@
+#include "unity.h"
+#include "../allocator.h"
+#include "../cadt.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ALIGN _Alignof(max_align_t)
+
+static long live; /* allocations not freed yet */
+
+static void *track_alloc(void *ctx, size_t n) {
+  (void)ctx;
+  void *p = malloc(n);
+  live += p != NULL;
+  return p;
+}
+
+static void *track_realloc(void *ctx, void *p, size_t n) {
+  (void)ctx;
+  void *q = realloc(p, n);
+  live += p == NULL && q != NULL;
+  return q;
+}
+
+static void track_free(void *ctx, void *p) {
+  (void)ctx;
+  live--;
+  free(p);
+}
+
+static const CADT_Allocator tracking = {track_alloc, track_realloc,
+                                        track_free, NULL};
+
+static int cmp_long(const void *a, const void *b) {
+  const long x = *(const long *)a;
+  const long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+static bool aligned(const void *p) { return (uintptr_t)p % ALIGN == 0; }
+
+void setUp() {
+  live = 0;
+}
+
+void tearDown() {
+}
+
+void test_CADT_Arena() {
+  CADT_Arena *arena = CADT_Arena_new(0);
+  TEST_ASSERT_NOT_NULL(arena);
+  CADT_Allocator a = CADT_Arena_allocator(arena);
+  unsigned char *blocks[200];
+  for (size_t i = 0; i < 200; i++) {
+    /* some larger than a chunk */
+    const size_t n = i % 50 == 49 ? 10000 : i + 1;
+    blocks[i] = (unsigned char *)CADT_alloc_(&a, n);
+    TEST_ASSERT_NOT_NULL(blocks[i]);
+    TEST_ASSERT_TRUE(aligned(blocks[i]));
+    memset(blocks[i], (int)i, n);
+  }
+  /* no allocation overlaps another */
+  for (size_t i = 0; i < 200; i++) {
+    const size_t n = i % 50 == 49 ? 10000 : i + 1;
+    for (size_t j = 0; j < n; j++) {
+      TEST_ASSERT_EQUAL_INT((unsigned char)i, blocks[i][j]);
+    }
+  }
+
+  /* the latest allocation grows in place, an older one moves */
+  unsigned char *p = (unsigned char *)CADT_alloc_(&a, 16);
+  memset(p, 7, 16);
+  unsigned char *q = (unsigned char *)CADT_realloc_(&a, p, 64);
+  TEST_ASSERT_EQUAL_PTR(p, q);
+  unsigned char *r = (unsigned char *)CADT_realloc_(&a, blocks[10], 500);
+  TEST_ASSERT_TRUE(r != blocks[10]);
+  for (size_t j = 0; j < 11; j++) {
+    TEST_ASSERT_EQUAL_INT(10, r[j]);
+  }
+  for (size_t j = 0; j < 16; j++) {
+    TEST_ASSERT_EQUAL_INT(7, q[j]);
+  }
+
+  /* a reset keeps the newest chunk, so the next allocation reuses it */
+  CADT_Arena_reset(arena);
+  void *s = CADT_alloc_(&a, 8);
+  CADT_free_(&a, s);
+  TEST_ASSERT_EQUAL_PTR(s, CADT_alloc_(&a, 8));
+  CADT_Arena_free(arena);
+}
+
+void test_CADT_Pool() {
+  CADT_Pool *pool = CADT_Pool_new(24, 8);
+  TEST_ASSERT_NOT_NULL(pool);
+  CADT_Allocator a = CADT_Pool_allocator(pool);
+  void *blocks[100];
+  for (size_t i = 0; i < 100; i++) {
+    blocks[i] = CADT_alloc_(&a, 24);
+    TEST_ASSERT_NOT_NULL(blocks[i]);
+    TEST_ASSERT_TRUE(aligned(blocks[i]));
+    memset(blocks[i], (int)i, 24);
+  }
+  for (size_t i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL_INT((unsigned char)i, ((unsigned char *)blocks[i])[23]);
+  }
+  TEST_ASSERT_NULL(CADT_alloc_(&a, 100));
+  TEST_ASSERT_EQUAL_PTR(blocks[0], CADT_realloc_(&a, blocks[0], 10));
+  TEST_ASSERT_NULL(CADT_realloc_(&a, blocks[0], 100));
+  /* freed blocks are handed out again, the latest first */
+  CADT_free_(&a, blocks[3]);
+  CADT_free_(&a, blocks[50]);
+  TEST_ASSERT_EQUAL_PTR(blocks[50], CADT_alloc_(&a, 1));
+  TEST_ASSERT_EQUAL_PTR(blocks[3], CADT_alloc_(&a, 1));
+  CADT_Pool_free(pool);
+  TEST_ASSERT_NULL(CADT_Pool_new(0, 8));
+}
+
+void test_containers_release_everything() {
+  /* every container gives back what it took from its allocator */
+  CADT_Vec *v = CADT_Vec_new_with(0, sizeof(long), &tracking);
+  CADT_Dict *d = CADT_Dict_new_with(sizeof(long), sizeof(long), NULL,
+                                    &tracking);
+  CADT_Deque *dq = CADT_Deque_new_with(sizeof(long), &tracking);
+  CADT_Heap *h = CADT_Heap_new_with(0, sizeof(long), MIN, cmp_long, &tracking);
+  CADT_TopK *t = CADT_TopK_new(10, sizeof(long), MAX, cmp_long, &tracking);
+  CADT_RadixHeap *rh = CADT_RadixHeap_new_with(sizeof(uint64_t), &tracking);
+  TEST_ASSERT_TRUE(v && d && dq && h && t && rh);
+  for (long i = 0; i < 5000; i++) {
+    long x = (i * 7919) % 5000;
+    uint64_t key = (uint64_t)i;
+    CADT_Vec_push(v, &x, sizeof(x));
+    CADT_Dict_put(d, &x, &i, OVERWRITE);
+    CADT_Deque_push(dq, &x);
+    CADT_Heap_insert(h, &x);
+    CADT_TopK_push(t, &x);
+    CADT_RadixHeap_insert(rh, &key);
+  }
+  for (long i = 0; i < 2500; i++) {
+    long x;
+    CADT_Vec_pop_into(v, &x);
+    CADT_Dict_remove(d, &x);
+    CADT_Deque_popl(dq, &x);
+    CADT_Heap_pop_into(h, &x, 1);
+    CADT_RadixHeap_popmin(rh);
+  }
+  TEST_ASSERT_TRUE(live > 0);
+  CADT_Vec_free(v);
+  CADT_Dict_free(d);
+  CADT_Deque_free(dq);
+  CADT_Heap_free(h);
+  CADT_TopK_free(t);
+  CADT_RadixHeap_free(rh);
+  TEST_ASSERT_EQUAL_INT64(0, live);
+}
+
+void test_containers_on_arena() {
+  CADT_Arena *arena = CADT_Arena_new(1 << 16);
+  CADT_Allocator a = CADT_Arena_allocator(arena);
+  for (int round = 0; round < 3; round++) {
+    CADT_Dict *d = CADT_Dict_new_with(sizeof(long), sizeof(long), NULL, &a);
+    CADT_Vec *v = CADT_Vec_new_with(0, sizeof(long), &a);
+    for (long i = 0; i < 3000; i++) {
+      long x = i * 3;
+      CADT_Dict_put(d, &i, &x, OVERWRITE);
+      CADT_Vec_push(v, &x, sizeof(x));
+    }
+    for (long i = 0; i < 3000; i++) {
+      TEST_ASSERT_EQUAL_INT64(i * 3, *(long *)CADT_Dict_get(d, &i));
+      TEST_ASSERT_EQUAL_INT64(i * 3, *(long *)CADT_Vec_get_ref(v, i));
+    }
+    /* nothing is freed one by one, the reset takes it all */
+    CADT_Arena_reset(arena);
+  }
+  CADT_Arena_free(arena);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Arena);
+  RUN_TEST(test_CADT_Pool);
+  RUN_TEST(test_containers_release_everything);
+  RUN_TEST(test_containers_on_arena);
+  return UNITY_END();
+}
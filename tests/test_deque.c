@@ -0,0 +1,182 @@
+#include "unity.h"
+#include "../deque.h"
+#include "../cadt.h"
+
+#define MAXN 20000
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/* the reference keeps the deque in ref[0..n), head first */
+static long ref[MAXN];
+static size_t n;
+
+static void ref_rotate(const size_t k) {
+  static long tmp[MAXN];
+  for (size_t i = 0; i < n; i++) {
+    tmp[i] = ref[(i + k) % n];
+  }
+  memcpy(ref, tmp, n * sizeof(long));
+}
+
+static void check_ref(CADT_Deque *d) {
+  TEST_ASSERT_EQUAL_size_t(n, CADT_Deque_size(d));
+  for (size_t i = 0; i < n; i++) {
+    TEST_ASSERT_EQUAL_INT64(ref[i], *(long *)CADT_Deque_get(d, i));
+  }
+  TEST_ASSERT_NULL(CADT_Deque_get(d, n));
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+  n = 0;
+}
+
+void tearDown() {
+}
+
+void test_CADT_Deque_rotate_then_grow() {
+  /* 4096 longs fill the first ring exactly, then rotate by less than a
+   * chunk and make it grow */
+  const size_t shifts[] = {1, 5, 511, 512, 513, 1024, 4095};
+  for (size_t s = 0; s < sizeof(shifts) / sizeof(shifts[0]); s++) {
+    CADT_Deque *d = CADT_Deque_new(sizeof(long));
+    for (n = 0; n < 4096; n++) {
+      ref[n] = (long)n;
+      CADT_Deque_pushl(d, &ref[n]);
+    }
+    CADT_Deque_rotate(d, shifts[s]);
+    ref_rotate(shifts[s]);
+    check_ref(d);
+    long x;
+    TEST_ASSERT_TRUE(CADT_Deque_pop(d, &x));
+    TEST_ASSERT_EQUAL_INT64(ref[0], x);
+    memmove(ref, ref + 1, --n * sizeof(long));
+    for (long i = 0; i < 3000; i++) {
+      x = -i;
+      TEST_ASSERT_TRUE(CADT_Deque_pushl(d, &x));
+      ref[n++] = x;
+    }
+    check_ref(d);
+    CADT_Deque_free(d);
+  }
+}
+
+void test_CADT_Deque_random() {
+  for (int round = 0; round < 20; round++) {
+    CADT_Deque *d = CADT_Deque_new(sizeof(long));
+    n = 0;
+    /* later rounds lean towards growing, so the ring fills up */
+    const uint64_t grow = 50 + (uint64_t)round * 2;
+    for (int op = 0; op < 20000; op++) {
+      const uint64_t r = next_rand() % 100;
+      long x = (long)next_rand();
+      if (r < grow / 2 && n < MAXN) {
+        TEST_ASSERT_TRUE(CADT_Deque_push(d, &x));
+        memmove(ref + 1, ref, n++ * sizeof(long));
+        ref[0] = x;
+      } else if (r < grow && n < MAXN) {
+        TEST_ASSERT_TRUE(CADT_Deque_pushl(d, &x));
+        ref[n++] = x;
+      } else if (r < grow + 15) {
+        long out;
+        TEST_ASSERT_EQUAL(n > 0, CADT_Deque_pop(d, &out));
+        if (n > 0) {
+          TEST_ASSERT_EQUAL_INT64(ref[0], out);
+          memmove(ref, ref + 1, --n * sizeof(long));
+        }
+      } else if (r < grow + 30) {
+        long out;
+        TEST_ASSERT_EQUAL(n > 0, CADT_Deque_popl(d, &out));
+        if (n > 0) {
+          TEST_ASSERT_EQUAL_INT64(ref[--n], out);
+        }
+      } else if (r < 97) {
+        const size_t k = (size_t)next_rand() % (2 * n + 1);
+        CADT_Deque_rotate(d, k);
+        if (n > 0) {
+          ref_rotate(k % n);
+        }
+      } else if (n > 0) {
+        const size_t i = (size_t)next_rand() % n;
+        x = ref[i];
+        TEST_ASSERT_TRUE(CADT_Deque_remove(d, &x));
+        /* the first equal one goes, values are random so it is this one */
+        memmove(ref + i, ref + i + 1, (--n - i) * sizeof(long));
+      }
+      if (op % 1000 == 0) {
+        check_ref(d);
+      }
+    }
+    check_ref(d);
+    long missing = 0;
+    while (n > 0 && CADT_Deque_remove(d, &ref[n - 1])) {
+      n--;
+    }
+    TEST_ASSERT_EQUAL_size_t(0, CADT_Deque_size(d));
+    TEST_ASSERT_FALSE(CADT_Deque_remove(d, &missing));
+    TEST_ASSERT_FALSE(CADT_Deque_pop(d, NULL));
+    TEST_ASSERT_FALSE(CADT_Deque_popl(d, NULL));
+    CADT_Deque_free(d);
+  }
+}
+
+void test_CADT_Deque_wide() {
+  /* elements wider than a chunk get a chunk each */
+  unsigned char big[5000];
+  CADT_Deque *d = CADT_Deque_new(sizeof(big));
+  for (int i = 0; i < 40; i++) {
+    memset(big, i, sizeof(big));
+    TEST_ASSERT_TRUE(i % 2 ? CADT_Deque_push(d, big)
+                           : CADT_Deque_pushl(d, big));
+  }
+  CADT_Deque_rotate(d, 7);
+  /* heads were pushed as 39, 37, .. 1, tails as 0, 2, .. 38 */
+  for (int i = 0; i < 40; i++) {
+    const int j = (i + 7) % 40;
+    const int want = j < 20 ? 39 - 2 * j : 2 * (j - 20);
+    const unsigned char *p = (const unsigned char *)CADT_Deque_get(d, i);
+    TEST_ASSERT_EQUAL_INT(want, p[0]);
+    TEST_ASSERT_EQUAL_INT(want, p[sizeof(big) - 1]);
+  }
+  CADT_Deque_free(d);
+}
+
+void test_CADT_Deque_maxlen() {
+  long a = 1;
+  long b = 2;
+  long c = 3;
+  CADT_Deque *d = CADT_Deque_init(3, sizeof(long), &a, &b, &c);
+  TEST_ASSERT_EQUAL_size_t(3, CADT_Deque_size(d));
+  TEST_ASSERT_FALSE(CADT_Deque_set_maxlen(d, 2));
+  TEST_ASSERT_TRUE(CADT_Deque_set_maxlen(d, 4));
+  TEST_ASSERT_TRUE(CADT_Deque_push(d, &c));
+  TEST_ASSERT_FALSE(CADT_Deque_push(d, &c));
+  TEST_ASSERT_FALSE(CADT_Deque_pushl(d, &c));
+  long out;
+  TEST_ASSERT_TRUE(CADT_Deque_popl(d, &out));
+  TEST_ASSERT_EQUAL_INT64(3, out);
+  TEST_ASSERT_TRUE(CADT_Deque_pushl(d, &a));
+  TEST_ASSERT_TRUE(CADT_Deque_set_maxlen(d, 0));
+  TEST_ASSERT_TRUE(CADT_Deque_push(d, &a));
+  const long want[] = {1, 3, 1, 2, 1};
+  for (size_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL_INT64(want[i], *(long *)CADT_Deque_get(d, i));
+  }
+  CADT_Deque_free(d);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Deque_rotate_then_grow);
+  RUN_TEST(test_CADT_Deque_random);
+  RUN_TEST(test_CADT_Deque_wide);
+  RUN_TEST(test_CADT_Deque_maxlen);
+  return UNITY_END();
+}
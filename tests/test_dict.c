@@ -0,0 +1,483 @@
+#include "unity.h"
+#include "../dict.h"
+#include "../cadt.h"
+#include <stdio.h>
+
+#define NKEYS 4096
+
+static uint64_t rng;
+static bool present[NKEYS];
+static long ref[NKEYS];
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/* every key lands in the same group with the same tag */
+static uint64_t same_hash(const void *key, size_t nbyte, uint64_t seed) {
+  (void)key;
+  (void)nbyte;
+  (void)seed;
+  return 42;
+}
+
+static size_t hasher_calls;
+
+static uint64_t counting_hash(const void *key, size_t nbyte, uint64_t seed) {
+  hasher_calls++;
+  TEST_ASSERT_EQUAL_size_t(sizeof(uint64_t), nbyte);
+  return CADT_hash(key, nbyte, seed);
+}
+
+/* a distinct key of 2 to 70 bytes for each i, NULs included */
+static size_t make_key(unsigned char *key, const uint64_t i) {
+  const size_t n = (size_t)snprintf((char *)key, 24, "%llu:",
+                                    (unsigned long long)i);
+  const size_t pad = i % 50;
+  for (size_t j = 0; j < pad; j++) {
+    key[n + j] = (unsigned char)(i * 31 + j);
+  }
+  return n + pad;
+}
+
+static void check_ref_bytes(CADT_Dict *d) {
+  unsigned char key[80];
+  size_t n = 0;
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    const size_t keylen = make_key(key, k);
+    long *v = (long *)CADT_Dict_get_bytes(d, key, keylen);
+    if (present[k]) {
+      TEST_ASSERT_NOT_NULL(v);
+      TEST_ASSERT_EQUAL_INT64(ref[k], *v);
+      n++;
+    } else {
+      TEST_ASSERT_NULL(v);
+    }
+    /* a proper prefix is another key */
+    TEST_ASSERT_NULL(CADT_Dict_get_bytes(d, key, keylen - 1));
+  }
+  TEST_ASSERT_EQUAL_size_t(n, d->meta.size);
+}
+
+static void check_ref(CADT_Dict *d) {
+  size_t n = 0;
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    long *v = (long *)CADT_Dict_get(d, &k);
+    if (present[k]) {
+      TEST_ASSERT_NOT_NULL(v);
+      TEST_ASSERT_EQUAL_INT64(ref[k], *v);
+      n++;
+    } else {
+      TEST_ASSERT_NULL(v);
+    }
+  }
+  TEST_ASSERT_EQUAL_size_t(n, d->meta.size);
+}
+
+void setUp(void) {
+  rng = 0x9e3779b97f4a7c15ull;
+  memset(present, 0, sizeof(present));
+}
+
+void tearDown(void) {
+}
+
+void test_CADT_Dict_put_get_random(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  for (int i = 0; i < 20000; i++) {
+    uint64_t k = next_rand() % NKEYS;
+    long v = (long)next_rand();
+    const CADTDictMode mode = next_rand() & 1 ? OVERWRITE : IGNORE;
+    CADT_Dict_put(d, &k, &v, mode);
+    if (!present[k] || mode == OVERWRITE) {
+      ref[k] = v;
+    }
+    present[k] = true;
+  }
+  check_ref(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_full_groups(void) {
+  /* with one tag and one home group every lookup walks full groups and
+   * compares each tag match */
+  CADT_Dict *d = CADT_Dict_new_hasher(sizeof(uint64_t), sizeof(long),
+                                      same_hash);
+  TEST_ASSERT_NOT_NULL(d);
+  for (uint64_t k = 0; k < 200; k++) {
+    long v = (long)k * 3;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+    present[k] = true;
+    ref[k] = v;
+  }
+  check_ref(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_empty(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  check_ref(d);
+  TEST_ASSERT_NULL(CADT_Dict_new(0, sizeof(long)));
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_remove_random(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  for (int i = 1; i <= 40000; i++) {
+    uint64_t k = next_rand() % NKEYS;
+    if (next_rand() % 3 == 0) {
+      TEST_ASSERT_EQUAL(present[k], CADT_Dict_remove(d, &k));
+      present[k] = false;
+    } else {
+      long v = (long)next_rand();
+      CADT_Dict_put(d, &k, &v, OVERWRITE);
+      present[k] = true;
+      ref[k] = v;
+    }
+    if (i % 5000 == 0) {
+      check_ref(d);
+    }
+  }
+  check_ref(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_lookup_while_rehashing(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  size_t seen = 0;
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    long v = (long)k + 1;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+    present[k] = true;
+    ref[k] = v;
+    if (d->ht[1].ctrl != NULL) {
+      /* items are split between the two tables */
+      seen++;
+      if (seen % 64 == 1) {
+        check_ref(d);
+      }
+    }
+  }
+  TEST_ASSERT_GREATER_THAN(0, seen);
+  check_ref(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_remove_all_shrinks(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    long v = (long)k;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+  }
+  const size_t full = d->ht[0].len;
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    TEST_ASSERT_TRUE(CADT_Dict_remove(d, &k));
+    TEST_ASSERT_FALSE(CADT_Dict_remove(d, &k));
+  }
+  /* a few more operations let a pending rehash finish */
+  for (uint64_t k = 0; k < 64; k++) {
+    CADT_Dict_get(d, &k);
+  }
+  TEST_ASSERT_EQUAL_size_t(0, d->meta.size);
+  TEST_ASSERT_NULL(d->ht[1].ctrl);
+  TEST_ASSERT_TRUE(d->ht[0].len < full);
+  check_ref(d);
+  /* the tombstones left behind must not hide keys put again */
+  for (uint64_t k = 0; k < NKEYS; k += 7) {
+    long v = -(long)k;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+    present[k] = true;
+    ref[k] = v;
+  }
+  check_ref(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_hash(void) {
+  unsigned char buf[128 + 1];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = (unsigned char)next_rand();
+  }
+  for (size_t n = 0; n <= 128; n++) {
+    const uint64_t h = CADT_hash(buf, n, 7);
+    TEST_ASSERT_EQUAL_UINT64(h, CADT_hash(buf, n, 7));
+    TEST_ASSERT_TRUE(h != CADT_hash(buf, n, 8));
+    /* the same bytes at an unaligned address */
+    unsigned char copy[128 + 1];
+    memcpy(copy + 1, buf, n);
+    TEST_ASSERT_EQUAL_UINT64(h, CADT_hash(copy + 1, n, 7));
+    /* a flipped bit anywhere in the key changes the hash */
+    for (size_t i = 0; i < n; i++) {
+      buf[i] ^= 0x10;
+      TEST_ASSERT_TRUE(h != CADT_hash(buf, n, 7));
+      buf[i] ^= 0x10;
+    }
+    if (n > 0) {
+      TEST_ASSERT_TRUE(h != CADT_hash(buf, n - 1, 7));
+    }
+  }
+}
+
+void test_CADT_Dict_key_widths(void) {
+  const size_t widths[] = {1, 3, 4, 8, 12, 16, 33, 100};
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    const size_t keysz = widths[w];
+    CADT_Dict *d = CADT_Dict_new(keysz, sizeof(long));
+    TEST_ASSERT_NOT_NULL(d);
+    const size_t n = keysz == 1 ? 256 : 1000;
+    unsigned char key[100];
+    for (size_t i = 0; i < n; i++) {
+      memset(key, 0xa5, keysz);
+      memcpy(key, &i, keysz < sizeof(i) ? keysz : sizeof(i));
+      long v = (long)i;
+      CADT_Dict_put(d, key, &v, OVERWRITE);
+    }
+    TEST_ASSERT_EQUAL_size_t(n, d->meta.size);
+    for (size_t i = 0; i < n; i++) {
+      memset(key, 0xa5, keysz);
+      memcpy(key, &i, keysz < sizeof(i) ? keysz : sizeof(i));
+      /* items are packed, a value after an odd key is unaligned */
+      const void *p = CADT_Dict_get(d, key);
+      TEST_ASSERT_NOT_NULL(p);
+      long v;
+      memcpy(&v, p, sizeof(v));
+      TEST_ASSERT_EQUAL_INT64((long)i, v);
+    }
+    CADT_Dict_free(d);
+  }
+}
+
+void test_CADT_Dict_new_hasher(void) {
+  hasher_calls = 0;
+  CADT_Dict *d = CADT_Dict_new_hasher(sizeof(uint64_t), sizeof(long),
+                                      counting_hash);
+  TEST_ASSERT_NOT_NULL(d);
+  for (int i = 0; i < 5000; i++) {
+    uint64_t k = next_rand() % NKEYS;
+    long v = (long)i;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+    present[k] = true;
+    ref[k] = v;
+  }
+  TEST_ASSERT_TRUE(hasher_calls >= 5000);
+  check_ref(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_put_many_get_many(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  static uint64_t keys[1000];
+  static long vals[1000];
+  static void *out[1000];
+  for (int round = 0; round < 20; round++) {
+    /* odd lengths leave a partial batch, keys repeat within a batch */
+    const size_t n = 1 + next_rand() % 999;
+    const CADTDictMode mode = round & 1 ? OVERWRITE : IGNORE;
+    for (size_t i = 0; i < n; i++) {
+      keys[i] = next_rand() % NKEYS;
+      vals[i] = (long)next_rand();
+      if (!present[keys[i]] || mode == OVERWRITE) {
+        ref[keys[i]] = vals[i];
+      }
+      present[keys[i]] = true;
+    }
+    CADT_Dict_put_many(d, keys, vals, n, mode);
+    check_ref(d);
+
+    size_t hits = 0;
+    for (size_t i = 0; i < n; i++) {
+      keys[i] = next_rand() % (2 * NKEYS);
+      hits += keys[i] < NKEYS && present[keys[i]];
+    }
+    TEST_ASSERT_EQUAL_size_t(hits, CADT_Dict_get_many(d, keys, n, out));
+    for (size_t i = 0; i < n; i++) {
+      TEST_ASSERT_EQUAL_PTR(CADT_Dict_get(d, &keys[i]), out[i]);
+    }
+  }
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_varkey_random(void) {
+  CADT_Dict *d = CADT_Dict_new_varkey(sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  unsigned char key[80];
+  for (int i = 1; i <= 40000; i++) {
+    const uint64_t k = next_rand() % NKEYS;
+    const size_t keylen = make_key(key, k);
+    if (next_rand() % 3 == 0) {
+      TEST_ASSERT_EQUAL(present[k], CADT_Dict_remove_bytes(d, key, keylen));
+      present[k] = false;
+    } else {
+      long v = (long)next_rand();
+      CADT_Dict_put_bytes(d, key, keylen, &v, OVERWRITE);
+      present[k] = true;
+      ref[k] = v;
+    }
+    if (i % 10000 == 0) {
+      check_ref_bytes(d);
+    }
+  }
+  /* the empty key is a key like any other */
+  long v = 7;
+  CADT_Dict_put_bytes(d, "", 0, &v, OVERWRITE);
+  TEST_ASSERT_EQUAL_INT64(7, *(long *)CADT_Dict_get_bytes(d, "x", 0));
+  TEST_ASSERT_TRUE(CADT_Dict_remove_bytes(d, "", 0));
+  check_ref_bytes(d);
+  /* the fixed size interface does not apply */
+  uint64_t k = 0;
+  TEST_ASSERT_NULL(CADT_Dict_get(d, &k));
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_varkey_arena_reuse(void) {
+  /* removing and putting back every key many times must compact the key
+   * arena rather than grow it without bound */
+  CADT_Dict *d = CADT_Dict_new_varkey(sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  unsigned char key[80];
+  size_t live = 0;
+  for (uint64_t k = 0; k < 500; k++) {
+    live += make_key(key, k);
+  }
+  for (int round = 0; round < 20; round++) {
+    for (uint64_t k = 0; k < 500; k++) {
+      const size_t keylen = make_key(key, k);
+      if (round > 0) {
+        TEST_ASSERT_TRUE(CADT_Dict_remove_bytes(d, key, keylen));
+      }
+      long v = round * 1000 + (long)k;
+      CADT_Dict_put_bytes(d, key, keylen, &v, OVERWRITE);
+      present[k] = true;
+      ref[k] = v;
+    }
+    /* compacting leaves twice the live bytes, which may double once
+     * before half of it is dead again */
+    TEST_ASSERT_TRUE(d->arena.cap <= 4 * live);
+  }
+  check_ref_bytes(d);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_compact_order(void) {
+  /* iteration follows insertion order. overwriting keeps the place of a
+   * key, removing it and putting it back moves it to the end */
+  static uint64_t seq[NKEYS];
+  CADT_Dict *d = CADT_Dict_new_compact(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  uint64_t clock = 0;
+  for (int i = 1; i <= 30000; i++) {
+    uint64_t k = next_rand() % NKEYS;
+    if (next_rand() % 3 == 0) {
+      TEST_ASSERT_EQUAL(present[k], CADT_Dict_remove(d, &k));
+      present[k] = false;
+    } else {
+      long v = (long)next_rand();
+      CADT_Dict_put(d, &k, &v, OVERWRITE);
+      if (!present[k]) {
+        seq[k] = ++clock;
+      }
+      present[k] = true;
+      ref[k] = v;
+    }
+    if (i % 3000 == 0) {
+      check_ref(d);
+      uint64_t last = 0;
+      size_t n = 0;
+      const void *key;
+      void *val;
+      for (size_t pos = 0; CADT_Dict_next(d, &pos, &key, NULL, &val); n++) {
+        uint64_t kk;
+        memcpy(&kk, key, sizeof(kk));
+        TEST_ASSERT_TRUE(present[kk]);
+        TEST_ASSERT_TRUE(seq[kk] > last);
+        last = seq[kk];
+      }
+      TEST_ASSERT_EQUAL_size_t(d->meta.size, n);
+    }
+  }
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_compact_update(void) {
+  CADT_Dict *a = CADT_Dict_new_compact(sizeof(uint64_t), sizeof(long));
+  CADT_Dict *b = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  for (uint64_t k = 0; k < 1000; k++) {
+    long v = (long)k;
+    CADT_Dict_put(k % 2 ? a : b, &k, &v, OVERWRITE);
+    present[k] = true;
+    ref[k] = v;
+  }
+  TEST_ASSERT_EQUAL_size_t(1000, CADT_Dict_update(a, b, IGNORE));
+  check_ref(a);
+  CADT_Dict_free(a);
+  CADT_Dict_free(b);
+}
+
+void test_CADT_Dict_stats(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  TEST_ASSERT_NOT_NULL(d);
+  for (uint64_t k = 0; k < 1000; k++) {
+    long v = (long)k;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+  }
+  for (uint64_t k = 0; k < 1000; k += 2) {
+    CADT_Dict_remove(d, &k);
+  }
+  CADT_DictStats st;
+  TEST_ASSERT_EQUAL(CADT_DICT_STATS, CADT_Dict_stats(d, &st));
+  TEST_ASSERT_EQUAL_size_t(500, st.size);
+  TEST_ASSERT_TRUE(st.len >= 1000 && st.len % CADT_DICT_GROUP_WIDTH == 0);
+  TEST_ASSERT_TRUE(st.tombs <= 500);
+  TEST_ASSERT_TRUE(st.load * st.len >= 500 && st.load < 1);
+  TEST_ASSERT_TRUE(st.bytes >= sizeof(CADT_Dict) + st.len);
+  /* growing from one group to 1000 items takes several resizes */
+  TEST_ASSERT_EQUAL(CADT_DICT_STATS, st.resizes > 0);
+
+  CADT_Dict_stats_reset(d);
+  for (uint64_t k = 0; k < 2000; k++) {
+    CADT_Dict_get(d, &k);
+  }
+  CADT_Dict_stats(d, &st);
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  for (size_t i = 0; i < CADT_DICT_PROBE_BUCKETS; i++) {
+    hits += st.hits[i];
+    misses += st.misses[i];
+  }
+#if CADT_DICT_STATS
+  TEST_ASSERT_EQUAL_UINT64(500, hits);
+  TEST_ASSERT_EQUAL_UINT64(1500, misses);
+#else
+  TEST_ASSERT_EQUAL_UINT64(0, hits + misses + st.resizes + st.resize_ns);
+#endif
+  CADT_Dict_free(d);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Dict_put_get_random);
+  RUN_TEST(test_CADT_Dict_full_groups);
+  RUN_TEST(test_CADT_Dict_empty);
+  RUN_TEST(test_CADT_Dict_remove_random);
+  RUN_TEST(test_CADT_Dict_lookup_while_rehashing);
+  RUN_TEST(test_CADT_Dict_remove_all_shrinks);
+  RUN_TEST(test_CADT_hash);
+  RUN_TEST(test_CADT_Dict_key_widths);
+  RUN_TEST(test_CADT_Dict_new_hasher);
+  RUN_TEST(test_CADT_Dict_put_many_get_many);
+  RUN_TEST(test_CADT_Dict_varkey_random);
+  RUN_TEST(test_CADT_Dict_varkey_arena_reuse);
+  RUN_TEST(test_CADT_Dict_compact_order);
+  RUN_TEST(test_CADT_Dict_compact_update);
+  RUN_TEST(test_CADT_Dict_stats);
+  return UNITY_END();
+}
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include "../dict.h"
+#include "../cadt.h"
+#include <stdio.h>
+
+#define NKEYS 4096
+#define SNAPSHOT "temp/test_dictfile.snap"
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static uint64_t other_hash(const void *key, size_t nbyte, uint64_t seed) {
+  return CADT_hash(key, nbyte, seed ^ 1);
+}
+
+/* every key of a is in b with the same value, and the sizes match */
+static void check_same(CADT_Dict *a, CADT_Dict *b) {
+  TEST_ASSERT_EQUAL_size_t(a->meta.size, b->meta.size);
+  const void *key;
+  size_t keylen;
+  void *val;
+  for (size_t pos = 0; CADT_Dict_next(a, &pos, &key, &keylen, &val);) {
+    const void *got = CADT_Dict_get_bytes(b, key, keylen);
+    TEST_ASSERT_NOT_NULL(got);
+    TEST_ASSERT_EQUAL_MEMORY(val, got, a->meta.valsz);
+  }
+}
+
+static void flip_byte(const char *path, const long off) {
+  FILE *f = fopen(path, "r+b");
+  TEST_ASSERT_NOT_NULL(f);
+  fseek(f, off, off < 0 ? SEEK_END : SEEK_SET);
+  const int c = fgetc(f);
+  fseek(f, off, off < 0 ? SEEK_END : SEEK_SET);
+  fputc(c ^ 0xff, f);
+  fclose(f);
+}
+
+void setUp(void) {
+  rng = 0x9e3779b97f4a7c15ull;
+}
+
+void tearDown(void) {
+  remove(SNAPSHOT);
+}
+
+void test_CADT_Dict_save_open(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  for (int i = 0; i < 20000; i++) {
+    uint64_t k = next_rand() % NKEYS;
+    long v = (long)next_rand();
+    if (next_rand() % 4 == 0) {
+      CADT_Dict_remove(d, &k);
+    } else {
+      CADT_Dict_put(d, &k, &v, OVERWRITE);
+    }
+  }
+  TEST_ASSERT_TRUE(CADT_Dict_save(d, SNAPSHOT));
+  CADT_Dict *m = CADT_Dict_open_mmap(SNAPSHOT, NULL, true);
+  TEST_ASSERT_NOT_NULL(m);
+  check_same(d, m);
+  check_same(m, d);
+  for (uint64_t k = NKEYS; k < 2 * NKEYS; k++) {
+    TEST_ASSERT_NULL(CADT_Dict_get(m, &k));
+  }
+
+  /* the snapshot is read only */
+  uint64_t k = 2 * NKEYS;
+  long v = 1;
+  CADT_Dict_put(m, &k, &v, OVERWRITE);
+  TEST_ASSERT_NULL(CADT_Dict_get(m, &k));
+  const void *key;
+  void *val;
+  size_t pos = 0;
+  TEST_ASSERT_TRUE(CADT_Dict_next(m, &pos, &key, NULL, &val));
+  TEST_ASSERT_FALSE(CADT_Dict_remove(m, key));
+  TEST_ASSERT_NOT_NULL(CADT_Dict_get(m, key));
+  CADT_Dict_free(m);
+  CADT_Dict_free(d);
+}
+
+void test_CADT_Dict_save_layouts(void) {
+  CADT_Dict *dicts[] = {CADT_Dict_new_varkey(sizeof(long)),
+                        CADT_Dict_new_compact(sizeof(uint64_t), sizeof(long)),
+                        CADT_Dict_new_compact_varkey(sizeof(long))};
+  for (size_t i = 0; i < sizeof(dicts) / sizeof(dicts[0]); i++) {
+    CADT_Dict *d = dicts[i];
+    TEST_ASSERT_NOT_NULL(d);
+    char key[32];
+    for (int j = 0; j < 3000; j++) {
+      const size_t keylen = d->meta.varkey
+                                ? (size_t)snprintf(key, sizeof(key), "key%d",
+                                                   (int)(next_rand() % 1000))
+                                : sizeof(uint64_t);
+      if (!d->meta.varkey) {
+        const uint64_t k = next_rand() % 1000;
+        memcpy(key, &k, sizeof(k));
+      }
+      long v = j;
+      if (j % 5 == 0) {
+        CADT_Dict_remove_bytes(d, key, keylen);
+      } else {
+        CADT_Dict_put_bytes(d, key, keylen, &v, OVERWRITE);
+      }
+    }
+    TEST_ASSERT_TRUE(CADT_Dict_save(d, SNAPSHOT));
+    CADT_Dict *m = CADT_Dict_open_mmap(SNAPSHOT, NULL, true);
+    TEST_ASSERT_NOT_NULL(m);
+    check_same(d, m);
+    check_same(m, d);
+    CADT_Dict_free(m);
+    CADT_Dict_free(d);
+  }
+}
+
+void test_CADT_Dict_open_rejects(void) {
+  CADT_Dict *d = CADT_Dict_new(sizeof(uint64_t), sizeof(long));
+  for (uint64_t k = 0; k < 1000; k++) {
+    long v = (long)k;
+    CADT_Dict_put(d, &k, &v, OVERWRITE);
+  }
+  TEST_ASSERT_TRUE(CADT_Dict_save(d, SNAPSHOT));
+  CADT_Dict_free(d);
+
+  TEST_ASSERT_NULL(CADT_Dict_open_mmap("temp/no_such_file", NULL, true));
+  /* saved with the built in hash */
+  TEST_ASSERT_NULL(CADT_Dict_open_mmap(SNAPSHOT, other_hash, true));
+
+  /* a damaged payload is only caught when verifying */
+  flip_byte(SNAPSHOT, -1);
+  TEST_ASSERT_NULL(CADT_Dict_open_mmap(SNAPSHOT, NULL, true));
+  CADT_Dict *m = CADT_Dict_open_mmap(SNAPSHOT, NULL, false);
+  TEST_ASSERT_NOT_NULL(m);
+  CADT_Dict_free(m);
+
+  /* a damaged header never opens */
+  flip_byte(SNAPSHOT, -1);
+  flip_byte(SNAPSHOT, 20);
+  TEST_ASSERT_NULL(CADT_Dict_open_mmap(SNAPSHOT, NULL, false));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Dict_save_open);
+  RUN_TEST(test_CADT_Dict_save_layouts);
+  RUN_TEST(test_CADT_Dict_open_rejects);
+  return UNITY_END();
+}
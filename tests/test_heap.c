@@ -0,0 +1,331 @@
+#include "unity.h"
+#include "../heap.h"
+#include "../vector.h"
+#include "../cadt.h"
+
+#define MAXN 4000
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static int cmp_long(const void *a, const void *b) {
+  const long x = *(const long *)a;
+  const long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+/* the reference is an unordered bag of n values */
+static long ref[MAXN];
+static size_t n;
+
+/* index of the value that should be on top of a heap of type */
+static size_t ref_top(const CADTHeapType type) {
+  size_t best = 0;
+  for (size_t i = 1; i < n; i++) {
+    if (type == MIN ? ref[i] < ref[best] : ref[i] > ref[best]) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+static long ref_take(const size_t i) {
+  const long x = ref[i];
+  ref[i] = ref[--n];
+  return x;
+}
+
+/* a few distinct values, so ties are common */
+static long rand_val(void) {
+  return (long)(next_rand() % 500) - 250;
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+  n = 0;
+}
+
+void tearDown() {
+}
+
+void test_CADT_Heap_random() {
+  const size_t arities[] = {2, 3, 4, 8};
+  for (size_t a = 0; a < sizeof(arities) / sizeof(arities[0]); a++) {
+    for (int t = 0; t < 2; t++) {
+      const CADTHeapType type = t ? MAX : MIN;
+      CADT_Heap *h = CADT_Heap_new(0, sizeof(long), type, cmp_long);
+      TEST_ASSERT_TRUE(CADT_Heap_set_arity(h, arities[a]));
+      n = 0;
+      for (int op = 0; op < 30000; op++) {
+        const uint64_t r = next_rand() % 10;
+        if (r < 5 && n < MAXN) {
+          long x = rand_val();
+          TEST_ASSERT_TRUE(CADT_Heap_insert(h, &x));
+          ref[n++] = x;
+        } else if (r < 8) {
+          long *p = (long *)CADT_Heap_popmin(h);
+          TEST_ASSERT_EQUAL(n > 0, p != NULL);
+          if (p != NULL) {
+            TEST_ASSERT_EQUAL_INT64(ref_take(ref_top(type)), *p);
+          }
+        } else if (r < 9 && n > 0) {
+          long x = rand_val();
+          TEST_ASSERT_TRUE(CADT_Heap_replace_top(h, &x));
+          ref[ref_top(type)] = x;
+        } else if (n > 0) {
+          /* changing the arity rebuilds the heap */
+          const size_t arity = 2 + (size_t)next_rand() % 6;
+          TEST_ASSERT_TRUE(CADT_Heap_set_arity(h, arity));
+        }
+        TEST_ASSERT_EQUAL_size_t(n, CADT_Heap_size(h));
+        if (n > 0) {
+          TEST_ASSERT_EQUAL_INT64(ref[ref_top(type)],
+                                  *(long *)CADT_Heap_peek(h));
+        }
+      }
+      CADT_Heap_free(h);
+    }
+  }
+}
+
+void test_CADT_Heap_bulk() {
+  static long buf[MAXN];
+  static long out[MAXN];
+  for (int round = 0; round < 50; round++) {
+    const size_t m = (size_t)next_rand() % MAXN;
+    for (size_t i = 0; i < m; i++) {
+      buf[i] = rand_val();
+    }
+    CADT_Heap *h = CADT_Heap_new(0, sizeof(long), MIN, cmp_long);
+    if (round % 2) {
+      TEST_ASSERT_TRUE(CADT_Heap_heapify(h, buf, m));
+    } else {
+      /* a small batch is sifted in, a large one rebuilds the heap */
+      const size_t k = m / 10;
+      TEST_ASSERT_TRUE(CADT_Heap_push_many(h, buf, k));
+      TEST_ASSERT_TRUE(CADT_Heap_push_many(h, buf + k, k / 2));
+      TEST_ASSERT_TRUE(CADT_Heap_push_many(h, buf + k + k / 2,
+                                           m - k - k / 2));
+    }
+    TEST_ASSERT_EQUAL_size_t(m, CADT_Heap_size(h));
+    qsort(buf, m, sizeof(long), cmp_long);
+    const size_t first = m / 3;
+    TEST_ASSERT_EQUAL_size_t(first, CADT_Heap_pop_into(h, out, first));
+    TEST_ASSERT_EQUAL_size_t(m - first, CADT_Heap_pop_into(h, out + first,
+                                                          MAXN));
+    TEST_ASSERT_EQUAL_INT64_ARRAY(buf, out, m);
+    TEST_ASSERT_NULL(CADT_Heap_popmin(h));
+    TEST_ASSERT_NULL(CADT_Heap_peek(h));
+    CADT_Heap_free(h);
+  }
+}
+
+void test_CADT_Heap_heapify_vec() {
+  CADT_Vec *v = CADT_Vec_new(0, sizeof(long));
+  for (long i = 0; i < 1000; i++) {
+    long x = (i * 7919) % 1000;
+    CADT_Vec_push(v, &x, sizeof(x));
+  }
+  CADT_Heap *h = CADT_Heap_new(0, sizeof(long), MAX, cmp_long);
+  /* the heap replaces whatever it held */
+  long x = 5000;
+  CADT_Heap_insert(h, &x);
+  TEST_ASSERT_TRUE(CADT_Heap_heapify_vec(h, v));
+  for (long i = 999; i >= 0; i--) {
+    TEST_ASSERT_EQUAL_INT64(i, *(long *)CADT_Heap_popmin(h));
+  }
+  CADT_Heap_free(h);
+  CADT_Vec_free(v);
+
+  /* elements of another size are refused */
+  v = CADT_Vec_new(0, sizeof(int));
+  int y = 1;
+  CADT_Vec_push(v, &y, sizeof(y));
+  h = CADT_Heap_new(0, sizeof(long), MAX, cmp_long);
+  TEST_ASSERT_FALSE(CADT_Heap_heapify_vec(h, v));
+  TEST_ASSERT_FALSE(CADT_Heap_set_arity(h, 1));
+  CADT_Heap_free(h);
+  CADT_Vec_free(v);
+}
+
+void test_CADT_Heap_sift() {
+  /* an element changed in place is moved back to its place by hand */
+  CADT_Heap *h = CADT_Heap_new(0, sizeof(long), MIN, cmp_long);
+  for (long i = 0; i < 100; i++) {
+    CADT_Heap_insert(h, &i);
+  }
+  long *p = (long *)h->data;
+  p[50] = -1;
+  CADT_Heap_bottomup(h, 50);
+  p[0] = 1000;
+  CADT_Heap_topdown(h, 0);
+  /* 50 went to -1, which rose to the top and then went to 1000 */
+  for (long i = 0; i < 100; i++) {
+    if (i != 50) {
+      TEST_ASSERT_EQUAL_INT64(i, *(long *)CADT_Heap_popmin(h));
+    }
+  }
+  TEST_ASSERT_EQUAL_INT64(1000, *(long *)CADT_Heap_popmin(h));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Heap_size(h));
+  CADT_Heap_free(h);
+}
+
+typedef struct Item {
+  long key;
+  size_t tag; /* which insert made it, to tell equal keys apart */
+} Item;
+
+static int cmp_item(const void *a, const void *b) {
+  return cmp_long(&((const Item *)a)->key, &((const Item *)b)->key);
+}
+
+/* what each handle holds, if it is live */
+static Item held[MAXN];
+static bool live[MAXN];
+
+static void check_handle(CADT_Heap *h, const size_t handle) {
+  const Item *it = (const Item *)CADT_Heap_get_handle(h, handle);
+  if (!live[handle]) {
+    TEST_ASSERT_NULL(it);
+    return;
+  }
+  TEST_ASSERT_NOT_NULL(it);
+  TEST_ASSERT_EQUAL_INT64(held[handle].key, it->key);
+  TEST_ASSERT_EQUAL_size_t(held[handle].tag, it->tag);
+}
+
+/* a live handle picked at random, NOHANDLE if there is none */
+static size_t rand_live(const size_t nhandles) {
+  if (n == 0) {
+    return CADT_HEAP_NOHANDLE;
+  }
+  for (;;) {
+    const size_t handle = (size_t)next_rand() % nhandles;
+    if (live[handle]) {
+      return handle;
+    }
+  }
+}
+
+void test_CADT_Heap_handles() {
+  for (int t = 0; t < 2; t++) {
+    const CADTHeapType type = t ? MAX : MIN;
+    /* keys moving towards the top, and away from it */
+    const long up = type == MIN ? -1 : 1;
+    CADT_Heap *h =
+        CADT_Heap_new_indexed(0, sizeof(Item), type, cmp_item, NULL);
+    memset(live, 0, sizeof(live));
+    n = 0;
+    size_t nhandles = 0; /* no handle seen reaches this */
+    size_t tag = 0;
+    for (int op = 0; op < 40000; op++) {
+      const uint64_t r = next_rand() % 12;
+      const size_t handle = rand_live(nhandles);
+      Item it = {rand_val(), tag++};
+      if (r < 4 && n < MAXN) {
+        const size_t got = CADT_Heap_insert_handle(h, &it);
+        TEST_ASSERT_TRUE(got < MAXN);
+        TEST_ASSERT_FALSE(live[got]);
+        live[got] = true;
+        held[got] = it;
+        nhandles = got >= nhandles ? got + 1 : nhandles;
+        n++;
+      } else if (r < 6) {
+        /* the top is a handle holding the best key */
+        const size_t top = CADT_Heap_top_handle(h);
+        Item out;
+        TEST_ASSERT_EQUAL(n > 0, CADT_Heap_pop_into(h, &out, 1));
+        if (n > 0) {
+          for (size_t i = 0; i < nhandles; i++) {
+            TEST_ASSERT_FALSE(live[i] && held[i].key * up > out.key * up);
+          }
+          TEST_ASSERT_TRUE(live[top]);
+          TEST_ASSERT_EQUAL_size_t(held[top].tag, out.tag);
+          live[top] = false;
+          n--;
+        }
+      } else if (r < 8 && handle != CADT_HEAP_NOHANDLE) {
+        TEST_ASSERT_TRUE(CADT_Heap_update(h, handle, &it));
+        held[handle] = it;
+      } else if (r < 9 && handle != CADT_HEAP_NOHANDLE) {
+        /* a key moved the wrong way is refused */
+        it.key = held[handle].key - 1 - (long)(next_rand() % 10);
+        TEST_ASSERT_FALSE(CADT_Heap_increase_key(h, handle, &it));
+        TEST_ASSERT_TRUE(CADT_Heap_decrease_key(h, handle, &it));
+        held[handle] = it;
+      } else if (r < 10 && handle != CADT_HEAP_NOHANDLE) {
+        it.key = held[handle].key + (long)(next_rand() % 10);
+        TEST_ASSERT_EQUAL(it.key == held[handle].key,
+                          CADT_Heap_decrease_key(h, handle, &it));
+        TEST_ASSERT_TRUE(CADT_Heap_increase_key(h, handle, &it));
+        held[handle] = it;
+      } else if (handle != CADT_HEAP_NOHANDLE) {
+        Item out;
+        TEST_ASSERT_TRUE(CADT_Heap_remove(h, handle, &out));
+        TEST_ASSERT_EQUAL_size_t(held[handle].tag, out.tag);
+        TEST_ASSERT_FALSE(CADT_Heap_remove(h, handle, NULL));
+        live[handle] = false;
+        n--;
+      }
+      TEST_ASSERT_EQUAL_size_t(n, CADT_Heap_size(h));
+      if (op % 500 == 0) {
+        for (size_t i = 0; i < nhandles; i++) {
+          check_handle(h, i);
+        }
+      }
+    }
+    CADT_Heap_free(h);
+  }
+}
+
+void test_CADT_Heap_handles_heapify() {
+  /* a rebuilt indexed heap gives element i handle i */
+  Item items[500];
+  for (size_t i = 0; i < 500; i++) {
+    items[i].key = rand_val();
+    items[i].tag = i;
+  }
+  CADT_Heap *h = CADT_Heap_new_indexed(0, sizeof(Item), MIN, cmp_item, NULL);
+  Item it = {0, 1000};
+  /* the handle of what it held before is dropped */
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Heap_insert_handle(h, &it));
+  TEST_ASSERT_TRUE(CADT_Heap_heapify(h, items, 500));
+  for (size_t i = 0; i < 500; i++) {
+    const Item *p = (const Item *)CADT_Heap_get_handle(h, i);
+    TEST_ASSERT_EQUAL_size_t(i, p->tag);
+  }
+  TEST_ASSERT_NULL(CADT_Heap_get_handle(h, 500));
+  TEST_ASSERT_TRUE(CADT_Heap_set_arity(h, 3));
+  for (size_t i = 0; i < 500; i++) {
+    const Item *p = (const Item *)CADT_Heap_get_handle(h, i);
+    TEST_ASSERT_EQUAL_size_t(i, p->tag);
+  }
+  CADT_Heap_free(h);
+
+  /* a plain heap has no handles */
+  h = CADT_Heap_new(0, sizeof(Item), MIN, cmp_item);
+  TEST_ASSERT_EQUAL_size_t(CADT_HEAP_NOHANDLE, CADT_Heap_insert_handle(h, &it));
+  TEST_ASSERT_TRUE(CADT_Heap_insert(h, &it));
+  TEST_ASSERT_EQUAL_size_t(CADT_HEAP_NOHANDLE, CADT_Heap_top_handle(h));
+  TEST_ASSERT_NULL(CADT_Heap_get_handle(h, 0));
+  TEST_ASSERT_FALSE(CADT_Heap_update(h, 0, &it));
+  TEST_ASSERT_FALSE(CADT_Heap_remove(h, 0, NULL));
+  CADT_Heap_free(h);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Heap_random);
+  RUN_TEST(test_CADT_Heap_bulk);
+  RUN_TEST(test_CADT_Heap_heapify_vec);
+  RUN_TEST(test_CADT_Heap_sift);
+  RUN_TEST(test_CADT_Heap_handles);
+  RUN_TEST(test_CADT_Heap_handles_heapify);
+  return UNITY_END();
+}
@@ -0,0 +1,122 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include "../multiqueue.h"
+#include "../cadt.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define NTHREADS 4
+#define PER_THREAD 50000
+#define NVALS (NTHREADS * PER_THREAD)
+
+static atomic_int seen[NVALS]; /* times each value was popped */
+
+static int cmp_long(const void *a, const void *b) {
+  const long x = *(const long *)a;
+  const long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+void setUp() {
+  for (size_t i = 0; i < NVALS; i++) {
+    atomic_init(&seen[i], 0);
+  }
+}
+
+void tearDown() {
+}
+
+void test_CADT_MultiQueue_one_heap() {
+  /* with a single heap the order is exact */
+  CADT_MultiQueue *mq = CADT_MultiQueue_new(1, sizeof(long), MAX, cmp_long);
+  TEST_ASSERT_NOT_NULL(mq);
+  for (long i = 0; i < 1000; i++) {
+    long x = (i * 7919) % 1000;
+    TEST_ASSERT_TRUE(CADT_MultiQueue_push(mq, &x));
+  }
+  TEST_ASSERT_EQUAL_size_t(1000, CADT_MultiQueue_size(mq));
+  for (long i = 999; i >= 0; i--) {
+    long x;
+    TEST_ASSERT_TRUE(CADT_MultiQueue_pop(mq, &x));
+    TEST_ASSERT_EQUAL_INT64(i, x);
+  }
+  long x;
+  TEST_ASSERT_FALSE(CADT_MultiQueue_pop(mq, &x));
+  CADT_MultiQueue_free(mq);
+}
+
+void test_CADT_MultiQueue_all_out() {
+  /* spread over many heaps every element still comes out once, and a
+   * pop only fails once all of them are empty */
+  CADT_MultiQueue *mq = CADT_MultiQueue_new(16, sizeof(long), MIN, cmp_long);
+  for (long i = 0; i < 10000; i++) {
+    TEST_ASSERT_TRUE(CADT_MultiQueue_push(mq, &i));
+  }
+  long x;
+  for (size_t i = 0; i < 10000; i++) {
+    TEST_ASSERT_TRUE(CADT_MultiQueue_pop(mq, &x));
+    TEST_ASSERT_TRUE(x >= 0 && x < 10000);
+    TEST_ASSERT_EQUAL_INT(0, atomic_fetch_add(&seen[x], 1));
+  }
+  TEST_ASSERT_EQUAL_size_t(0, CADT_MultiQueue_size(mq));
+  TEST_ASSERT_FALSE(CADT_MultiQueue_pop(mq, &x));
+  /* one element left in one of the heaps is found */
+  TEST_ASSERT_TRUE(CADT_MultiQueue_push(mq, &x));
+  TEST_ASSERT_TRUE(CADT_MultiQueue_pop(mq, &x));
+  CADT_MultiQueue_free(mq);
+}
+
+typedef struct Job {
+  CADT_MultiQueue *mq;
+  long id;
+  bool ok;
+} Job;
+
+static void *worker(void *arg) {
+  Job *job = (Job *)arg;
+  for (long i = 0; i < PER_THREAD; i++) {
+    long x = job->id * PER_THREAD + i;
+    job->ok &= CADT_MultiQueue_push(job->mq, &x);
+    /* pop about every other push, racing the other threads */
+    if (i % 2 && CADT_MultiQueue_pop(job->mq, &x)) {
+      if (x >= 0 && x < NVALS) {
+        atomic_fetch_add(&seen[x], 1);
+      } else {
+        job->ok = false;
+      }
+    }
+  }
+  return NULL;
+}
+
+void test_CADT_MultiQueue_threads() {
+  CADT_MultiQueue *mq = CADT_MultiQueue_new(0, sizeof(long), MIN, cmp_long);
+  Job jobs[NTHREADS];
+  pthread_t threads[NTHREADS];
+  for (long i = 0; i < NTHREADS; i++) {
+    jobs[i] = (Job){mq, i, true};
+    TEST_ASSERT_EQUAL_INT(0,
+                          pthread_create(&threads[i], NULL, worker, &jobs[i]));
+  }
+  for (size_t i = 0; i < NTHREADS; i++) {
+    pthread_join(threads[i], NULL);
+    TEST_ASSERT_TRUE(jobs[i].ok);
+  }
+  long x;
+  while (CADT_MultiQueue_pop(mq, &x)) {
+    atomic_fetch_add(&seen[x], 1);
+  }
+  /* nothing lost, nothing popped twice */
+  for (size_t i = 0; i < NVALS; i++) {
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&seen[i]));
+  }
+  CADT_MultiQueue_free(mq);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_MultiQueue_one_heap);
+  RUN_TEST(test_CADT_MultiQueue_all_out);
+  RUN_TEST(test_CADT_MultiQueue_threads);
+  return UNITY_END();
+}
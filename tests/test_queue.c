@@ -0,0 +1,239 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include "../queue.h"
+#include "../cadt.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define NTHREADS 4
+#define PER_THREAD 100000
+
+typedef struct Rec {
+  uint32_t from;
+  uint32_t seq;
+  uint32_t pad; /* 12 bytes, not a multiple of the cell alignment */
+} Rec;
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+}
+
+void tearDown() {
+}
+
+void test_CADT_SPSCQueue_fifo() {
+  CADT_SPSCQueue *q = CADT_SPSCQueue_new(5, sizeof(long));
+  TEST_ASSERT_NOT_NULL(q);
+  /* 5 rounds up to 8 */
+  long x = 0;
+  for (x = 0; x < 8; x++) {
+    TEST_ASSERT_TRUE(CADT_SPSCQueue_push(q, &x));
+  }
+  TEST_ASSERT_FALSE(CADT_SPSCQueue_push(q, &x));
+  TEST_ASSERT_EQUAL_size_t(8, CADT_SPSCQueue_size(q));
+
+  /* a batch is cut to the room there is, and wraps around the ring */
+  long buf[8];
+  TEST_ASSERT_EQUAL_size_t(3, CADT_SPSCQueue_pop_n(q, buf, 3));
+  const long more[5] = {8, 9, 10, 11, 12};
+  TEST_ASSERT_EQUAL_size_t(3, CADT_SPSCQueue_push_n(q, more, 5));
+  TEST_ASSERT_EQUAL_size_t(8, CADT_SPSCQueue_pop_n(q, buf, 100));
+  for (long i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_INT64(i + 3, buf[i]);
+  }
+  TEST_ASSERT_FALSE(CADT_SPSCQueue_pop(q, &x));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_SPSCQueue_size(q));
+  CADT_SPSCQueue_free(q);
+  TEST_ASSERT_NULL(CADT_SPSCQueue_new(8, 0));
+}
+
+void test_CADT_MPMCQueue_fifo() {
+  CADT_MPMCQueue *q = CADT_MPMCQueue_new(8, sizeof(Rec));
+  TEST_ASSERT_NOT_NULL(q);
+  /* a random mix of batches against a reference ring */
+  Rec ref[8];
+  size_t head = 0;
+  size_t n = 0;
+  uint32_t seq = 0;
+  for (int op = 0; op < 10000; op++) {
+    Rec buf[8];
+    const size_t want = (size_t)next_rand() % 9;
+    if (next_rand() % 2) {
+      for (size_t i = 0; i < want; i++) {
+        buf[i].from = 0;
+        buf[i].seq = seq + (uint32_t)i;
+        buf[i].pad = ~buf[i].seq;
+      }
+      const size_t k = CADT_MPMCQueue_push_n(q, buf, want);
+      TEST_ASSERT_EQUAL_size_t(want < 8 - n ? want : 8 - n, k);
+      for (size_t i = 0; i < k; i++) {
+        ref[(head + n++) % 8] = buf[i];
+      }
+      seq += (uint32_t)k;
+    } else {
+      const size_t k = CADT_MPMCQueue_pop_n(q, buf, want);
+      TEST_ASSERT_EQUAL_size_t(want < n ? want : n, k);
+      for (size_t i = 0; i < k; i++) {
+        TEST_ASSERT_EQUAL_MEMORY(&ref[head], &buf[i], sizeof(Rec));
+        head = (head + 1) % 8;
+        n--;
+      }
+    }
+    TEST_ASSERT_EQUAL_size_t(n, CADT_MPMCQueue_size(q));
+  }
+  CADT_MPMCQueue_free(q);
+}
+
+typedef struct Job {
+  void *q;
+  uint32_t id;
+  uint64_t sum;
+  uint64_t count;
+  bool ordered; /* each producer's elements came out in its order */
+} Job;
+
+static atomic_uint done; /* producers finished */
+
+static void *spsc_producer(void *arg) {
+  Job *job = (Job *)arg;
+  long i = 0;
+  long batch[16];
+  while (i < PER_THREAD) {
+    /* single pushes and batches of a few */
+    const size_t want = (size_t)(i % 7) + 1;
+    size_t m = 0;
+    while (m < want && i + (long)m < PER_THREAD) {
+      batch[m] = i + (long)m;
+      m++;
+    }
+    const size_t k = m == 1 ? CADT_SPSCQueue_push(job->q, batch)
+                            : CADT_SPSCQueue_push_n(job->q, batch, m);
+    i += (long)k;
+    if (k == 0) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+void test_CADT_SPSCQueue_threads() {
+  CADT_SPSCQueue *q = CADT_SPSCQueue_new(64, sizeof(long));
+  Job job = {q, 0, 0, 0, true};
+  pthread_t producer;
+  TEST_ASSERT_EQUAL_INT(0,
+                        pthread_create(&producer, NULL, spsc_producer, &job));
+  long want = 0;
+  long buf[10];
+  while (want < PER_THREAD) {
+    const size_t k = CADT_SPSCQueue_pop_n(q, buf, (size_t)want % 10 + 1);
+    for (size_t i = 0; i < k; i++) {
+      TEST_ASSERT_EQUAL_INT64(want++, buf[i]);
+    }
+    if (k == 0) {
+      sched_yield();
+    }
+  }
+  pthread_join(producer, NULL);
+  TEST_ASSERT_FALSE(CADT_SPSCQueue_pop(q, buf));
+  CADT_SPSCQueue_free(q);
+}
+
+static void *mpmc_producer(void *arg) {
+  Job *job = (Job *)arg;
+  Rec batch[4];
+  uint32_t i = 0;
+  while (i < PER_THREAD) {
+    size_t m = 0;
+    while (m < 4 && i + m < PER_THREAD) {
+      batch[m].from = job->id;
+      batch[m].seq = i + (uint32_t)m;
+      batch[m].pad = ~batch[m].seq;
+      m++;
+    }
+    const size_t k = CADT_MPMCQueue_push_n(job->q, batch, m);
+    i += (uint32_t)k;
+    if (k == 0) {
+      sched_yield();
+    }
+  }
+  atomic_fetch_add(&done, 1);
+  return NULL;
+}
+
+static void *mpmc_consumer(void *arg) {
+  Job *job = (Job *)arg;
+  int64_t last[NTHREADS];
+  for (size_t i = 0; i < NTHREADS; i++) {
+    last[i] = -1;
+  }
+  Rec buf[3];
+  for (;;) {
+    const bool finished = atomic_load(&done) == NTHREADS;
+    const size_t k = CADT_MPMCQueue_pop_n(job->q, buf, 3);
+    for (size_t i = 0; i < k; i++) {
+      job->ordered &= buf[i].pad == ~buf[i].seq && buf[i].from < NTHREADS &&
+                      (int64_t)buf[i].seq > last[buf[i].from];
+      if (buf[i].from < NTHREADS) {
+        last[buf[i].from] = buf[i].seq;
+      }
+      job->sum += buf[i].seq;
+      job->count++;
+    }
+    if (k == 0) {
+      if (finished) {
+        return NULL;
+      }
+      sched_yield();
+    }
+  }
+}
+
+void test_CADT_MPMCQueue_threads() {
+  CADT_MPMCQueue *q = CADT_MPMCQueue_new(256, sizeof(Rec));
+  atomic_init(&done, 0);
+  Job producers[NTHREADS];
+  Job consumers[NTHREADS];
+  pthread_t threads[2 * NTHREADS];
+  for (uint32_t i = 0; i < NTHREADS; i++) {
+    producers[i] = (Job){q, i, 0, 0, true};
+    consumers[i] = (Job){q, i, 0, 0, true};
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[i], NULL, mpmc_producer,
+                                            &producers[i]));
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&threads[NTHREADS + i], NULL,
+                                            mpmc_consumer, &consumers[i]));
+  }
+  for (size_t i = 0; i < 2 * NTHREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  /* every element came out exactly once */
+  uint64_t sum = 0;
+  uint64_t count = 0;
+  for (size_t i = 0; i < NTHREADS; i++) {
+    TEST_ASSERT_TRUE(consumers[i].ordered);
+    sum += consumers[i].sum;
+    count += consumers[i].count;
+  }
+  const uint64_t per = (uint64_t)PER_THREAD * (PER_THREAD - 1) / 2;
+  TEST_ASSERT_EQUAL_UINT64((uint64_t)NTHREADS * PER_THREAD, count);
+  TEST_ASSERT_EQUAL_UINT64(NTHREADS * per, sum);
+  TEST_ASSERT_EQUAL_size_t(0, CADT_MPMCQueue_size(q));
+  CADT_MPMCQueue_free(q);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_SPSCQueue_fifo);
+  RUN_TEST(test_CADT_MPMCQueue_fifo);
+  RUN_TEST(test_CADT_SPSCQueue_threads);
+  RUN_TEST(test_CADT_MPMCQueue_threads);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+#include "unity.h"
+#include "../radixheap.h"
+#include "../cadt.h"
+
+#define MAXN 5000
+
+typedef struct Item {
+  uint64_t key;
+  uint64_t tag; /* which insert made it */
+} Item;
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/* the reference is an unordered bag of n items */
+static Item ref[MAXN];
+static size_t n;
+
+static size_t ref_min(void) {
+  size_t best = 0;
+  for (size_t i = 1; i < n; i++) {
+    if (ref[i].key < ref[best].key) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+  n = 0;
+}
+
+void tearDown() {
+}
+
+void test_CADT_RadixHeap_random() {
+  /* small and huge steps above last, so both low and high buckets fill */
+  const uint64_t spans[] = {4, 1000, UINT64_MAX / 4};
+  for (size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++) {
+    CADT_RadixHeap *rh = CADT_RadixHeap_new(sizeof(Item));
+    n = 0;
+    uint64_t tag = 0;
+    for (int op = 0; op < 40000; op++) {
+      const uint64_t last = CADT_RadixHeap_last(rh);
+      if (next_rand() % 2 && n < MAXN) {
+        const uint64_t room = UINT64_MAX - last;
+        const uint64_t span = room < spans[s] ? room + 1 : spans[s];
+        Item it = {last + next_rand() % span, tag++};
+        TEST_ASSERT_TRUE(CADT_RadixHeap_insert(rh, &it));
+        ref[n++] = it;
+      } else {
+        const Item *p = (const Item *)CADT_RadixHeap_popmin(rh);
+        TEST_ASSERT_EQUAL(n > 0, p != NULL);
+        if (p != NULL) {
+          /* equal keys may come out in any order */
+          const size_t i = ref_min();
+          TEST_ASSERT_EQUAL_UINT64(ref[i].key, p->key);
+          size_t j = 0;
+          while (j < n && (ref[j].key != p->key || ref[j].tag != p->tag)) {
+            j++;
+          }
+          TEST_ASSERT_TRUE(j < n);
+          ref[j] = ref[--n];
+          TEST_ASSERT_EQUAL_UINT64(p->key, CADT_RadixHeap_last(rh));
+        }
+      }
+      TEST_ASSERT_EQUAL_size_t(n, CADT_RadixHeap_size(rh));
+      if (n > 0) {
+        const Item *top = (const Item *)CADT_RadixHeap_peek(rh);
+        TEST_ASSERT_EQUAL_UINT64(ref[ref_min()].key, top->key);
+      }
+    }
+    CADT_RadixHeap_free(rh);
+  }
+}
+
+void test_CADT_RadixHeap_popped_pointer() {
+  /* the element popped must survive the next peek, which moves the other
+   * elements into the bucket it came from */
+  CADT_RadixHeap *rh = CADT_RadixHeap_new(sizeof(Item));
+  Item a = {5, 1};
+  Item b = {9, 2};
+  CADT_RadixHeap_insert(rh, &a);
+  CADT_RadixHeap_insert(rh, &b);
+  const Item *p = (const Item *)CADT_RadixHeap_popmin(rh);
+  TEST_ASSERT_EQUAL_UINT64(5, p->key);
+  TEST_ASSERT_EQUAL_UINT64(9, ((const Item *)CADT_RadixHeap_peek(rh))->key);
+  TEST_ASSERT_EQUAL_UINT64(5, p->key);
+  TEST_ASSERT_EQUAL_UINT64(1, p->tag);
+  /* the peek raised last to 9, the key popped is below it now */
+  TEST_ASSERT_EQUAL_UINT64(9, CADT_RadixHeap_last(rh));
+  TEST_ASSERT_FALSE(CADT_RadixHeap_insert(rh, p));
+
+  /* and inserts, even of itself and enough to grow every bucket */
+  p = (const Item *)CADT_RadixHeap_popmin(rh);
+  TEST_ASSERT_TRUE(CADT_RadixHeap_insert(rh, p));
+  for (uint64_t i = 0; i < 100; i++) {
+    Item it = {9 + i % 3, 10 + i};
+    TEST_ASSERT_TRUE(CADT_RadixHeap_insert(rh, &it));
+  }
+  TEST_ASSERT_EQUAL_UINT64(9, p->key);
+  TEST_ASSERT_EQUAL_UINT64(2, p->tag);
+  /* the top can be inserted again as the bucket it sits in grows */
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_TRUE(CADT_RadixHeap_insert(rh, CADT_RadixHeap_peek(rh)));
+  }
+  TEST_ASSERT_EQUAL_size_t(201, CADT_RadixHeap_size(rh));
+  CADT_RadixHeap_free(rh);
+}
+
+void test_CADT_RadixHeap_pop_into() {
+  CADT_RadixHeap *rh = CADT_RadixHeap_new(sizeof(uint64_t));
+  static uint64_t out[MAXN];
+  for (uint64_t i = 0; i < MAXN; i++) {
+    const uint64_t key = (i * 7919) % MAXN;
+    TEST_ASSERT_TRUE(CADT_RadixHeap_insert(rh, &key));
+  }
+  TEST_ASSERT_EQUAL_size_t(100, CADT_RadixHeap_pop_into(rh, out, 100));
+  TEST_ASSERT_EQUAL_size_t(MAXN - 100,
+                           CADT_RadixHeap_pop_into(rh, out + 100, MAXN));
+  for (uint64_t i = 0; i < MAXN; i++) {
+    TEST_ASSERT_EQUAL_UINT64(i, out[i]);
+  }
+  TEST_ASSERT_NULL(CADT_RadixHeap_popmin(rh));
+  TEST_ASSERT_NULL(CADT_RadixHeap_peek(rh));
+
+  /* keys below the last one popped are refused, equal ones are not */
+  const uint64_t below = MAXN - 2;
+  const uint64_t equal = MAXN - 1;
+  TEST_ASSERT_FALSE(CADT_RadixHeap_insert(rh, &below));
+  TEST_ASSERT_TRUE(CADT_RadixHeap_insert(rh, &equal));
+  TEST_ASSERT_EQUAL_size_t(1, CADT_RadixHeap_size(rh));
+  CADT_RadixHeap_free(rh);
+  TEST_ASSERT_NULL(CADT_RadixHeap_new(sizeof(uint32_t)));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_RadixHeap_random);
+  RUN_TEST(test_CADT_RadixHeap_popped_pointer);
+  RUN_TEST(test_CADT_RadixHeap_pop_into);
+  return UNITY_END();
+}
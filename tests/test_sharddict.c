@@ -0,0 +1,207 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include "../sharddict.h"
+#include "../cadt.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#define NKEYS 4096
+#define NTHREADS 4
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static atomic_long live; /* allocations not freed yet */
+static atomic_long budget; /* allocations left before they fail, -1 for
+                              no limit */
+
+static void *track_alloc(void *ctx, size_t n) {
+  (void)ctx;
+  if (atomic_load(&budget) >= 0 && atomic_fetch_sub(&budget, 1) <= 0) {
+    return NULL;
+  }
+  void *p = malloc(n);
+  atomic_fetch_add(&live, p != NULL);
+  return p;
+}
+
+static void *track_realloc(void *ctx, void *p, size_t n) {
+  (void)ctx;
+  void *q = realloc(p, n);
+  atomic_fetch_add(&live, p == NULL && q != NULL);
+  return q;
+}
+
+static void track_free(void *ctx, void *p) {
+  (void)ctx;
+  atomic_fetch_sub(&live, 1);
+  free(p);
+}
+
+static const CADT_Allocator tracking = {track_alloc, track_realloc,
+                                        track_free, NULL};
+
+typedef struct Job {
+  CADT_ShardDict *sd;
+  uint64_t id;
+  size_t bad; /* wrong values read, asserts only run on the main thread */
+} Job;
+
+/* each writer owns the keys equal to its id modulo NTHREADS, and reads
+ * the keys of the others while they change */
+static void *writer(void *arg) {
+  Job *job = (Job *)arg;
+  for (uint64_t k = job->id; k < NKEYS; k += NTHREADS) {
+    long v = (long)k * 2;
+    CADT_ShardDict_put(job->sd, &k, &v, OVERWRITE);
+    const uint64_t other = (k + 1) % NKEYS;
+    long got;
+    if (CADT_ShardDict_get(job->sd, &other, &got)) {
+      job->bad += got != (long)other * 2;
+    }
+  }
+  for (uint64_t k = job->id; k < NKEYS; k += 2 * NTHREADS) {
+    CADT_ShardDict_remove(job->sd, &k);
+  }
+  return NULL;
+}
+
+void setUp(void) {
+  rng = 0x9e3779b97f4a7c15ull;
+  atomic_store(&budget, -1);
+}
+
+void tearDown(void) {
+}
+
+void test_CADT_ShardDict_random(void) {
+  static bool present[NKEYS];
+  static long ref[NKEYS];
+  memset(present, 0, sizeof(present));
+  CADT_ShardDict *sd = CADT_ShardDict_new(sizeof(uint64_t), sizeof(long), 0);
+  TEST_ASSERT_NOT_NULL(sd);
+  for (int i = 0; i < 30000; i++) {
+    uint64_t k = next_rand() % NKEYS;
+    if (next_rand() % 4 == 0) {
+      TEST_ASSERT_EQUAL(present[k], CADT_ShardDict_remove(sd, &k));
+      present[k] = false;
+    } else {
+      long v = (long)next_rand();
+      TEST_ASSERT_TRUE(CADT_ShardDict_put(sd, &k, &v, OVERWRITE));
+      present[k] = true;
+      ref[k] = v;
+    }
+  }
+  size_t n = 0;
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    long v;
+    TEST_ASSERT_EQUAL(present[k], CADT_ShardDict_get(sd, &k, &v));
+    if (present[k]) {
+      TEST_ASSERT_EQUAL_INT64(ref[k], v);
+      n++;
+    }
+  }
+  TEST_ASSERT_EQUAL_size_t(n, CADT_ShardDict_size(sd));
+  CADT_ShardDict_free(sd);
+}
+
+void test_CADT_ShardDict_nshards(void) {
+  CADT_ShardDict *sd = CADT_ShardDict_new(sizeof(uint64_t), sizeof(long), 3);
+  TEST_ASSERT_NOT_NULL(sd);
+  TEST_ASSERT_EQUAL_size_t(4, sd->meta.nshards);
+  CADT_ShardDict_free(sd);
+  /* a single shard takes no bits of the hash */
+  sd = CADT_ShardDict_new(sizeof(uint64_t), sizeof(long), 1);
+  TEST_ASSERT_NOT_NULL(sd);
+  for (uint64_t k = 0; k < 100; k++) {
+    long v = (long)k;
+    CADT_ShardDict_put(sd, &k, &v, IGNORE);
+  }
+  TEST_ASSERT_EQUAL_size_t(100, CADT_ShardDict_size(sd));
+  CADT_ShardDict_free(sd);
+  TEST_ASSERT_NULL(CADT_ShardDict_new(0, sizeof(long), 1));
+}
+
+void test_CADT_ShardDict_threads(void) {
+  CADT_ShardDict *sd = CADT_ShardDict_new(sizeof(uint64_t), sizeof(long), 8);
+  TEST_ASSERT_NOT_NULL(sd);
+  pthread_t threads[NTHREADS];
+  Job jobs[NTHREADS];
+  for (uint64_t i = 0; i < NTHREADS; i++) {
+    jobs[i].sd = sd;
+    jobs[i].id = i;
+    jobs[i].bad = 0;
+    TEST_ASSERT_EQUAL_INT(0,
+                          pthread_create(&threads[i], NULL, writer, &jobs[i]));
+  }
+  for (size_t i = 0; i < NTHREADS; i++) {
+    pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_size_t(0, jobs[i].bad);
+  }
+  for (uint64_t k = 0; k < NKEYS; k++) {
+    long v;
+    const bool removed = k % (2 * NTHREADS) < NTHREADS;
+    TEST_ASSERT_EQUAL(!removed, CADT_ShardDict_get(sd, &k, &v));
+    if (!removed) {
+      TEST_ASSERT_EQUAL_INT64((long)k * 2, v);
+    }
+  }
+  TEST_ASSERT_EQUAL_size_t(NKEYS / 2, CADT_ShardDict_size(sd));
+  CADT_ShardDict_free(sd);
+}
+
+void test_CADT_ShardDict_new_with() {
+  atomic_store(&live, 0);
+  CADT_ShardDict *sd = CADT_ShardDict_new_with(sizeof(uint64_t), sizeof(long),
+                                               8, NULL, &tracking);
+  TEST_ASSERT_NOT_NULL(sd);
+  /* every shard dict comes from the allocator */
+  TEST_ASSERT_TRUE(atomic_load(&live) >= 8);
+  pthread_t threads[NTHREADS];
+  Job jobs[NTHREADS];
+  for (uint64_t i = 0; i < NTHREADS; i++) {
+    jobs[i].sd = sd;
+    jobs[i].id = i;
+    jobs[i].bad = 0;
+    TEST_ASSERT_EQUAL_INT(0,
+                          pthread_create(&threads[i], NULL, writer, &jobs[i]));
+  }
+  for (size_t i = 0; i < NTHREADS; i++) {
+    pthread_join(threads[i], NULL);
+    TEST_ASSERT_EQUAL_size_t(0, jobs[i].bad);
+  }
+  TEST_ASSERT_EQUAL_size_t(NKEYS / 2, CADT_ShardDict_size(sd));
+  CADT_ShardDict_free(sd);
+  TEST_ASSERT_EQUAL_INT64(0, atomic_load(&live));
+}
+
+void test_CADT_ShardDict_out_of_memory() {
+  /* allocations failing at each point of the setup give NULL and leak
+   * nothing */
+  for (long n = 0; n < 64; n++) {
+    atomic_store(&live, 0);
+    atomic_store(&budget, n);
+    CADT_ShardDict *sd = CADT_ShardDict_new_with(sizeof(uint64_t),
+                                                 sizeof(long), 8, NULL,
+                                                 &tracking);
+    atomic_store(&budget, -1);
+    CADT_ShardDict_free(sd);
+    TEST_ASSERT_EQUAL_INT64(0, atomic_load(&live));
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_ShardDict_random);
+  RUN_TEST(test_CADT_ShardDict_nshards);
+  RUN_TEST(test_CADT_ShardDict_threads);
+  RUN_TEST(test_CADT_ShardDict_new_with);
+  RUN_TEST(test_CADT_ShardDict_out_of_memory);
+  return UNITY_END();
+}
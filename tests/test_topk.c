@@ -0,0 +1,102 @@
+#include "unity.h"
+#include "../heap.h"
+#include "../cadt.h"
+#include <stdlib.h>
+
+#define MAXN 20000
+#define MAXK 300
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static int cmp_long(const void *a, const void *b) {
+  const long x = *(const long *)a;
+  const long y = *(const long *)b;
+  return (x > y) - (x < y);
+}
+
+static int cmp_long_desc(const void *a, const void *b) {
+  return cmp_long(b, a);
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+}
+
+void tearDown() {
+}
+
+void test_CADT_TopK_random() {
+  static long buf[MAXN];
+  static long out[MAXK];
+  for (int round = 0; round < 100; round++) {
+    const size_t n = (size_t)next_rand() % MAXN;
+    const size_t k = (size_t)next_rand() % MAXK + 1;
+    const CADTHeapType type = round % 2 ? MAX : MIN;
+    /* few distinct values in some rounds, so ties straddle the cut */
+    const uint64_t range = round % 4 < 2 ? 1000000 : 50;
+    for (size_t i = 0; i < n; i++) {
+      buf[i] = (long)(next_rand() % range);
+    }
+    CADT_TopK *t = CADT_TopK_new(k, sizeof(long), type, cmp_long, NULL);
+    TEST_ASSERT_NOT_NULL(t);
+    /* one at a time or in batches */
+    if (round % 3 == 0) {
+      for (size_t i = 0; i < n; i++) {
+        CADT_TopK_push(t, &buf[i]);
+      }
+    } else {
+      const size_t half = n / 2;
+      CADT_TopK_push_many(t, buf, half);
+      CADT_TopK_push_many(t, buf + half, n - half);
+    }
+    const size_t want = n < k ? n : k;
+    TEST_ASSERT_EQUAL_size_t(want, CADT_TopK_size(t));
+    qsort(buf, n, sizeof(long), type == MAX ? cmp_long_desc : cmp_long);
+    if (want > 0) {
+      TEST_ASSERT_EQUAL_INT64(buf[want - 1], *(long *)CADT_TopK_threshold(t));
+    }
+    TEST_ASSERT_EQUAL_size_t(want, CADT_TopK_take(t, out));
+    TEST_ASSERT_EQUAL_INT64_ARRAY(buf, out, want);
+    TEST_ASSERT_EQUAL_size_t(0, CADT_TopK_size(t));
+    TEST_ASSERT_NULL(CADT_TopK_threshold(t));
+    CADT_TopK_free(t);
+  }
+}
+
+void test_CADT_TopK_kept() {
+  CADT_TopK *t = CADT_TopK_new(3, sizeof(long), MAX, cmp_long, NULL);
+  const long vals[] = {5, 1, 9, 7, 2, 9, 10};
+  /* the first k are kept, then only what beats the worst kept */
+  TEST_ASSERT_EQUAL_size_t(4, CADT_TopK_push_many(t, vals, 4));
+  long x = 5;
+  TEST_ASSERT_FALSE(CADT_TopK_push(t, &x));
+  x = 6;
+  TEST_ASSERT_TRUE(CADT_TopK_push(t, &x));
+  TEST_ASSERT_EQUAL_size_t(2, CADT_TopK_push_many(t, vals + 4, 3));
+  long out[3];
+  TEST_ASSERT_EQUAL_size_t(3, CADT_TopK_take(t, out));
+  const long want[3] = {10, 9, 9};
+  TEST_ASSERT_EQUAL_INT64_ARRAY(want, out, 3);
+  CADT_TopK_free(t);
+
+  /* k of 0 keeps nothing */
+  t = CADT_TopK_new(0, sizeof(long), MIN, cmp_long, NULL);
+  TEST_ASSERT_FALSE(CADT_TopK_push(t, &x));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_TopK_push_many(t, vals, 7));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_TopK_take(t, out));
+  CADT_TopK_free(t);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_TopK_random);
+  RUN_TEST(test_CADT_TopK_kept);
+  return UNITY_END();
+}
@@ -0,0 +1,111 @@
+#include "unity.h"
+#include "../tvector.h"
+#include "../cadt.h"
+
+typedef struct Point {
+  double x;
+  double y;
+} Point;
+
+CADT_VEC_DEFINE(int, IntVec)
+CADT_VEC_DEFINE(Point, PointVec)
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+}
+
+void tearDown() {
+}
+
+void test_IntVec_random() {
+  static int ref[20000];
+  size_t n = 0;
+  IntVec v;
+  TEST_ASSERT_TRUE(IntVec_init(&v, 0));
+  for (int i = 0; i < 20000; i++) {
+    const uint64_t op = next_rand() % 4;
+    const int val = (int)next_rand();
+    if (op == 0 && n > 0) {
+      int out = 0;
+      TEST_ASSERT_TRUE(IntVec_pop(&v, &out));
+      TEST_ASSERT_EQUAL_INT(ref[--n], out);
+    } else if (op == 1) {
+      const size_t idx = next_rand() % (n + 1);
+      TEST_ASSERT_TRUE(IntVec_insert(&v, idx, val));
+      memmove(ref + idx + 1, ref + idx, (n - idx) * sizeof(int));
+      ref[idx] = val;
+      n++;
+    } else {
+      TEST_ASSERT_TRUE(IntVec_push(&v, val));
+      ref[n++] = val;
+    }
+    TEST_ASSERT_TRUE(IntVec_size(&v) <= v.len);
+  }
+  TEST_ASSERT_EQUAL_size_t(n, IntVec_size(&v));
+  TEST_ASSERT_EQUAL_INT_ARRAY(ref, v.buf, n);
+  for (size_t i = 0; i < n; i++) {
+    TEST_ASSERT_EQUAL_INT(ref[i], IntVec_get(&v, i));
+  }
+  TEST_ASSERT_FALSE(IntVec_insert(&v, n + 1, 0));
+  TEST_ASSERT_NULL(IntVec_at(&v, n));
+  IntVec_free(&v);
+}
+
+void test_IntVec_shrinks() {
+  IntVec v;
+  TEST_ASSERT_TRUE(IntVec_init(&v, 0));
+  for (int i = 0; i < 100000; i++) {
+    IntVec_push(&v, i);
+  }
+  const size_t len = v.len;
+  int out = 0;
+  while (IntVec_size(&v) > 10) {
+    TEST_ASSERT_TRUE(IntVec_pop(&v, &out));
+  }
+  TEST_ASSERT_TRUE(v.len < len);
+  for (int i = 9; i >= 0; i--) {
+    TEST_ASSERT_TRUE(IntVec_pop(&v, &out));
+    TEST_ASSERT_EQUAL_INT(i, out);
+  }
+  TEST_ASSERT_FALSE(IntVec_pop(&v, &out));
+  IntVec_free(&v);
+}
+
+void test_PointVec() {
+  PointVec v;
+  TEST_ASSERT_TRUE(PointVec_init(&v, 4));
+  Point pts[50];
+  for (int i = 0; i < 50; i++) {
+    pts[i].x = i;
+    pts[i].y = -i;
+  }
+  TEST_ASSERT_TRUE(PointVec_append_n(&v, pts, 50));
+  TEST_ASSERT_TRUE(PointVec_reserve(&v, 1000));
+  TEST_ASSERT_TRUE(v.len >= 1000);
+  Point *p = PointVec_at(&v, 20);
+  TEST_ASSERT_TRUE(p->x == 20 && p->y == -20);
+  CADT_VecSpan s = PointVec_span(&v);
+  TEST_ASSERT_EQUAL_size_t(50, s.size);
+  TEST_ASSERT_EQUAL_size_t(sizeof(Point), s.memsz);
+  TEST_ASSERT_EQUAL_MEMORY(pts, s.buf, sizeof(pts));
+  PointVec_clear(&v);
+  TEST_ASSERT_EQUAL_size_t(0, PointVec_size(&v));
+  PointVec_free(&v);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_IntVec_random);
+  RUN_TEST(test_IntVec_shrinks);
+  RUN_TEST(test_PointVec);
+  return UNITY_END();
+}
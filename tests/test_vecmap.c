@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include "../vector.h"
+#include "../cadt.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define VECFILE "temp/test_vecmap.vec"
+
+typedef struct Rec {
+  uint32_t a;
+  uint32_t b;
+  uint32_t c;
+} Rec; /* 12 bytes, elements straddle page boundaries */
+
+static long file_size(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static Rec rec(const uint32_t i) {
+  Rec r = {i, i * 2, ~i};
+  return r;
+}
+
+static void check_recs(CADT_Vec *v, const size_t n) {
+  TEST_ASSERT_EQUAL_size_t(n, v->meta.size);
+  for (uint32_t i = 0; i < n; i++) {
+    const Rec r = rec(i);
+    TEST_ASSERT_EQUAL_MEMORY(&r, CADT_Vec_get_ref(v, i), sizeof(Rec));
+  }
+}
+
+static void push_recs(CADT_Vec *v, const uint32_t from, const uint32_t to) {
+  for (uint32_t i = from; i < to; i++) {
+    Rec r = rec(i);
+    CADT_Vec_push(v, &r, sizeof(r));
+  }
+}
+
+void setUp() {
+  remove(VECFILE);
+}
+
+void tearDown() {
+  remove(VECFILE);
+}
+
+void test_CADT_Vec_new_mapped() {
+  CADT_Vec *v = CADT_Vec_new_mapped(sizeof(Rec), 100000, 0);
+  TEST_ASSERT_NOT_NULL(v);
+  void *buf = v->buf;
+  push_recs(v, 0, 100000);
+  /* the buffer never moves */
+  TEST_ASSERT_EQUAL_PTR(buf, v->buf);
+  check_recs(v, 100000);
+  /* nor grows past what was reserved, which is maxsize rounded up to a
+   * whole page */
+  Rec r = rec(0);
+  size_t extra = 0;
+  while (CADT_Vec_append_n(v, &r, 1)) {
+    extra++;
+  }
+  TEST_ASSERT_TRUE(extra * sizeof(Rec) < (size_t)sysconf(_SC_PAGESIZE));
+  TEST_ASSERT_EQUAL_size_t(100000 + extra, v->meta.size);
+  CADT_Vec_free(v);
+
+  /* huge pages fall back to normal ones when there are none */
+  v = CADT_Vec_new_mapped(sizeof(long), 1 << 20, CADT_VEC_MAP_HUGETLB);
+  TEST_ASSERT_NOT_NULL(v);
+  for (long i = 0; i < 1000; i++) {
+    CADT_Vec_push(v, &i, sizeof(i));
+  }
+  TEST_ASSERT_EQUAL_INT64(999, *(long *)CADT_Vec_get_ref(v, 999));
+  CADT_Vec_free(v);
+  TEST_ASSERT_NULL(CADT_Vec_new_mapped(sizeof(long), 0, 0));
+}
+
+void test_CADT_Vec_open_file() {
+  CADT_Vec *v = CADT_Vec_open_file(VECFILE, sizeof(Rec), 1 << 20, 0);
+  TEST_ASSERT_NOT_NULL(v);
+  TEST_ASSERT_EQUAL_size_t(0, v->meta.size);
+  push_recs(v, 0, 5000);
+  CADT_Vec_free(v);
+  TEST_ASSERT_EQUAL_INT64(5000 * sizeof(Rec), file_size(VECFILE));
+
+  v = CADT_Vec_open_file(VECFILE, sizeof(Rec), 1 << 20, 0);
+  TEST_ASSERT_NOT_NULL(v);
+  check_recs(v, 5000);
+  push_recs(v, 5000, 7000);
+  CADT_Vec_free(v);
+  v = CADT_Vec_open_file(VECFILE, sizeof(Rec), 1 << 20, 0);
+  check_recs(v, 7000);
+  CADT_Vec_free(v);
+
+  /* too many elements for maxsize, or not a whole number of them */
+  TEST_ASSERT_NULL(CADT_Vec_open_file(VECFILE, sizeof(Rec), 6999, 0));
+  TEST_ASSERT_NULL(CADT_Vec_open_file(VECFILE, 11, 1 << 20, 0));
+}
+
+void test_CADT_Vec_sync() {
+  /* the file must hold the vector as of the last sync while it is still
+   * open, as if the process died without freeing it */
+  CADT_Vec *v = CADT_Vec_open_file(VECFILE, sizeof(Rec), 1 << 20, 0);
+  TEST_ASSERT_NOT_NULL(v);
+  push_recs(v, 0, 3000);
+  TEST_ASSERT_TRUE(CADT_Vec_sync(v));
+  TEST_ASSERT_EQUAL_INT64(3000 * sizeof(Rec), file_size(VECFILE));
+  CADT_Vec *reader = CADT_Vec_open_file(VECFILE, sizeof(Rec), 1 << 20, 0);
+  TEST_ASSERT_NOT_NULL(reader);
+  check_recs(reader, 3000);
+  CADT_Vec_free(reader);
+
+  /* growing after a sync extends the file again */
+  push_recs(v, 3000, 10000);
+  check_recs(v, 10000);
+  TEST_ASSERT_TRUE(CADT_Vec_sync(v));
+  TEST_ASSERT_EQUAL_INT64(10000 * sizeof(Rec), file_size(VECFILE));
+  Rec r;
+  TEST_ASSERT_TRUE(CADT_Vec_pop_into(v, &r));
+  TEST_ASSERT_TRUE(CADT_Vec_sync(v));
+  TEST_ASSERT_EQUAL_INT64(9999 * sizeof(Rec), file_size(VECFILE));
+  push_recs(v, 9999, 10001);
+  CADT_Vec_free(v);
+
+  v = CADT_Vec_open_file(VECFILE, sizeof(Rec), 1 << 20, 0);
+  check_recs(v, 10001);
+  CADT_Vec_free(v);
+
+  /* only file backed vectors sync */
+  v = CADT_Vec_new_mapped(sizeof(Rec), 10, 0);
+  TEST_ASSERT_FALSE(CADT_Vec_sync(v));
+  CADT_Vec_free(v);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Vec_new_mapped);
+  RUN_TEST(test_CADT_Vec_open_file);
+  RUN_TEST(test_CADT_Vec_sync);
+  return UNITY_END();
+}
@@ -0,0 +1,99 @@
+#include "unity.h"
+#include "../vector.h"
+#include "../cadt.h"
+
+#define MAXW 32
+#define MAXN 300
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/* bytes of 0 or 1 only, so elements often share some but not all of
+ * their bytes with the value searched for */
+static void fill(unsigned char *p, const size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    p[i] = (unsigned char)(next_rand() % 8 == 0);
+  }
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+}
+
+void tearDown() {
+}
+
+void test_CADT_Vec_search_random() {
+  const size_t widths[] = {1, 2, 3, 4, 8, 12, 16, 32};
+  static unsigned char buf[MAXN * MAXW];
+  static size_t idx[MAXN];
+  static size_t ref[MAXN];
+  unsigned char val[MAXW];
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    const size_t memsz = widths[w];
+    for (int round = 0; round < 200; round++) {
+      const size_t n = next_rand() % MAXN;
+      fill(buf, n * memsz);
+      fill(val, memsz);
+      if (n > 0 && round % 2) {
+        memcpy(val, buf + next_rand() % n * memsz, memsz);
+      }
+      CADT_Vec *vector = CADT_Vec_new(0, memsz);
+      TEST_ASSERT_TRUE(CADT_Vec_append_n(vector, buf, n));
+
+      size_t nref = 0;
+      for (size_t i = 0; i < n; i++) {
+        if (memcmp(buf + i * memsz, val, memsz) == 0) {
+          ref[nref++] = i;
+        }
+      }
+      TEST_ASSERT_EQUAL_size_t(nref ? ref[0] : CADT_VEC_NOTFOUND,
+                               CADT_Vec_find(vector, val));
+      TEST_ASSERT_EQUAL(nref > 0, CADT_Vec_contains(vector, val));
+      TEST_ASSERT_EQUAL_size_t(nref, CADT_Vec_count(vector, val));
+      TEST_ASSERT_EQUAL_size_t(nref,
+                               CADT_Vec_find_all(vector, val, idx, MAXN));
+      TEST_ASSERT_EQUAL_MEMORY(ref, idx, nref * sizeof(size_t));
+      /* more matches than room, only the first ones are written */
+      const size_t cap = nref / 2;
+      idx[cap] = SIZE_MAX;
+      TEST_ASSERT_EQUAL_size_t(nref, CADT_Vec_find_all(vector, val, idx, cap));
+      TEST_ASSERT_EQUAL_MEMORY(ref, idx, cap * sizeof(size_t));
+      TEST_ASSERT_EQUAL_size_t(SIZE_MAX, idx[cap]);
+      CADT_Vec_free(vector);
+    }
+  }
+}
+
+void test_CADT_Vec_search_last() {
+  /* a match in the tail past the last full block */
+  for (size_t n = 1; n < 100; n++) {
+    CADT_Vec *vector = CADT_Vec_new(0, sizeof(uint16_t));
+    for (uint16_t i = 0; i < n; i++) {
+      CADT_Vec_push(vector, &i, sizeof(i));
+    }
+    const uint16_t last = (uint16_t)(n - 1);
+    const uint16_t none = (uint16_t)n;
+    TEST_ASSERT_EQUAL_size_t(n - 1, CADT_Vec_find(vector, &last));
+    TEST_ASSERT_EQUAL_size_t(CADT_VEC_NOTFOUND, CADT_Vec_find(vector, &none));
+    CADT_Vec_free(vector);
+  }
+  CADT_Vec *empty = CADT_Vec_new(0, sizeof(int));
+  int x = 0;
+  TEST_ASSERT_FALSE(CADT_Vec_contains(empty, &x));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_count(empty, &x));
+  CADT_Vec_free(empty);
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Vec_search_random);
+  RUN_TEST(test_CADT_Vec_search_last);
+  return UNITY_END();
+}
@@ -0,0 +1,271 @@
+#include "unity.h"
+#include "../vector.h"
+#include "../cadt.h"
+
+#define MAXN 3000
+
+typedef struct Rec {
+  int64_t key;
+  int64_t pad[2]; /* 24 bytes, not a swap width of its own */
+} Rec;
+
+static uint64_t rng;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static int cmp_int(const void *a, const void *b) {
+  const int x = *(const int *)a;
+  const int y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+static int cmp_rec(const void *a, const void *b) {
+  const int64_t x = ((const Rec *)a)->key;
+  const int64_t y = ((const Rec *)b)->key;
+  return (x > y) - (x < y);
+}
+
+/* n ints shaped by kind: random, few distinct, sorted, reversed */
+static void fill_ints(int *p, const size_t n, const int kind) {
+  for (size_t i = 0; i < n; i++) {
+    switch (kind) {
+      case 0:
+        p[i] = (int)next_rand();
+        break;
+      case 1:
+        p[i] = (int)(next_rand() % 4);
+        break;
+      case 2:
+        p[i] = (int)i;
+        break;
+      default:
+        p[i] = (int)(n - i);
+        break;
+    }
+  }
+}
+
+static CADT_Vec *vec_of(const void *buf, const size_t n, const size_t memsz) {
+  CADT_Vec *vector = CADT_Vec_new(0, memsz);
+  TEST_ASSERT_TRUE(CADT_Vec_append_n(vector, buf, n));
+  return vector;
+}
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+}
+
+void tearDown() {
+}
+
+void test_CADT_Vec_sort_ints() {
+  static int ref[MAXN];
+  for (int round = 0; round < 200; round++) {
+    const size_t n = next_rand() % MAXN;
+    fill_ints(ref, n, round % 4);
+    CADT_Vec *vector = vec_of(ref, n, sizeof(int));
+    qsort(ref, n, sizeof(int), cmp_int);
+    CADT_Vec_sort(vector, cmp_int);
+    TEST_ASSERT_EQUAL_INT_ARRAY(ref, vector->buf, n);
+    CADT_Vec_free(vector);
+  }
+}
+
+void test_CADT_Vec_sort_records() {
+  static Rec ref[MAXN];
+  for (int round = 0; round < 50; round++) {
+    const size_t n = next_rand() % MAXN;
+    for (size_t i = 0; i < n; i++) {
+      ref[i].key = (int64_t)(next_rand() % 100);
+      ref[i].pad[0] = ref[i].key * 3;
+      ref[i].pad[1] = -ref[i].key;
+    }
+    CADT_Vec *vector = vec_of(ref, n, sizeof(Rec));
+    qsort(ref, n, sizeof(Rec), cmp_rec);
+    CADT_Vec_sort(vector, cmp_rec);
+    /* equal keys carry equal payloads, so the order of ties is moot */
+    TEST_ASSERT_EQUAL_MEMORY(ref, vector->buf, n * sizeof(Rec));
+    CADT_Vec_free(vector);
+  }
+}
+
+#define CMP(T)                                                                 \
+  static int cmp_##T(const void *a, const void *b) {                           \
+    const T x = *(const T *)a;                                                 \
+    const T y = *(const T *)b;                                                 \
+    return (x > y) - (x < y);                                                  \
+  }
+
+CMP(uint8_t)
+CMP(int8_t)
+CMP(uint16_t)
+CMP(int16_t)
+CMP(uint32_t)
+CMP(int32_t)
+CMP(uint64_t)
+CMP(int64_t)
+CMP(float)
+CMP(double)
+
+/* radix sort n keys of type T made by GEN and compare with qsort. -0.0
+ * sorts before 0.0 but they compare equal, so keys are compared by value
+ * rather than by their bytes */
+#define RADIX_TEST(T, TYPE, GEN)                                               \
+  do {                                                                         \
+    static T buf[MAXN];                                                        \
+    for (int round = 0; round < 20; round++) {                                 \
+      const size_t n = next_rand() % MAXN;                                     \
+      for (size_t i = 0; i < n; i++) {                                         \
+        buf[i] = (T)(GEN);                                                     \
+      }                                                                        \
+      CADT_Vec *vector = vec_of(buf, n, sizeof(T));                            \
+      TEST_ASSERT_TRUE(CADT_Vec_radix_sort(vector, TYPE));                     \
+      qsort(buf, n, sizeof(T), cmp_##T);                                       \
+      const T *p = (const T *)vector->buf;                                     \
+      for (size_t i = 0; i < n; i++) {                                         \
+        TEST_ASSERT_TRUE(buf[i] == p[i]);                                      \
+      }                                                                        \
+      CADT_Vec_free(vector);                                                   \
+    }                                                                          \
+  } while (0)
+
+void test_CADT_Vec_radix_sort() {
+  RADIX_TEST(uint8_t, CADT_KEY_UINT, next_rand());
+  RADIX_TEST(int8_t, CADT_KEY_INT, next_rand());
+  RADIX_TEST(uint16_t, CADT_KEY_UINT, next_rand());
+  RADIX_TEST(int16_t, CADT_KEY_INT, next_rand());
+  RADIX_TEST(uint32_t, CADT_KEY_UINT, next_rand());
+  RADIX_TEST(int32_t, CADT_KEY_INT, next_rand());
+  RADIX_TEST(uint64_t, CADT_KEY_UINT, next_rand());
+  RADIX_TEST(int64_t, CADT_KEY_INT, next_rand());
+  /* only a few digits differ, the others are skipped */
+  RADIX_TEST(uint64_t, CADT_KEY_UINT, next_rand() % 1000);
+  RADIX_TEST(int64_t, CADT_KEY_INT, (int64_t)(next_rand() % 1000) - 500);
+  RADIX_TEST(float, CADT_KEY_FLOAT,
+             (double)(int64_t)next_rand() / 1e12 *
+                 (next_rand() % 2 ? 1e-20 : 1));
+  RADIX_TEST(double, CADT_KEY_FLOAT,
+             (double)(int64_t)next_rand() / (double)(next_rand() | 1));
+  RADIX_TEST(double, CADT_KEY_FLOAT,
+             next_rand() % 4 == 0 ? (next_rand() % 2 ? -0.0 : 0.0)
+                                  : (double)(int64_t)(next_rand() % 7) - 3);
+}
+
+void test_CADT_Vec_radix_sort_rejects() {
+  /* keys of widths it does not know are refused and left alone */
+  Rec recs[10] = {{0, {0, 0}}};
+  CADT_Vec *vector = vec_of(recs, 10, sizeof(Rec));
+  TEST_ASSERT_FALSE(CADT_Vec_radix_sort(vector, CADT_KEY_UINT));
+  CADT_Vec_free(vector);
+  const uint16_t halfs[3] = {3, 2, 1};
+  vector = vec_of(halfs, 3, sizeof(uint16_t));
+  TEST_ASSERT_FALSE(CADT_Vec_radix_sort(vector, CADT_KEY_FLOAT));
+  TEST_ASSERT_EQUAL_MEMORY(halfs, vector->buf, sizeof(halfs));
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_bounds() {
+  static int buf[MAXN];
+  for (int round = 0; round < 50; round++) {
+    const size_t n = next_rand() % MAXN;
+    for (size_t i = 0; i < n; i++) {
+      buf[i] = (int)(next_rand() % 64);
+    }
+    qsort(buf, n, sizeof(int), cmp_int);
+    CADT_Vec *vector = vec_of(buf, n, sizeof(int));
+    for (int val = -1; val <= 64; val++) {
+      size_t less = 0;
+      size_t equal = 0;
+      for (size_t i = 0; i < n; i++) {
+        less += buf[i] < val;
+        equal += buf[i] == val;
+      }
+      TEST_ASSERT_EQUAL_size_t(less, CADT_Vec_lower_bound(vector, &val,
+                                                          cmp_int));
+      TEST_ASSERT_EQUAL_size_t(less + equal,
+                               CADT_Vec_upper_bound(vector, &val, cmp_int));
+      size_t lo;
+      size_t hi;
+      CADT_Vec_equal_range(vector, &val, cmp_int, &lo, &hi);
+      TEST_ASSERT_EQUAL_size_t(less, lo);
+      TEST_ASSERT_EQUAL_size_t(less + equal, hi);
+    }
+    CADT_Vec_free(vector);
+  }
+  /* no vector or no cmp is an empty range */
+  const int val = 1;
+  size_t lo = 7;
+  size_t hi = 7;
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_lower_bound(NULL, &val, cmp_int));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_upper_bound(NULL, &val, cmp_int));
+  CADT_Vec_equal_range(NULL, &val, cmp_int, &lo, &hi);
+  TEST_ASSERT_EQUAL_size_t(0, lo);
+  TEST_ASSERT_EQUAL_size_t(0, hi);
+  CADT_Vec *vector = vec_of(buf, 10, sizeof(int));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_lower_bound(vector, &val, NULL));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_upper_bound(vector, &val, NULL));
+  lo = hi = 7;
+  CADT_Vec_equal_range(vector, &val, NULL, &lo, &hi);
+  TEST_ASSERT_EQUAL_size_t(0, lo);
+  TEST_ASSERT_EQUAL_size_t(0, hi);
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_nth_element() {
+  static int ref[MAXN];
+  for (int round = 0; round < 200; round++) {
+    const size_t n = next_rand() % MAXN + 1;
+    fill_ints(ref, n, round % 4);
+    CADT_Vec *vector = vec_of(ref, n, sizeof(int));
+    qsort(ref, n, sizeof(int), cmp_int);
+    /* the ends and anywhere between */
+    const size_t nth = round % 3 == 0 ? 0 : round % 3 == 1
+                                                ? n - 1
+                                                : next_rand() % n;
+    CADT_Vec_nth_element(vector, nth, cmp_int);
+    int *p = (int *)vector->buf;
+    TEST_ASSERT_EQUAL_INT(ref[nth], p[nth]);
+    for (size_t i = 0; i < n; i++) {
+      TEST_ASSERT_TRUE(i < nth ? p[i] <= p[nth] : p[i] >= p[nth]);
+    }
+    /* the elements are only moved around */
+    CADT_Vec_sort(vector, cmp_int);
+    TEST_ASSERT_EQUAL_INT_ARRAY(ref, vector->buf, n);
+    CADT_Vec_free(vector);
+  }
+}
+
+void test_CADT_Vec_partial_sort() {
+  static int ref[MAXN];
+  for (int round = 0; round < 200; round++) {
+    const size_t n = next_rand() % MAXN;
+    fill_ints(ref, n, round % 4);
+    CADT_Vec *vector = vec_of(ref, n, sizeof(int));
+    qsort(ref, n, sizeof(int), cmp_int);
+    /* k past the size sorts everything */
+    const size_t k = next_rand() % (n + 10);
+    CADT_Vec_partial_sort(vector, k, cmp_int);
+    const size_t sorted = k < n ? k : n;
+    TEST_ASSERT_EQUAL_INT_ARRAY(ref, vector->buf, sorted);
+    CADT_Vec_sort(vector, cmp_int);
+    TEST_ASSERT_EQUAL_INT_ARRAY(ref, vector->buf, n);
+    CADT_Vec_free(vector);
+  }
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_Vec_sort_ints);
+  RUN_TEST(test_CADT_Vec_sort_records);
+  RUN_TEST(test_CADT_Vec_radix_sort);
+  RUN_TEST(test_CADT_Vec_radix_sort_rejects);
+  RUN_TEST(test_CADT_Vec_bounds);
+  RUN_TEST(test_CADT_Vec_nth_element);
+  RUN_TEST(test_CADT_Vec_partial_sort);
+  return UNITY_END();
+}
@@ -2,22 +2,278 @@
 #include "../vector.h"
 #include "../cadt.h"
 
-void Setup() {
+static uint64_t rng;
+static size_t reallocs;
+
+static uint64_t next_rand(void) {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+static void *count_alloc(void *ctx, size_t n) {
+  (void)ctx;
+  reallocs++;
+  return malloc(n);
+}
+
+static void *count_realloc(void *ctx, void *p, size_t n) {
+  (void)ctx;
+  reallocs++;
+  return realloc(p, n);
+}
+
+static void count_free(void *ctx, void *p) {
+  (void)ctx;
+  free(p);
+}
+
+static const CADT_Allocator counting = {count_alloc, count_realloc,
+                                        count_free, NULL};
+
+void setUp() {
+  rng = 0x9e3779b97f4a7c15ull;
+  reallocs = 0;
 }
 
 void tearDown() {
 }
 
+static CADT_Vec *iota(const size_t n) {
+  CADT_Vec *vector = CADT_Vec_new(0, sizeof(int));
+  for (int i = 0; i < (int)n; i++) {
+    CADT_Vec_push(vector, &i, sizeof(int));
+  }
+  return vector;
+}
+
 void test_CADT_Vec_new() {
   CADT_Vec *vector = CADT_Vec_new(10, sizeof(int));
-  TEST_ASSERT_EQUAL(10, vector->size);
-  TEST_ASSERT_GREATER_THAN(vector->size, vector->len);
-  TEST_ASSERT_NULL(vector->buf);
-  TEST_ASSERT_EQUAL(sizeof(int), vector->memsz);
+  TEST_ASSERT_EQUAL(10, vector->meta.size);
+  TEST_ASSERT_GREATER_THAN(vector->meta.size, vector->meta.len);
+  TEST_ASSERT_NOT_NULL(vector->buf);
+  TEST_ASSERT_EQUAL(sizeof(int), vector->meta.memsz);
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_get_ref() {
+  CADT_Vec *vector = iota(100);
+  for (size_t i = 0; i < 100; i++) {
+    int *p = (int *)CADT_Vec_get_ref(vector, i);
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_INT((int)i, *p);
+    TEST_ASSERT_EQUAL_PTR(p, CADT_Vec_at_unchecked(vector, i));
+    /* a borrowed element is written in place */
+    *p = -*p;
+  }
+  TEST_ASSERT_NULL(CADT_Vec_get_ref(vector, 100));
+  TEST_ASSERT_NULL(CADT_Vec_get_ref(NULL, 0));
+  int out;
+  for (int i = 99; i >= 0; i--) {
+    TEST_ASSERT_TRUE(CADT_Vec_pop_into(vector, &out));
+    TEST_ASSERT_EQUAL_INT(-i, out);
+  }
+  TEST_ASSERT_FALSE(CADT_Vec_pop_into(vector, &out));
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_span() {
+  CADT_Vec *vector = iota(10);
+  CADT_VecSpan s = CADT_Vec_span(vector, 2, 5);
+  TEST_ASSERT_EQUAL_size_t(5, s.size);
+  TEST_ASSERT_EQUAL_size_t(sizeof(int), s.memsz);
+  TEST_ASSERT_EQUAL_INT(2, *(int *)CADT_VecSpan_at(s, 0));
+  TEST_ASSERT_EQUAL_INT(6, *(int *)CADT_VecSpan_at(s, 4));
+  /* clamped to the end of the vector */
+  TEST_ASSERT_EQUAL_size_t(3, CADT_Vec_span(vector, 7, 100).size);
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_span(vector, 10, 1).size);
+  TEST_ASSERT_EQUAL_size_t(0, CADT_Vec_span(vector, 11, 1).size);
+
+  CADT_VecSpan sub = CADT_VecSpan_sub(s, 1, 2);
+  TEST_ASSERT_EQUAL_size_t(2, sub.size);
+  TEST_ASSERT_EQUAL_INT(3, *(int *)CADT_VecSpan_at(sub, 0));
+  TEST_ASSERT_EQUAL_size_t(1, CADT_VecSpan_sub(s, 4, 9).size);
+  sub = CADT_VecSpan_sub(s, 9, 1);
+  TEST_ASSERT_EQUAL_size_t(0, sub.size);
+  TEST_ASSERT_EQUAL_PTR(CADT_VecSpan_at(s, s.size), sub.buf);
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_bulk_random() {
+  static int ref[2000 * 64];
+  size_t n = 0;
+  int vals[64];
+  CADT_Vec *vector = CADT_Vec_new(0, sizeof(int));
+  for (int i = 0; i < 2000; i++) {
+    const size_t k = next_rand() % 64;
+    for (size_t j = 0; j < k; j++) {
+      vals[j] = (int)next_rand();
+    }
+    const size_t idx = next_rand() % (n + 1);
+    switch (next_rand() % 3) {
+      case 0:
+        TEST_ASSERT_TRUE(CADT_Vec_insert_range(vector, idx, vals, k));
+        memmove(ref + idx + k, ref + idx, (n - idx) * sizeof(int));
+        memcpy(ref + idx, vals, k * sizeof(int));
+        break;
+      case 1:
+        TEST_ASSERT_TRUE(CADT_Vec_append_n(vector, vals, k));
+        memcpy(ref + n, vals, k * sizeof(int));
+        break;
+      default:
+        TEST_ASSERT_TRUE(
+            CADT_Vec_extend_from_buffer(vector, vals, k * sizeof(int)));
+        memcpy(ref + n, vals, k * sizeof(int));
+        break;
+    }
+    n += k;
+    TEST_ASSERT_EQUAL_size_t(n, vector->meta.size);
+  }
+  TEST_ASSERT_EQUAL_INT_ARRAY(ref, vector->buf, n);
+  TEST_ASSERT_FALSE(CADT_Vec_insert_range(vector, n + 1, vals, 1));
+  TEST_ASSERT_FALSE(CADT_Vec_extend_from_buffer(vector, vals, 3));
+  TEST_ASSERT_EQUAL_size_t(n, vector->meta.size);
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_amortized_growth() {
+  CADT_Vec *vector = CADT_Vec_new_with(0, sizeof(int), &counting);
+  reallocs = 0;
+  for (int i = 0; i < 100000; i++) {
+    CADT_Vec_push(vector, &i, sizeof(int));
+  }
+  /* geometric growth by 1.65 reaches 100000 in about 25 steps */
+  TEST_ASSERT_TRUE(reallocs < 40);
+  for (int i = 0; i < 100000; i++) {
+    TEST_ASSERT_EQUAL_INT(i, *(int *)CADT_Vec_get_ref(vector, i));
+  }
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_resize_uninit() {
+  CADT_Vec *vector = iota(10);
+  int *p = (int *)CADT_Vec_resize_uninit(vector, 1000);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_PTR(CADT_Vec_get_ref(vector, 10), p);
+  for (int i = 10; i < 1000; i++) {
+    *p++ = i;
+  }
+  for (int i = 0; i < 1000; i++) {
+    TEST_ASSERT_EQUAL_INT(i, *(int *)CADT_Vec_get_ref(vector, i));
+  }
+  /* shrinking keeps the leading elements */
+  p = (int *)CADT_Vec_resize_uninit(vector, 5);
+  TEST_ASSERT_NOT_NULL(p);
+  TEST_ASSERT_EQUAL_size_t(5, vector->meta.size);
+  TEST_ASSERT_EQUAL_INT(4, *(int *)CADT_Vec_get_ref(vector, 4));
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_inline() {
+  CADT_Vec *vector = CADT_Vec_new_with(0, sizeof(long), &counting);
+  reallocs = 0;
+  /* CADT_VEC_INLINE_BYTES hold 8 longs without a separate buffer */
+  for (long i = 0; i < 8; i++) {
+    CADT_Vec_push(vector, &i, sizeof(i));
+  }
+  TEST_ASSERT_EQUAL_size_t(0, reallocs);
+  TEST_ASSERT_EQUAL_PTR(vector->inl, vector->buf);
+  /* the ninth spills to the heap with the first eight */
+  for (long i = 8; i < 100; i++) {
+    CADT_Vec_push(vector, &i, sizeof(i));
+  }
+  TEST_ASSERT_TRUE(vector->buf != (void *)vector->inl);
+  for (long i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL_INT64(i, *(long *)CADT_Vec_get_ref(vector, i));
+  }
+  CADT_Vec_free(vector);
+
+  /* no inline storage at all, and inline storage sized to fit */
+  vector = CADT_Vec_new_inline(0, sizeof(int), 0, NULL);
+  TEST_ASSERT_EQUAL_size_t(0, vector->meta.len);
+  for (int i = 0; i < 10; i++) {
+    CADT_Vec_push(vector, &i, sizeof(i));
+  }
+  TEST_ASSERT_EQUAL_INT(9, *(int *)CADT_Vec_get_ref(vector, 9));
+  CADT_Vec_free(vector);
+  vector = CADT_Vec_new_inline(100, sizeof(int), 100 * sizeof(int), NULL);
+  TEST_ASSERT_EQUAL_size_t(100, vector->meta.size);
+  TEST_ASSERT_EQUAL_PTR(vector->inl, vector->buf);
+  CADT_Vec_free(vector);
+
+  /* the vector keeps its own copy of the allocator, after the inline
+   * bytes, so the one passed in can go away */
+  CADT_Allocator *a = malloc(sizeof(*a));
+  *a = counting;
+  vector = CADT_Vec_new_inline(0, sizeof(char), 3, a);
+  free(a);
+  reallocs = 0;
+  for (int i = 0; i < 100; i++) {
+    const char c = (char)i;
+    CADT_Vec_push(vector, &c, 1);
+  }
+  TEST_ASSERT_TRUE(reallocs > 0);
+  TEST_ASSERT_EQUAL_INT(99, *(char *)CADT_Vec_get_ref(vector, 99));
+  CADT_Vec_free(vector);
+}
+
+void test_CADT_Vec_concat() {
+  /* both halves and the result fit the inline storage exactly */
+  const long a[4] = {1, 2, 3, 4};
+  const long b[4] = {5, 6, 7, 8};
+  CADT_Vec *v1 = CADT_Vec_new(0, sizeof(long));
+  CADT_Vec *v2 = CADT_Vec_new(0, sizeof(long));
+  CADT_Vec_append_n(v1, a, 4);
+  CADT_Vec_append_n(v2, b, 4);
+  CADT_Vec *v3 = CADT_Vec_concat(v1, v2);
+  TEST_ASSERT_NOT_NULL(v3);
+  TEST_ASSERT_EQUAL_size_t(8, v3->meta.size);
+  TEST_ASSERT_EQUAL_MEMORY(a, CADT_Vec_get_ref(v3, 0), sizeof(a));
+  TEST_ASSERT_EQUAL_MEMORY(b, CADT_Vec_get_ref(v3, 4), sizeof(b));
+  /* the result is a vector like any other and can grow */
+  long x = 9;
+  CADT_Vec_push(v3, &x, sizeof(x));
+  TEST_ASSERT_EQUAL_INT64(9, *(long *)CADT_Vec_get_ref(v3, 8));
+  CADT_Vec_free(v3);
+
+  /* a heap buffer and an inline one */
+  CADT_Vec *big = iota(1000);
+  CADT_Vec *small = iota(3);
+  v3 = CADT_Vec_concat(big, small);
+  TEST_ASSERT_EQUAL_size_t(1003, v3->meta.size);
+  TEST_ASSERT_EQUAL_INT(999, *(int *)CADT_Vec_get_ref(v3, 999));
+  TEST_ASSERT_EQUAL_INT(2, *(int *)CADT_Vec_get_ref(v3, 1002));
+  CADT_Vec_free(v3);
+  CADT_Vec_free(big);
+  CADT_Vec_free(small);
+  CADT_Vec_free(v1);
+  CADT_Vec_free(v2);
+
+  /* elements wider than the inline storage, nothing to copy */
+  v1 = CADT_Vec_new(0, 100);
+  v2 = CADT_Vec_new(0, 100);
+  v3 = CADT_Vec_concat(v1, v2);
+  TEST_ASSERT_NOT_NULL(v3);
+  TEST_ASSERT_EQUAL_size_t(0, v3->meta.size);
+  CADT_Vec_free(v3);
+  CADT_Vec_free(v2);
+  /* mismatched element sizes */
+  v2 = CADT_Vec_new(0, 8);
+  TEST_ASSERT_NULL(CADT_Vec_concat(v1, v2));
+  CADT_Vec_free(v2);
+  CADT_Vec_free(v1);
 }
 
 int main(void) {
   UNITY_BEGIN();
   RUN_TEST(test_CADT_Vec_new);
+  RUN_TEST(test_CADT_Vec_get_ref);
+  RUN_TEST(test_CADT_Vec_span);
+  RUN_TEST(test_CADT_Vec_bulk_random);
+  RUN_TEST(test_CADT_Vec_amortized_growth);
+  RUN_TEST(test_CADT_Vec_resize_uninit);
+  RUN_TEST(test_CADT_Vec_inline);
+  RUN_TEST(test_CADT_Vec_concat);
   return UNITY_END();
 }
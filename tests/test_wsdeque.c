@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+#include "unity.h"
+#include "../wsdeque.h"
+#include "../cadt.h"
+#include <pthread.h>
+#include <sched.h>
+
+#define NTASKS 200000
+#define NTHIEVES 3
+#define NINDEX 100000
+
+static atomic_int taken[NTASKS]; /* times each task came out */
+static atomic_int runs[NINDEX];  /* times fn saw each index */
+static atomic_bool stop;
+static atomic_bool too_long;
+
+void setUp() {
+  for (size_t i = 0; i < NTASKS; i++) {
+    atomic_init(&taken[i], 0);
+  }
+  for (size_t i = 0; i < NINDEX; i++) {
+    atomic_init(&runs[i], 0);
+  }
+  atomic_init(&stop, false);
+  atomic_init(&too_long, false);
+}
+
+void tearDown() {
+}
+
+static void *task(const size_t i) {
+  return (void *)&taken[i];
+}
+
+void test_CADT_WSDeque_ends() {
+  CADT_WSDeque *d = CADT_WSDeque_new(0);
+  TEST_ASSERT_NOT_NULL(d);
+  TEST_ASSERT_NULL(CADT_WSDeque_pop(d));
+  TEST_ASSERT_NULL(CADT_WSDeque_steal(d));
+  /* past the first ring, so it grows a few times */
+  for (size_t i = 0; i < 1000; i++) {
+    TEST_ASSERT_TRUE(CADT_WSDeque_push(d, task(i)));
+  }
+  TEST_ASSERT_EQUAL_size_t(1000, CADT_WSDeque_size(d));
+  /* the owner takes the newest, thieves the oldest */
+  TEST_ASSERT_EQUAL_PTR(task(999), CADT_WSDeque_pop(d));
+  TEST_ASSERT_EQUAL_PTR(task(0), CADT_WSDeque_steal(d));
+  TEST_ASSERT_EQUAL_PTR(task(1), CADT_WSDeque_steal(d));
+  TEST_ASSERT_EQUAL_PTR(task(998), CADT_WSDeque_pop(d));
+  for (size_t i = 997; i >= 500; i--) {
+    TEST_ASSERT_EQUAL_PTR(task(i), CADT_WSDeque_pop(d));
+  }
+  for (size_t i = 2; i < 500; i++) {
+    TEST_ASSERT_EQUAL_PTR(task(i), CADT_WSDeque_steal(d));
+  }
+  TEST_ASSERT_NULL(CADT_WSDeque_pop(d));
+  TEST_ASSERT_NULL(CADT_WSDeque_steal(d));
+  TEST_ASSERT_EQUAL_size_t(0, CADT_WSDeque_size(d));
+  TEST_ASSERT_FALSE(CADT_WSDeque_push(d, NULL));
+  CADT_WSDeque_free(d);
+}
+
+static void take(void *t) {
+  atomic_fetch_add((atomic_int *)t, 1);
+}
+
+static void *thief(void *arg) {
+  CADT_WSDeque *d = (CADT_WSDeque *)arg;
+  for (;;) {
+    const bool last = atomic_load(&stop);
+    void *t = CADT_WSDeque_steal(d);
+    if (t != NULL) {
+      take(t);
+    } else if (last) {
+      return NULL;
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+void test_CADT_WSDeque_steal_threads() {
+  /* a small ring, so the owner grows it while thieves read the old one */
+  CADT_WSDeque *d = CADT_WSDeque_new(0);
+  pthread_t thieves[NTHIEVES];
+  for (size_t i = 0; i < NTHIEVES; i++) {
+    TEST_ASSERT_EQUAL_INT(0, pthread_create(&thieves[i], NULL, thief, d));
+  }
+  for (size_t i = 0; i < NTASKS; i++) {
+    TEST_ASSERT_TRUE(CADT_WSDeque_push(d, task(i)));
+    /* pop now and then, racing the thieves for the last task */
+    if (i % 3 == 0) {
+      void *t = CADT_WSDeque_pop(d);
+      if (t != NULL) {
+        take(t);
+      }
+    }
+  }
+  void *t;
+  while ((t = CADT_WSDeque_pop(d)) != NULL) {
+    take(t);
+  }
+  atomic_store(&stop, true);
+  for (size_t i = 0; i < NTHIEVES; i++) {
+    pthread_join(thieves[i], NULL);
+  }
+  for (size_t i = 0; i < NTASKS; i++) {
+    TEST_ASSERT_EQUAL_INT(1, atomic_load(&taken[i]));
+  }
+  CADT_WSDeque_free(d);
+}
+
+static void mark(size_t lo, size_t hi, void *arg) {
+  const size_t grain = *(const size_t *)arg;
+  if (hi <= lo || hi - lo > grain) {
+    atomic_store(&too_long, true);
+  }
+  for (size_t i = lo; i < hi; i++) {
+    atomic_fetch_add(&runs[i], 1);
+  }
+}
+
+void test_CADT_parallel_for() {
+  const size_t grains[] = {1, 7, 1000, NINDEX * 2};
+  const size_t threads[] = {0, 1, 4};
+  for (size_t g = 0; g < sizeof(grains) / sizeof(grains[0]); g++) {
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+      size_t grain = grains[g];
+      /* start away from 0, which must not matter */
+      TEST_ASSERT_TRUE(
+          CADT_parallel_for(13, NINDEX, grain, threads[t], mark, &grain));
+      TEST_ASSERT_FALSE(atomic_load(&too_long));
+      for (size_t i = 0; i < NINDEX; i++) {
+        TEST_ASSERT_EQUAL_INT(i >= 13, atomic_exchange(&runs[i], 0));
+      }
+    }
+  }
+  /* an empty range calls nothing */
+  size_t grain = 1;
+  TEST_ASSERT_TRUE(CADT_parallel_for(5, 5, grain, 4, mark, &grain));
+  TEST_ASSERT_EQUAL_INT(0, atomic_load(&runs[5]));
+}
+
+int main(void) {
+  UNITY_BEGIN();
+  RUN_TEST(test_CADT_WSDeque_ends);
+  RUN_TEST(test_CADT_WSDeque_steal_threads);
+  RUN_TEST(test_CADT_parallel_for);
+  return UNITY_END();
+}
@@ -0,0 +1,113 @@
+/* Streaming top k. A CADT_TopK keeps the k best elements it has been
+ * given in a heap ordered the other way round, so the worst of them is on
+ * top. Once k elements are held a candidate is compared with the top only
+ * and dropped unless it beats it, which is what most candidates of a long
+ * stream do, so memory stays O(k) and a stream of n costs O(n) compares
+ * plus O(log k) for each accepted element. */
+
+#include "heap.h"
+#include <string.h>
+
+
+/* val is better than the worst element kept */
+static bool tbeats(const CADT_TopK *const t, const void *val) {
+  const CADT_Heap *h = t->heap;
+  const int c = h->meta.cmp(val, CADT_Heap_peek(h));
+  return h->meta.heap_type == MIN ? c > 0 : c < 0;
+}
+
+
+/* MAX keeps the k greatest elements by cmp, MIN the k smallest */
+CADT_TopK *CADT_TopK_new(const size_t k, const size_t memsz,
+                         const CADTHeapType type,
+                         int (*cmp)(const void *, const void *),
+                         const CADT_Allocator *alloc) {
+  const CADT_Allocator a = CADT_allocator_(alloc);
+  CADT_TopK *t = (CADT_TopK *)CADT_alloc_(&a, sizeof(CADT_TopK));
+  if (t == NULL) {
+    return NULL;
+  }
+  t->k = k;
+  /* room for k + 1 so the top never moves while k are held */
+  t->heap = CADT_Heap_new_with(k + 1, memsz, type == MAX ? MIN : MAX, cmp,
+                               &a);
+  if (t->heap == NULL) {
+    CADT_free_(&a, t);
+    return NULL;
+  }
+  return t;
+}
+
+
+/* offer val, return whether it is kept for now */
+bool CADT_TopK_push(CADT_TopK *t, const void *val) {
+  if (t == NULL || val == NULL || t->k == 0) {
+    return false;
+  }
+  if (t->heap->meta.size < t->k) {
+    return CADT_Heap_insert(t->heap, val);
+  }
+  return tbeats(t, val) && CADT_Heap_replace_top(t->heap, val);
+}
+
+
+/* offer the n elements of vals, return how many were kept for now */
+size_t CADT_TopK_push_many(CADT_TopK *t, const void *vals, const size_t n) {
+  if (t == NULL || vals == NULL || t->k == 0) {
+    return 0;
+  }
+  const unsigned char *src = (const unsigned char *)vals;
+  const size_t memsz = t->heap->meta.memsz;
+  size_t i = 0;
+  size_t kept = 0;
+  for (; i < n && t->heap->meta.size < t->k; i++) {
+    kept += CADT_Heap_insert(t->heap, src + i * memsz);
+  }
+  for (; i < n; i++) {
+    const void *val = src + i * memsz;
+    if (tbeats(t, val)) {
+      kept += CADT_Heap_replace_top(t->heap, val);
+    }
+  }
+  return kept;
+}
+
+
+size_t CADT_TopK_size(const CADT_TopK *t) {
+  return t == NULL ? 0 : t->heap->meta.size;
+}
+
+
+/* the worst element kept, a candidate must beat it once k are held. NULL
+ * while empty */
+void *CADT_TopK_threshold(const CADT_TopK *t) {
+  return t == NULL ? NULL : CADT_Heap_peek(t->heap);
+}
+
+
+/* move the elements kept into out, the best first, and empty t. out must
+ * have room for CADT_TopK_size elements. return how many were moved */
+size_t CADT_TopK_take(CADT_TopK *t, void *out) {
+  if (t == NULL || out == NULL) {
+    return 0;
+  }
+  CADT_Heap *h = t->heap;
+  const size_t memsz = h->meta.memsz;
+  unsigned char *dst = (unsigned char *)out;
+  /* the heap pops the worst first, so fill out from its end */
+  const size_t size = h->meta.size;
+  for (size_t n = size; n-- > 0;) {
+    CADT_Heap_pop_into(h, dst + n * memsz, 1);
+  }
+  return size;
+}
+
+
+void CADT_TopK_free(CADT_TopK *t) {
+  if (t == NULL) {
+    return;
+  }
+  const CADT_Allocator a = t->heap->alloc;
+  CADT_Heap_free(t->heap);
+  CADT_free_(&a, t);
+}
@@ -0,0 +1,155 @@
+#ifndef _CADT_TVECTOR
+#define _CADT_TVECTOR
+
+/* type specialized vectors. CADT_VEC_DEFINE(T, Name) emits a Name struct
+ * and inline Name_* functions over elements of type T. element size is
+ * known at compile time, so a push is a capacity check and a store and
+ * loops over the buffer can be vectorized. growth follows the same policy
+ * as CADT_Vec.
+ *
+ *   CADT_VEC_DEFINE(int, IntVec)
+ *   IntVec v;
+ *   IntVec_init(&v, 0);
+ *   IntVec_push(&v, 42);
+ *   IntVec_free(&v);
+ */
+
+#include "cadt.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* buffer length over element count after growing */
+#define CADT_VEC_GROWTH 1.65
+/* the buffer shrinks once it is this many times longer than needed. it
+ * is well above CADT_VEC_GROWTH so a shrunk buffer is far from growing
+ * again. */
+#define CADT_VEC_SHRINK_RATIO 4
+/* buffers below this many bytes are never shrunk */
+#define CADT_VEC_SHRINK_MIN_BYTES (1024 * 32)
+
+
+/* buffer length for size elements */
+static inline size_t CADT_vec_growlen_(const size_t size) {
+  const size_t len = (size_t)(size * CADT_VEC_GROWTH);
+  return len > size ? len : size + 1;
+}
+
+
+static inline bool CADT_vec_shouldshrink_(const size_t len, const size_t size,
+                                          const size_t memsz) {
+  return size > 0 && len / size >= CADT_VEC_SHRINK_RATIO &&
+         len * memsz >= CADT_VEC_SHRINK_MIN_BYTES;
+}
+
+
+#define CADT_VEC_DEFINE(T, Name)                                               \
+  typedef struct Name {                                                        \
+    T *buf;                                                                    \
+    size_t size;                                                               \
+    size_t len;                                                                \
+  } Name;                                                                      \
+                                                                               \
+  static inline bool Name##_resize_(Name *v, const size_t len) {               \
+    T *buf = (T *)realloc(v->buf, (len ? len : 1) * sizeof(T));                \
+    if (buf == NULL) {                                                         \
+      return false;                                                            \
+    }                                                                          \
+    v->buf = buf;                                                              \
+    v->len = len;                                                              \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline bool Name##_init(Name *v, const size_t cap) {                  \
+    v->buf = NULL;                                                             \
+    v->size = 0;                                                               \
+    v->len = 0;                                                                \
+    return cap == 0 || Name##_resize_(v, cap);                                 \
+  }                                                                            \
+                                                                               \
+  static inline void Name##_free(Name *v) {                                    \
+    free(v->buf);                                                              \
+    v->buf = NULL;                                                             \
+    v->size = 0;                                                               \
+    v->len = 0;                                                                \
+  }                                                                            \
+                                                                               \
+  static inline size_t Name##_size(const Name *v) { return v->size; }          \
+                                                                               \
+  static inline void Name##_clear(Name *v) { v->size = 0; }                    \
+                                                                               \
+  /* make room for n elements in total */                                      \
+  static inline bool Name##_reserve(Name *v, const size_t n) {                 \
+    return n <= v->len || Name##_resize_(v, n);                                \
+  }                                                                            \
+                                                                               \
+  static inline bool Name##_push(Name *v, const T val) {                       \
+    if (v->size == v->len &&                                                   \
+        !Name##_resize_(v, CADT_vec_growlen_(v->size + 1))) {                  \
+      return false;                                                            \
+    }                                                                          \
+    v->buf[v->size++] = val;                                                   \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline bool Name##_pop(Name *v, T *out) {                             \
+    if (v->size == 0) {                                                        \
+      return false;                                                            \
+    }                                                                          \
+    *out = v->buf[--v->size];                                                  \
+    if (CADT_vec_shouldshrink_(v->len, v->size, sizeof(T))) {                  \
+      Name##_resize_(v, CADT_vec_growlen_(v->size));                           \
+    }                                                                          \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  /* n elements in one resize */                                             \
+  static inline bool Name##_append_n(Name *v, const T *vals, const size_t n) { \
+    if (v->size + n > v->len) {                                                \
+      const size_t len = CADT_vec_growlen_(v->len);                            \
+      if (!Name##_resize_(v, len > v->size + n ? len : v->size + n)) {         \
+        return false;                                                          \
+      }                                                                        \
+    }                                                                          \
+    memcpy(v->buf + v->size, vals, n * sizeof(T));                             \
+    v->size += n;                                                              \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline bool Name##_insert(Name *v, const size_t idx, const T val) {   \
+    if (idx > v->size) {                                                       \
+      return false;                                                            \
+    }                                                                          \
+    if (v->size == v->len &&                                                   \
+        !Name##_resize_(v, CADT_vec_growlen_(v->size + 1))) {                  \
+      return false;                                                            \
+    }                                                                          \
+    memmove(v->buf + idx + 1, v->buf + idx, (v->size - idx) * sizeof(T));      \
+    v->buf[idx] = val;                                                         \
+    v->size++;                                                                 \
+    return true;                                                               \
+  }                                                                            \
+                                                                               \
+  static inline T Name##_get(const Name *v, const size_t idx) {                \
+    assert(idx < v->size);                                                     \
+    return v->buf[idx];                                                        \
+  }                                                                            \
+                                                                               \
+  static inline void Name##_set(Name *v, const size_t idx, const T val) {      \
+    assert(idx < v->size);                                                     \
+    v->buf[idx] = val;                                                         \
+  }                                                                            \
+                                                                               \
+  /* borrowed, valid until the next call that changes the size of v */        \
+  static inline T *Name##_at(Name *v, const size_t idx) {                      \
+    return idx < v->size ? v->buf + idx : NULL;                                \
+  }                                                                            \
+                                                                               \
+  static inline CADT_VecSpan Name##_span(Name *v) {                            \
+    CADT_VecSpan s = {v->buf, v->size, sizeof(T)};                             \
+    return s;                                                                  \
+  }
+
+#endif /* ifndef _CADT_TVECTOR */
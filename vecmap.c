@@ -0,0 +1,208 @@
+/* mapped storage for very large CADT_Vecs. the vector reserves address
+ * space for its maximum size once and commits pages as it grows, so the
+ * buffer never moves and growing never copies it. huge pages can be asked
+ * for, and a file can back the vector so its elements outlive the
+ * process.
+ *
+ * a file backed vector keeps its committed pages in the file while open.
+ * the size is not stored anywhere but in the length of the file, which
+ * CADT_Vec_sync and free set to exactly size * memsz bytes. sync is the
+ * durability point: after a crash the file reopens as of the last sync,
+ * or at its page rounded committed length if it was grown since. */
+
+#define _GNU_SOURCE
+#include "vector.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* huge page size assumed for alignment, the common one on x86 and arm */
+#define VEC_HUGE_PAGE (2u * 1024 * 1024)
+
+
+static size_t mround(const size_t n, const size_t page) {
+  return (n + page - 1) / page * page;
+}
+
+
+/* anonymous memory is reserved PROT_NONE and made accessible page by
+ * page, so untouched address space costs nothing */
+static bool mcommit_anon(CADT_Vec *v, const size_t nbyte) {
+  const size_t want = mround(nbyte, v->map->page);
+  if (want <= v->map->committed) {
+    return true;
+  }
+  unsigned char *p = (unsigned char *)v->map->addr + v->map->committed;
+  if (mprotect(p, want - v->map->committed, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+  v->map->committed = want;
+  return true;
+}
+
+
+/* the whole reserved range of a file is mapped, pages past the end of the
+ * file become usable once the file is extended over them */
+static bool mcommit_file(CADT_Vec *v, const size_t nbyte) {
+  const size_t want = mround(nbyte, v->map->page);
+  if (want <= v->map->committed) {
+    return true;
+  }
+  if (ftruncate(v->map->fd, (off_t)want) != 0) {
+    return false;
+  }
+  v->map->committed = want;
+  return true;
+}
+
+
+static void mrelease(CADT_Vec *v) {
+  munmap(v->map->addr, v->map->reserved);
+  if (v->map->fd >= 0) {
+    /* if this fails the file keeps its committed length and can not be
+     * reopened, there is nobody to report it to */
+    const int rc = ftruncate(v->map->fd, (off_t)(v->meta.size * v->meta.memsz));
+    (void)rc;
+    close(v->map->fd);
+  }
+  CADT_free_(v->alloc, v->map);
+  v->map = NULL;
+}
+
+
+/* reserve nbyte of address space, backed by fd if it is not -1 */
+static void *mreserve(const size_t nbyte, const int fd, const unsigned flags) {
+  void *p = MAP_FAILED;
+  if (fd >= 0) {
+    return mmap(NULL, nbyte, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+#if defined(MAP_HUGETLB)
+  /* without MAP_NORESERVE the huge pages are set aside now, so running
+   * short of them fails here instead of faulting later */
+  if (flags & CADT_VEC_MAP_HUGETLB) {
+    p = mmap(NULL, nbyte, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+             -1, 0);
+  }
+#endif
+  if (p == MAP_FAILED) {
+    p = mmap(NULL, nbyte, PROT_NONE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+  return p;
+}
+
+
+static CADT_Vec *mvecnew(const size_t memsz, const size_t maxsize,
+                         const unsigned flags, const int fd) {
+  if (memsz == 0 || maxsize == 0 || maxsize > SIZE_MAX / memsz) {
+    return NULL;
+  }
+  const bool huge = flags & (CADT_VEC_MAP_HUGETLB | CADT_VEC_MAP_THP);
+  const size_t page = huge ? VEC_HUGE_PAGE : (size_t)sysconf(_SC_PAGESIZE);
+  if (maxsize * memsz > SIZE_MAX - page) {
+    return NULL;
+  }
+  const size_t reserved = mround(maxsize * memsz, page);
+
+  CADT_Vec *v = CADT_Vec_new_inline(0, memsz, 0, NULL);
+  if (v == NULL) {
+    return NULL;
+  }
+  struct VecMap_ *m = (struct VecMap_ *)CADT_alloc_(v->alloc, sizeof(*m));
+  if (m == NULL) {
+    CADT_Vec_free(v);
+    return NULL;
+  }
+  void *addr = mreserve(reserved, fd, flags);
+  if (addr == MAP_FAILED) {
+    CADT_free_(v->alloc, m);
+    CADT_Vec_free(v);
+    return NULL;
+  }
+#if defined(MADV_HUGEPAGE)
+  if (flags & CADT_VEC_MAP_THP) {
+    madvise(addr, reserved, MADV_HUGEPAGE);
+  }
+#endif
+  m->addr = addr;
+  m->reserved = reserved;
+  m->committed = 0;
+  m->page = page;
+  m->fd = fd;
+  m->commit = fd >= 0 ? mcommit_file : mcommit_anon;
+  m->release = mrelease;
+  v->buf = addr;
+  v->map = m;
+  return v;
+}
+
+
+/*-- interface --*/
+
+/* a vector of up to maxsize elements in anonymous memory. flags are
+ * CADT_VEC_MAP_HUGETLB for explicit huge pages, falling back to normal
+ * pages when none are available, and CADT_VEC_MAP_THP to ask for
+ * transparent huge pages. */
+CADT_Vec *CADT_Vec_new_mapped(const size_t memsz, const size_t maxsize,
+                              const unsigned flags) {
+  return mvecnew(memsz, maxsize, flags, -1);
+}
+
+
+/* a vector of up to maxsize elements stored in the file at path, created
+ * if missing. an existing file holds the elements of a vector freed
+ * earlier and must be a whole number of elements long. */
+CADT_Vec *CADT_Vec_open_file(const char *path, const size_t memsz,
+                             const size_t maxsize, const unsigned flags) {
+  if (path == NULL || memsz == 0) {
+    return NULL;
+  }
+  const int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size % memsz != 0 ||
+      (size_t)st.st_size / memsz > maxsize) {
+    close(fd);
+    return NULL;
+  }
+  CADT_Vec *v = mvecnew(memsz, maxsize, flags & ~CADT_VEC_MAP_HUGETLB, fd);
+  if (v == NULL) {
+    close(fd);
+    return NULL;
+  }
+  /* size first, freeing v truncates the file to it */
+  const size_t size = (size_t)st.st_size / memsz;
+  v->meta.size = size;
+  if (!v->map->commit(v, size * memsz)) {
+    CADT_Vec_free(v);
+    return NULL;
+  }
+  v->meta.len = size;
+  return v;
+}
+
+
+/* write the elements of a file backed vector to disk and cut the file to
+ * its size, so a reopen finds exactly these elements even if v is never
+ * freed. the pages past the size are given back and committed again as v
+ * grows. */
+bool CADT_Vec_sync(CADT_Vec *v) {
+  if (v == NULL || v->map == NULL || v->map->fd < 0) {
+    return false;
+  }
+  const size_t nbyte = v->meta.size * v->meta.memsz;
+  if (ftruncate(v->map->fd, (off_t)nbyte) != 0) {
+    return false;
+  }
+  /* the mapping ends with the file now, the next growth extends both */
+  v->map->committed = nbyte;
+  v->meta.len = v->meta.size;
+  return msync(v->map->addr, nbyte, MS_SYNC) == 0 && fdatasync(v->map->fd) == 0;
+}
+
+#undef VEC_HUGE_PAGE
@@ -0,0 +1,214 @@
+/* search kernels for CADT_Vec. elements of 1, 2, 4, 8 or 16 bytes are
+ * compared a whole register at a time: the bytes of a block are compared
+ * against the value repeated across the register, and an element matches
+ * when all of its bytes do. AVX2 is used when the CPU has it, SSE2
+ * otherwise, and other element sizes go through memcmp, as does every
+ * size on targets without either or when CADT_VEC_NO_SIMD is defined. */
+
+#include "vector.h"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && !defined(CADT_VEC_NO_SIMD)
+#include <emmintrin.h>
+#define VEC_HAS_SSE2 1
+#else
+#define VEC_HAS_SSE2 0
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    !defined(CADT_VEC_NO_SIMD)
+#include <immintrin.h>
+#define VEC_HAS_AVX2 1
+#else
+#define VEC_HAS_AVX2 0
+#endif
+
+/* widest block compared at once, in bytes */
+#define VEC_MAX_BLOCK 32
+
+
+/* state of one scan. a scan records the index of each match in out while
+ * there is room and stops at the first match if first is set. */
+typedef struct Scan_ {
+  const unsigned char *buf;
+  size_t n; /* elements */
+  size_t w; /* bytes per element */
+  const unsigned char *val;
+  size_t *out;
+  size_t cap;
+  bool first;
+  size_t found;
+} Scan_;
+
+
+/* record a match, false once the scan should stop */
+static bool smatch(Scan_ *const s, const size_t idx) {
+  if (s->found < s->cap) {
+    s->out[s->found] = idx;
+  }
+  s->found++;
+  return !s->first;
+}
+
+
+static bool swidth_ok(const size_t w) {
+  return w == 1 || w == 2 || w == 4 || w == 8 || w == 16;
+}
+
+
+/* elements from start on, one memcmp each */
+static void sscalar(Scan_ *const s, const size_t start) {
+  for (size_t i = start; i < s->n; i++) {
+    if (!memcmp(s->buf + i * s->w, s->val, s->w) && !smatch(s, i)) {
+      return;
+    }
+  }
+}
+
+
+#if VEC_HAS_SSE2 || VEC_HAS_AVX2
+/* keep one bit per element of w bytes in a byte mask, set only if every
+ * byte of the element matched */
+static uint32_t mreduce(uint32_t m, const size_t w) {
+  static const uint32_t lanes[17] = {
+      [1] = 0xffffffffu, [2] = 0x55555555u, [4] = 0x11111111u,
+      [8] = 0x01010101u, [16] = 0x00010001u};
+  for (size_t sh = 1; sh < w; sh *= 2) {
+    m &= m >> sh;
+  }
+  return m & lanes[w];
+}
+
+
+/* report the matches of byte mask m for the block at element base */
+static bool sblock(Scan_ *const s, uint32_t m, const size_t base) {
+  for (m = mreduce(m, s->w); m; m &= m - 1) {
+    if (!smatch(s, base + (size_t)__builtin_ctz(m) / s->w)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* the value repeated over a block of VEC_MAX_BLOCK bytes */
+static void sneedle(const Scan_ *const s, unsigned char *const needle) {
+  for (size_t i = 0; i < VEC_MAX_BLOCK; i += s->w) {
+    memcpy(needle + i, s->val, s->w);
+  }
+}
+#endif
+
+
+#if VEC_HAS_SSE2
+static void ssse2(Scan_ *const s) {
+  unsigned char needle[VEC_MAX_BLOCK];
+  sneedle(s, needle);
+  const __m128i v = _mm_loadu_si128((const __m128i *)(void *)needle);
+  const size_t per = 16 / s->w;
+  size_t i = 0;
+  for (; i + per <= s->n; i += per) {
+    const __m128i b =
+        _mm_loadu_si128((const __m128i *)(const void *)(s->buf + i * s->w));
+    const uint32_t m = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(b, v));
+    if (m && !sblock(s, m, i)) {
+      return;
+    }
+  }
+  sscalar(s, i);
+}
+#endif
+
+
+#if VEC_HAS_AVX2
+__attribute__((target("avx2"))) static void savx2(Scan_ *const s) {
+  unsigned char needle[VEC_MAX_BLOCK];
+  sneedle(s, needle);
+  const __m256i v = _mm256_loadu_si256((const __m256i *)(void *)needle);
+  const size_t per = 32 / s->w;
+  size_t i = 0;
+  for (; i + per <= s->n; i += per) {
+    const __m256i b = _mm256_loadu_si256(
+        (const __m256i *)(const void *)(s->buf + i * s->w));
+    const uint32_t m = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(b, v));
+    if (m && !sblock(s, m, i)) {
+      return;
+    }
+  }
+  sscalar(s, i);
+}
+#endif
+
+
+static size_t sdispatch(const CADT_Vec *const v, const void *const val,
+                        size_t *const out, const size_t cap, const bool first) {
+  Scan_ s = {.buf = (const unsigned char *)v->buf,
+             .n = v->meta.size,
+             .w = v->meta.memsz,
+             .val = (const unsigned char *)val,
+             .out = out,
+             .cap = cap,
+             .first = first,
+             .found = 0};
+  if (s.w == 0 || s.n == 0) {
+    return 0;
+  }
+  if (!swidth_ok(s.w)) {
+    sscalar(&s, 0);
+    return s.found;
+  }
+#if VEC_HAS_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    savx2(&s);
+    return s.found;
+  }
+#endif
+#if VEC_HAS_SSE2
+  ssse2(&s);
+#else
+  sscalar(&s, 0);
+#endif
+  return s.found;
+}
+
+
+/*-- interface --*/
+
+/* index of the first element equal to val, CADT_VEC_NOTFOUND if none */
+size_t CADT_Vec_find(CADT_Vec *v, const void *val) {
+  size_t idx = CADT_VEC_NOTFOUND;
+  if (v == NULL || val == NULL) {
+    return idx;
+  }
+  sdispatch(v, val, &idx, 1, true);
+  return idx;
+}
+
+
+bool CADT_Vec_contains(CADT_Vec *v, const void *const val) {
+  return CADT_Vec_find(v, val) != CADT_VEC_NOTFOUND;
+}
+
+
+size_t CADT_Vec_count(CADT_Vec *v, const void *val) {
+  if (v == NULL || val == NULL) {
+    return 0;
+  }
+  return sdispatch(v, val, NULL, 0, false);
+}
+
+
+/* write the indices of up to cap elements equal to val into idx, in
+ * order. it returns the number of matches, which is more than cap if
+ * some did not fit. */
+size_t CADT_Vec_find_all(CADT_Vec *v, const void *val, size_t *idx,
+                         const size_t cap) {
+  if (v == NULL || val == NULL || (idx == NULL && cap > 0)) {
+    return 0;
+  }
+  return sdispatch(v, val, idx, cap, false);
+}
+
+#undef VEC_HAS_SSE2
+#undef VEC_HAS_AVX2
+#undef VEC_MAX_BLOCK
@@ -0,0 +1,478 @@
+/* sorting and ordered lookup for CADT_Vec.
+ * CADT_Vec_sort is an introsort: quicksort with a median of three pivot,
+ * insertion sort on short ranges and heapsort once the recursion gets
+ * too deep, so it is O(n log n) in the worst case. elements are swapped
+ * with a routine picked once per sort for the element size.
+ * CADT_Vec_nth_element and CADT_Vec_partial_sort reuse its partition
+ * step as a quickselect.
+ * CADT_Vec_radix_sort is a LSD radix sort for integer and floating point
+ * keys. */
+
+#include "vector.h"
+#include <stdint.h>
+#include <string.h>
+
+/* ranges this short are insertion sorted */
+#define SORT_SMALL 16
+/* radix digit width in bits. 11 bits sorts a 64 bit key in 6 passes and
+ * keeps the counts of a pass within L1. */
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1u << RADIX_BITS)
+
+typedef int (*Cmp_)(const void *, const void *);
+
+typedef struct Sort_ {
+  unsigned char *buf;
+  size_t w; /* bytes per element */
+  Cmp_ cmp;
+  void (*swap)(void *, void *, size_t);
+} Sort_;
+
+
+/*-- element swaps --*/
+
+static void swap4(void *a, void *b, size_t w) {
+  uint32_t t;
+  (void)w;
+  memcpy(&t, a, 4);
+  memcpy(a, b, 4);
+  memcpy(b, &t, 4);
+}
+
+
+static void swap8(void *a, void *b, size_t w) {
+  uint64_t t;
+  (void)w;
+  memcpy(&t, a, 8);
+  memcpy(a, b, 8);
+  memcpy(b, &t, 8);
+}
+
+
+static void swap16(void *a, void *b, size_t w) {
+  uint64_t t[2];
+  (void)w;
+  memcpy(t, a, 16);
+  memcpy(a, b, 16);
+  memcpy(b, t, 16);
+}
+
+
+static void swapn(void *a, void *b, size_t w) {
+  unsigned char t[64];
+  unsigned char *p = (unsigned char *)a;
+  unsigned char *q = (unsigned char *)b;
+  while (w > 0) {
+    const size_t n = w < sizeof(t) ? w : sizeof(t);
+    memcpy(t, p, n);
+    memcpy(p, q, n);
+    memcpy(q, t, n);
+    p += n;
+    q += n;
+    w -= n;
+  }
+}
+
+
+/*-- introsort --*/
+
+static unsigned char *sat(const Sort_ *const s, const size_t i) {
+  return s->buf + i * s->w;
+}
+
+
+static void sswap(const Sort_ *const s, const size_t i, const size_t j) {
+  s->swap(sat(s, i), sat(s, j), s->w);
+}
+
+
+static int scmp(const Sort_ *const s, const size_t i, const size_t j) {
+  return s->cmp(sat(s, i), sat(s, j));
+}
+
+
+/* [lo, hi) */
+static void sinsertion(const Sort_ *const s, const size_t lo,
+                       const size_t hi) {
+  for (size_t i = lo + 1; i < hi; i++) {
+    for (size_t j = i; j > lo && scmp(s, j - 1, j) > 0; j--) {
+      sswap(s, j - 1, j);
+    }
+  }
+}
+
+
+/* sift element i of the heap of n elements starting at lo */
+static void ssift(const Sort_ *const s, const size_t lo, size_t i,
+                  const size_t n) {
+  for (size_t c; (c = 2 * i + 1) < n; i = c) {
+    if (c + 1 < n && scmp(s, lo + c, lo + c + 1) < 0) {
+      c++;
+    }
+    if (scmp(s, lo + i, lo + c) >= 0) {
+      return;
+    }
+    sswap(s, lo + i, lo + c);
+  }
+}
+
+
+static void sheap(const Sort_ *const s, const size_t lo, const size_t hi) {
+  const size_t n = hi - lo;
+  for (size_t i = n / 2; i-- > 0;) {
+    ssift(s, lo, i, n);
+  }
+  for (size_t end = n; end-- > 1;) {
+    sswap(s, lo, lo + end);
+    ssift(s, lo, 0, end);
+  }
+}
+
+
+/* move the median of the first, middle and last element to lo and
+ * partition around it. elements equal to the pivot stop both scans, so
+ * many equal keys still split the range evenly. */
+static size_t spartition(const Sort_ *const s, const size_t lo,
+                         const size_t hi) {
+  const size_t mid = lo + (hi - lo) / 2;
+  if (scmp(s, mid, lo) < 0) {
+    sswap(s, mid, lo);
+  }
+  if (scmp(s, hi - 1, lo) < 0) {
+    sswap(s, hi - 1, lo);
+  }
+  if (scmp(s, hi - 1, mid) < 0) {
+    sswap(s, hi - 1, mid);
+  }
+  sswap(s, lo, mid);
+
+  size_t i = lo;
+  size_t j = hi;
+  for (;;) {
+    do {
+      i++;
+    } while (i < hi && scmp(s, i, lo) < 0);
+    do {
+      j--;
+    } while (scmp(s, j, lo) > 0);
+    if (i >= j) {
+      break;
+    }
+    sswap(s, i, j);
+  }
+  sswap(s, lo, j);
+  return j;
+}
+
+
+/* recurse into the smaller side and loop on the larger one so the stack
+ * stays O(log n) */
+static void sintro(const Sort_ *const s, size_t lo, size_t hi, size_t depth) {
+  while (hi - lo > SORT_SMALL) {
+    if (depth-- == 0) {
+      sheap(s, lo, hi);
+      return;
+    }
+    const size_t p = spartition(s, lo, hi);
+    if (p - lo < hi - p) {
+      sintro(s, lo, p, depth);
+      lo = p + 1;
+    } else {
+      sintro(s, p + 1, hi, depth);
+      hi = p;
+    }
+  }
+  sinsertion(s, lo, hi);
+}
+
+
+/*-- radix sort --*/
+
+/* the key of an element as an unsigned integer with the same order */
+static uint64_t rkey(const unsigned char *const p, const size_t w,
+                     const CADTKeyType type) {
+  uint64_t k = 0;
+  switch (w) {
+    case 1: {
+      uint8_t x;
+      memcpy(&x, p, 1);
+      k = x;
+      break;
+    }
+    case 2: {
+      uint16_t x;
+      memcpy(&x, p, 2);
+      k = x;
+      break;
+    }
+    case 4: {
+      uint32_t x;
+      memcpy(&x, p, 4);
+      k = x;
+      break;
+    }
+    default: {
+      memcpy(&k, p, 8);
+      break;
+    }
+  }
+  const uint64_t sign = (uint64_t)1 << (w * 8 - 1);
+  switch (type) {
+    case CADT_KEY_INT:
+      return k ^ sign;
+    case CADT_KEY_FLOAT:
+      /* negative floats sort in reverse, flip all their bits */
+      return k & sign ? ~k & (sign | (sign - 1)) : k | sign;
+    default:
+      return k;
+  }
+}
+
+
+static bool rtype_ok(const size_t w, const CADTKeyType type) {
+  if (type == CADT_KEY_FLOAT) {
+    return w == sizeof(float) || w == sizeof(double);
+  }
+  return w == 1 || w == 2 || w == 4 || w == 8;
+}
+
+
+/*-- interface --*/
+
+static Sort_ sorter(CADT_Vec *v, const Cmp_ cmp) {
+  Sort_ s = {.buf = (unsigned char *)v->buf, .w = v->meta.memsz, .cmp = cmp};
+  switch (s.w) {
+    case 4:
+      s.swap = swap4;
+      break;
+    case 8:
+      s.swap = swap8;
+      break;
+    case 16:
+      s.swap = swap16;
+      break;
+    default:
+      s.swap = swapn;
+      break;
+  }
+  return s;
+}
+
+
+/* recursion depth allowed before falling back to heapsort */
+static size_t sdepth(const size_t n) {
+  size_t depth = 0;
+  for (size_t k = n; k > 1; k >>= 1) {
+    depth += 2;
+  }
+  return depth;
+}
+
+
+void CADT_Vec_sort(CADT_Vec *v, int (*cmp)(const void *, const void *)) {
+  if (v == NULL || cmp == NULL || v->meta.size < 2) {
+    return;
+  }
+  const Sort_ s = sorter(v, cmp);
+  sintro(&s, 0, v->meta.size, sdepth(v->meta.size));
+}
+
+
+/* put the element that sorts to index n there, with no greater element
+ * before it and no smaller one after it. quickselect, falling back to
+ * heapsort of what is left when the partitions keep coming out uneven,
+ * so it is O(n) on average and O(n log n) at worst. */
+void CADT_Vec_nth_element(CADT_Vec *v, const size_t n,
+                          int (*cmp)(const void *, const void *)) {
+  if (v == NULL || cmp == NULL || n >= v->meta.size) {
+    return;
+  }
+  const Sort_ s = sorter(v, cmp);
+  size_t lo = 0;
+  size_t hi = v->meta.size;
+  size_t depth = sdepth(hi);
+  while (hi - lo > SORT_SMALL) {
+    if (depth-- == 0) {
+      sheap(&s, lo, hi);
+      return;
+    }
+    const size_t p = spartition(&s, lo, hi);
+    if (p == n) {
+      return;
+    }
+    if (n < p) {
+      hi = p;
+    } else {
+      lo = p + 1;
+    }
+  }
+  sinsertion(&s, lo, hi);
+}
+
+
+/* sort the k smallest elements into the first k places, the order of the
+ * rest is unspecified. O(n + k log k) on average. */
+void CADT_Vec_partial_sort(CADT_Vec *v, const size_t k,
+                           int (*cmp)(const void *, const void *)) {
+  if (v == NULL || cmp == NULL || k == 0) {
+    return;
+  }
+  if (k >= v->meta.size) {
+    CADT_Vec_sort(v, cmp);
+    return;
+  }
+  CADT_Vec_nth_element(v, k - 1, cmp);
+  const Sort_ s = sorter(v, cmp);
+  sintro(&s, 0, k - 1, sdepth(k - 1));
+}
+
+
+/* sort n keys of w bytes from buf, tmp is scratch of the same size. it is
+ * called with a constant w so each key width gets its own copy of the
+ * loops. */
+static inline void rsort(unsigned char *const buf, unsigned char *const tmp,
+                         const size_t n, const size_t w,
+                         const CADTKeyType type,
+                         size_t (*const counts)[RADIX_BUCKETS]) {
+  const size_t digits = (w * 8 + RADIX_BITS - 1) / RADIX_BITS;
+  /* one pass for the histograms of every digit */
+  for (size_t i = 0; i < n; i++) {
+    const uint64_t k = rkey(buf + i * w, w, type);
+    for (size_t d = 0; d < digits; d++) {
+      counts[d][(k >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  unsigned char *src = buf;
+  unsigned char *dst = tmp;
+  for (size_t d = 0; d < digits; d++) {
+    const uint64_t first = rkey(src, w, type) >> (d * RADIX_BITS);
+    if (counts[d][first & (RADIX_BUCKETS - 1)] == n) {
+      continue;
+    }
+    size_t sum = 0;
+    for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+      const size_t c = counts[d][b];
+      counts[d][b] = sum;
+      sum += c;
+    }
+    for (size_t i = 0; i < n; i++) {
+      const uint64_t k = rkey(src + i * w, w, type);
+      const size_t b = (k >> (d * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+      memcpy(dst + counts[d][b]++ * w, src + i * w, w);
+    }
+    unsigned char *t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != buf) {
+    memcpy(buf, src, n * w);
+  }
+}
+
+
+/* each element is one key of memsz bytes: 1, 2, 4 or 8 for integers,
+ * sizeof(float) or sizeof(double) for floats. the sort is stable and
+ * needs a scratch buffer as large as the vector. digits that are equal
+ * for every key are skipped. NaNs sort after everything else, or before
+ * everything if their sign bit is set. */
+bool CADT_Vec_radix_sort(CADT_Vec *v, const CADTKeyType type) {
+  if (v == NULL || !rtype_ok(v->meta.memsz, type)) {
+    return false;
+  }
+  const size_t n = v->meta.size;
+  const size_t w = v->meta.memsz;
+  if (n < 2) {
+    return true;
+  }
+  unsigned char *tmp = (unsigned char *)malloc(n * w);
+  if (tmp == NULL) {
+    return false;
+  }
+  size_t(*counts)[RADIX_BUCKETS] =
+      (size_t(*)[RADIX_BUCKETS])calloc((w * 8 + RADIX_BITS - 1) / RADIX_BITS,
+                                        sizeof(*counts));
+  if (counts == NULL) {
+    free(tmp);
+    return false;
+  }
+
+  unsigned char *buf = (unsigned char *)v->buf;
+  switch (w) {
+    case 1:
+      rsort(buf, tmp, n, 1, type, counts);
+      break;
+    case 2:
+      rsort(buf, tmp, n, 2, type, counts);
+      break;
+    case 4:
+      rsort(buf, tmp, n, 4, type, counts);
+      break;
+    default:
+      rsort(buf, tmp, n, 8, type, counts);
+      break;
+  }
+  free(counts);
+  free(tmp);
+  return true;
+}
+
+
+/* first index in [lo, hi) whose element is greater than val, or not less
+ * than val if !upper */
+static size_t vbound(const CADT_Vec *const v, size_t lo, const size_t hi,
+                     const void *const val, const Cmp_ cmp, const bool upper) {
+  size_t n = hi - lo;
+  while (n > 0) {
+    const size_t half = n / 2;
+    const void *mid = (unsigned char *)v->buf + (lo + half) * v->meta.memsz;
+    if (upper ? cmp(val, mid) >= 0 : cmp(mid, val) < 0) {
+      lo += half + 1;
+      n -= half + 1;
+    } else {
+      n = half;
+    }
+  }
+  return lo;
+}
+
+
+/* the binary searches expect v sorted by cmp. without a vector or cmp
+ * the range is empty and starts at 0. */
+
+size_t CADT_Vec_lower_bound(CADT_Vec *v, const void *val,
+                            int (*cmp)(const void *, const void *)) {
+  if (v == NULL || cmp == NULL) {
+    return 0;
+  }
+  return vbound(v, 0, v->meta.size, val, cmp, false);
+}
+
+
+size_t CADT_Vec_upper_bound(CADT_Vec *v, const void *val,
+                            int (*cmp)(const void *, const void *)) {
+  if (v == NULL || cmp == NULL) {
+    return 0;
+  }
+  return vbound(v, 0, v->meta.size, val, cmp, true);
+}
+
+
+/* the elements equal to val are [*lo, *hi) */
+void CADT_Vec_equal_range(CADT_Vec *v, const void *val,
+                          int (*cmp)(const void *, const void *), size_t *lo,
+                          size_t *hi) {
+  if (lo == NULL || hi == NULL) {
+    return;
+  }
+  if (v == NULL || cmp == NULL) {
+    *lo = *hi = 0;
+    return;
+  }
+  *lo = vbound(v, 0, v->meta.size, val, cmp, false);
+  *hi = vbound(v, *lo, v->meta.size, val, cmp, true);
+}
+
+#undef SORT_SMALL
+#undef RADIX_BITS
+#undef RADIX_BUCKETS
@@ -4,117 +4,122 @@
 #include <stdio.h>
 #include <string.h>
 
-static int vecupdate(CADT_Vec *v, const CADT_Vec u) {
-  if (v->meta.memsz != u.meta.memsz) {
-    return -1;
-  }
-  if (u.meta.size > u.meta.len) {
-    return -1;
-  }
-  *v = u;
-  return 1;
-}
-
-
 /*-- manage vector buffer --*/
 
-static CADT_Vec *vecalloc(const size_t size, const size_t memsz) {
-  CADT_Vec *v = (CADT_Vec *)malloc(sizeof(CADT_Vec));
-  if (v == NULL) {
-    return NULL;
-  }
-  const size_t len = size * SZ_LEN_RATIO;
-  CADT_Vec u = {
-      .meta =
-          {
-              .len = len,
-              .size = size,
-              .memsz = memsz,
-
-          },
-      .buf = NULL,
-  };
-
-  if (!vecupdate(v, u)) {
-    return NULL;
-  }
-
-  v->meta.len = size * SZ_LEN_RATIO;
-  v->meta.size = size;
-  v->meta.memsz = memsz;
-  v->buf = malloc(memsz * v->meta.len);
-  return v;
-}
+/* the first inline elements come with the same miss as meta and buf */
+_Static_assert(offsetof(CADT_Vec, inl) + sizeof(void *) <= CADT_CACHELINE,
+               "CADT_Vec inline storage starts past the first cache line");
 
-static size_t vmemspace(CADT_Vec *v) { return v->meta.len * v->meta.memsz; }
 
-
-static int vbuf_shouldshrink(CADT_Vec *v) {
-  return (v->meta.len / v->meta.size) >= SHRINK_THRESHOLD;
+static bool vinline(const CADT_Vec *v) {
+  return v->buf == (const void *)v->inl;
 }
 
 
-static int vbuf_shouldbulk(CADT_Vec *v) { return v->meta.len <= v->meta.size; }
-
-
-static size_t vbuf_shrink(CADT_Vec *v, const size_t delta) {
-  /* clean all content if buflen <= delta. */
-  if (v->meta.len <= delta) {
-    v->meta.len = 0;
-    v->meta.size = 0;
-    free(v->buf);
-    return 0;
+/* set the buffer length to len elements. a vector stays in its inline
+ * storage as long as len fits, then spills to the heap for good. */
+static bool vbuf_realloc(CADT_Vec *v, const size_t len) {
+  if (v->meta.memsz != 0 && len > SIZE_MAX / v->meta.memsz) {
+    return false;
   }
-  /* if memory usage is small there is no need to resize
-   * set 32kB as the threshold. It can hold 4096 doubles and
-   * fit in most of the L1 cache. */
-  if (vmemspace(v) < 1024 * 32) {
-    return v->meta.len;
+  const size_t nbyte = (len ? len : 1) * v->meta.memsz;
+  if (v->map != NULL) {
+    /* the mapping can not grow past what was reserved */
+    const size_t cap = v->map->reserved / v->meta.memsz;
+    const size_t l = len < cap ? len : cap;
+    if (!v->map->commit(v, l * v->meta.memsz)) {
+      return false;
+    }
+    v->meta.len = l;
+    return true;
   }
-
-  v->meta.len -= delta;
-  if (v->meta.size <= v->meta.len) {
-    v->meta.size = v->meta.len;
+  if (vinline(v)) {
+    /* meta.len is the inline capacity until the first spill */
+    if (len <= v->meta.len || v->meta.memsz == 0) {
+      return true;
+    }
+    void *const p = CADT_alloc_(v->alloc, nbyte);
+    if (p == NULL) {
+      return false;
+    }
+    memcpy(p, v->buf, v->meta.size * v->meta.memsz);
+    v->buf = p;
+    v->meta.len = len;
+    return true;
   }
-  void *const p = realloc(v->buf, vmemspace(v));
+  void *const p = CADT_realloc_(v->alloc, v->buf, nbyte);
   if (p == NULL) {
-    return 0;
+    return false;
   }
   v->buf = p;
-  return v->meta.len;
+  v->meta.len = len;
+  return true;
 }
 
 
-static size_t vbuf_clear(CADT_Vec *v) {
-  v->meta.size = 0;
-  return 0;
+/* make room for n elements. the buffer grows by at least SZ_LEN_RATIO so
+ * any sequence of appends costs amortized O(1) per element. */
+static bool vbuf_reserve(CADT_Vec *v, const size_t n) {
+  if (n <= v->meta.len) {
+    return true;
+  }
+  const size_t len = CADT_vec_growlen_(v->meta.len);
+  return vbuf_realloc(v, len > n ? len : n) && n <= v->meta.len;
 }
 
 
-/* increase vector buffer size */
-static size_t vbuf_bulk(CADT_Vec *v, const size_t delta) {
-  v->meta.len += delta;
-  void *const p = realloc(v->buf, vmemspace(v));
-
-  if (p == NULL) {
-    return -1;
+/* give memory back once the buffer is SHRINK_THRESHOLD times longer than
+ * needed. it shrinks to SZ_LEN_RATIO times the size, well away from both
+ * limits, so alternating push and pop never reallocs on every call. */
+static void vbuf_trim(CADT_Vec *v) {
+  if (!vinline(v) && v->map == NULL &&
+      CADT_vec_shouldshrink_(v->meta.len, v->meta.size, v->meta.memsz)) {
+    vbuf_realloc(v, CADT_vec_growlen_(v->meta.size));
   }
+}
 
-  v->buf = p;
-  return v->meta.len;
+
+static size_t vbuf_clear(CADT_Vec *v) {
+  v->meta.size = 0;
+  return 0;
 }
 
 
-/* resize buf to size * SZ_LEN_RATIO */
-static size_t vbuf_resize(CADT_Vec *v) {
-  if (vbuf_shouldshrink(v)) {
-    size_t delta = v->meta.len - v->meta.size * SZ_LEN_RATIO;
-    vbuf_shrink(v, delta);
-  } else if (vbuf_shouldbulk(v)) {
-    size_t delta = v->meta.size * SZ_LEN_RATIO - v->meta.len;
-    vbuf_bulk(v, delta);
+/* the vector and inlinesz bytes of storage come in one allocation, and a
+ * copy of alloc after them unless it is the standard allocator */
+static CADT_Vec *vecalloc(const size_t size, const size_t memsz,
+                          const size_t inlinesz,
+                          const CADT_Allocator *const alloc) {
+  const CADT_Allocator a = CADT_allocator_(alloc);
+  const bool own = alloc != NULL && alloc != &CADT_std_allocator;
+  const size_t align = _Alignof(CADT_Allocator);
+  if (inlinesz > SIZE_MAX - sizeof(CADT_Vec) - align - sizeof(a)) {
+    return NULL;
   }
-  return v->meta.len;
+  const size_t tail = (inlinesz + align - 1) / align * align;
+  const size_t nbyte = sizeof(CADT_Vec) + (own ? tail + sizeof(a) : inlinesz);
+  CADT_Vec *v = (CADT_Vec *)CADT_alloc_(&a, nbyte);
+  if (v == NULL) {
+    return NULL;
+  }
+  v->meta.len = memsz ? inlinesz / memsz : 0;
+  v->meta.size = 0;
+  v->meta.memsz = memsz;
+  v->buf = v->inl;
+  if (own) {
+    CADT_Allocator *const copy = (CADT_Allocator *)(v->inl + tail);
+    *copy = a;
+    v->alloc = copy;
+  } else {
+    v->alloc = &CADT_std_allocator;
+  }
+  v->map = NULL;
+  if (size > v->meta.len && !vbuf_realloc(v, CADT_vec_growlen_(size))) {
+    CADT_free_(&a, v);
+    return NULL;
+  }
+  v->meta.size = size;
+  return v;
 }
 
 
@@ -124,12 +129,29 @@ static unsigned char *const vidx(const CADT_Vec *const v, const size_t idx) {
 
 /*-- implement vector interface --*/
 CADT_Vec *CADT_Vec_new(const size_t size, const size_t memsz) {
-  CADT_Vec *vector = vecalloc(size, memsz);
+  CADT_Vec *vector = vecalloc(size, memsz, CADT_VEC_INLINE_BYTES, NULL);
   return vector;
 }
 
+
+/* v and its buffer are allocated from alloc, NULL for the standard one */
+CADT_Vec *CADT_Vec_new_with(const size_t size, const size_t memsz,
+                            const CADT_Allocator *alloc) {
+  return vecalloc(size, memsz, CADT_VEC_INLINE_BYTES, alloc);
+}
+
+
+/* inlinesz bytes of storage live inside the vector, it only allocates a
+ * separate buffer once it outgrows them. inlinesz = size * memsz gives a
+ * vector and buffer in a single allocation. */
+CADT_Vec *CADT_Vec_new_inline(const size_t size, const size_t memsz,
+                              const size_t inlinesz,
+                              const CADT_Allocator *alloc) {
+  return vecalloc(size, memsz, inlinesz, alloc);
+}
+
 CADT_Vec *CADT_Vec_init(const size_t size, const size_t memsz, ...) {
-  CADT_Vec *vector = vecalloc(size, memsz);
+  CADT_Vec *vector = vecalloc(size, memsz, CADT_VEC_INLINE_BYTES, NULL);
   void *top = vector->buf;
   va_list args;
 
@@ -146,19 +168,16 @@ CADT_Vec *CADT_Vec_init(const size_t size, const size_t memsz, ...) {
 
 void CADT_Vec_insert(CADT_Vec *v, const size_t idx, void *val,
                      const size_t memsz) {
-  if (memsz != v->meta.memsz) {
+  if (memsz != v->meta.memsz || idx > v->meta.size) {
     perror("inserting invalid vector element");
     return;
   }
-  v->meta.size += 1;
-  vbuf_resize(v);
-  memmove(vidx(v, idx + 1), vidx(v, idx), memsz * (v->meta.size - idx + 1));
-  memcpy(vidx(v, idx), val, memsz);
+  CADT_Vec_insert_range(v, idx, val, 1);
 }
 
 
 void *const CADT_Vec_get(CADT_Vec *v, const size_t idx, const size_t memsz) {
-  if (v->meta.size <= 0 || v->meta.memsz != memsz || idx < v->meta.size) {
+  if (v->meta.memsz != memsz || idx >= v->meta.size) {
     return NULL;
   }
   /* always return a copy rather than a reference. */
@@ -169,15 +188,111 @@ void *const CADT_Vec_get(CADT_Vec *v, const size_t idx, const size_t memsz) {
 
 
 void *const CADT_Vec_pop(CADT_Vec *v, const size_t memsz) {
-  void *const val = CADT_Vec_get(v, v->meta.len, memsz);
+  if (v->meta.size == 0) {
+    return NULL;
+  }
+  void *const val = CADT_Vec_get(v, v->meta.size - 1, memsz);
   v->meta.size -= 1;
-  vbuf_resize(v);
+  vbuf_trim(v);
   return val;
 }
 
 
+/* borrowed access. the pointer points into the vector buffer and is valid
+ * until the next call that changes the size of v. */
+void *CADT_Vec_get_ref(CADT_Vec *v, const size_t idx) {
+  if (v == NULL || idx >= v->meta.size) {
+    return NULL;
+  }
+  return vidx(v, idx);
+}
+
+
+/* no bounds check in release builds, for loops that already know idx is
+ * in range. */
+void *CADT_Vec_at_unchecked(CADT_Vec *v, const size_t idx) {
+  assert(idx < v->meta.size);
+  return vidx(v, idx);
+}
+
+
+/* copy the last element into out instead of a fresh allocation */
+bool CADT_Vec_pop_into(CADT_Vec *v, void *out) {
+  if (v == NULL || out == NULL || v->meta.size == 0) {
+    return false;
+  }
+  memcpy(out, vidx(v, v->meta.size - 1), v->meta.memsz);
+  v->meta.size -= 1;
+  vbuf_trim(v);
+  return true;
+}
+
+
+/* a view of n elements from start, clamped to the end of v. it borrows
+ * the buffer the same way CADT_Vec_get_ref does. */
+CADT_VecSpan CADT_Vec_span(CADT_Vec *v, const size_t start, const size_t n) {
+  CADT_VecSpan s = {.buf = NULL, .size = 0, .memsz = 0};
+  if (v == NULL || start > v->meta.size) {
+    return s;
+  }
+  s.buf = vidx(v, start);
+  s.size = n < v->meta.size - start ? n : v->meta.size - start;
+  s.memsz = v->meta.memsz;
+  return s;
+}
+
+
 void CADT_Vec_push(CADT_Vec *v, void *val, const size_t memsz) {
-  CADT_Vec_insert(v, v->meta.len, val, memsz);
+  CADT_Vec_insert(v, v->meta.size, val, memsz);
+}
+
+
+/* insert the n elements of vals before idx with one resize and one
+ * memmove. vals must not point into v. */
+bool CADT_Vec_insert_range(CADT_Vec *v, const size_t idx, const void *vals,
+                           const size_t n) {
+  if (v == NULL || idx > v->meta.size || (vals == NULL && n > 0) ||
+      n > SIZE_MAX - v->meta.size || !vbuf_reserve(v, v->meta.size + n)) {
+    return false;
+  }
+  const size_t memsz = v->meta.memsz;
+  memmove(vidx(v, idx + n), vidx(v, idx), memsz * (v->meta.size - idx));
+  if (n > 0) {
+    memcpy(vidx(v, idx), vals, memsz * n);
+  }
+  v->meta.size += n;
+  return true;
+}
+
+
+bool CADT_Vec_append_n(CADT_Vec *v, const void *vals, const size_t n) {
+  return v != NULL && CADT_Vec_insert_range(v, v->meta.size, vals, n);
+}
+
+
+/* append raw bytes, nbyte must be a whole number of elements */
+bool CADT_Vec_extend_from_buffer(CADT_Vec *v, const void *buf,
+                                 const size_t nbyte) {
+  if (v == NULL || v->meta.memsz == 0 || nbyte % v->meta.memsz != 0) {
+    return false;
+  }
+  return CADT_Vec_insert_range(v, v->meta.size, buf, nbyte / v->meta.memsz);
+}
+
+
+/* set the size of v without initializing new elements. it returns the
+ * first element past the old size, for the caller to fill in, or NULL if
+ * the buffer could not grow. */
+void *CADT_Vec_resize_uninit(CADT_Vec *v, const size_t size) {
+  if (v == NULL || !vbuf_reserve(v, size)) {
+    return NULL;
+  }
+  const size_t old = v->meta.size;
+  v->meta.size = size;
+  if (size < old) {
+    vbuf_trim(v);
+  }
+  return vidx(v, old < size ? old : size);
 }
 
 
@@ -187,34 +302,27 @@ CADT_Vec *CADT_Vec_concat(CADT_Vec *v1, CADT_Vec *v2) {
   }
   const size_t sz = v1->meta.size + v2->meta.size;
   const size_t memsz = v1->meta.memsz;
-  CADT_Vec *vector = vecalloc(sz, memsz);
+  CADT_Vec *vector =
+      vecalloc(sz, memsz, CADT_VEC_INLINE_BYTES, v1->alloc);
+  if (vector == NULL) {
+    return NULL;
+  }
 
-  assert(vector->meta.len > vector->meta.size);
+  assert(vector->meta.len >= vector->meta.size);
   assert(vector->meta.size == sz);
 
-  memcpy(vector->buf, v1->buf, vmemspace(v1));
-  memcpy((unsigned char *)vector->buf + v1->meta.size, v2->buf, vmemspace(v2));
+  memcpy(vector->buf, v1->buf, v1->meta.size * memsz);
+  memcpy(vidx(vector, v1->meta.size), v2->buf, v2->meta.size * memsz);
 
   return vector;
 }
 
 
-bool CADT_Vec_contains(CADT_Vec *v, const void *const val) {
-  size_t memsz = v->meta.memsz;
-  unsigned char *p = (unsigned char *)v->buf;
-  unsigned char *buffer_end = p + v->meta.size;
-  for (; p < buffer_end; p++) {
-    if (memcmp(val, p, memsz)) {
-      return 1;
-    }
-  }
-  return -1;
-}
-
-
+/* make room for size elements without changing the size of v */
 void CADT_Vec_reserve(CADT_Vec *v, const size_t size) {
-  v->meta.size = size;
-  vbuf_resize(v);
+  if (size > v->meta.len) {
+    vbuf_realloc(v, size);
+  }
 }
 
 
@@ -231,6 +339,11 @@ void *const CADT_Vec_end(CADT_Vec *const v) {
 
 
 void CADT_Vec_free(CADT_Vec *v) {
-  free(v->buf);
-  free(v);
+  const CADT_Allocator a = *v->alloc; /* may live in the block of v */
+  if (v->map != NULL) {
+    v->map->release(v);
+  } else if (!vinline(v)) {
+    CADT_free_(&a, v->buf);
+  }
+  CADT_free_(&a, v);
 }
@@ -1,19 +1,45 @@
 #ifndef _CADT_VECTOR
 #define _CADT_VECTOR
 
+#include "allocator.h"
 #include "cadt.h"
+#include "tvector.h"
 #include <stddef.h>
 #include <stdlib.h>
-#define SZ_LEN_RATIO 1.65
-#define SHRINK_THRESHOLD 2
+/* same growth policy as the vectors of CADT_VEC_DEFINE */
+#define SZ_LEN_RATIO CADT_VEC_GROWTH
+#define SHRINK_THRESHOLD CADT_VEC_SHRINK_RATIO
+/* inline storage of a vector from CADT_Vec_new, enough for the handful of
+ * elements most vectors hold */
+#define CADT_VEC_INLINE_BYTES 64
 
+/* a mapped vector reserves address space up front and commits it as it
+ * grows, so buf never moves. set up by vecmap.c. */
+struct VecMap_ {
+  void *addr;       /* the reserved mapping, buf points here */
+  size_t reserved;  /* bytes of address space from addr */
+  size_t committed; /* bytes usable from addr */
+  size_t page;      /* commit granularity */
+  int fd;           /* backing file, -1 for anonymous memory */
+  bool (*commit)(struct CADT_Vec *, const size_t nbyte);
+  void (*release)(struct CADT_Vec *);
+};
+
+/* meta, buf and the first inline elements share a cache line. anything
+ * rare lives behind a pointer: the allocator, copied to the end of the
+ * block unless it is the standard one, and the mapping. */
 typedef struct CADT_Vec {
   struct {
-    size_t len;   /* length of the buffer */
+    size_t len;   /* length of the buffer, the inline capacity until it
+                     outgrows it */
     size_t size;  /* amount of element currently stored. */
     size_t memsz; /* size of the type stored */
   } meta;
-  void *buf; /* buffer for storage */
+  void *buf; /* buffer for storage, inl until it outgrows it */
+  const CADT_Allocator *alloc;
+  struct VecMap_ *map; /* NULL unless buf is a reserved mapping */
+  /* inline storage allocated in one block with the vector */
+  _Alignas(max_align_t) unsigned char inl[];
 } CADT_Vec;
 
 #endif /* ifndef SYMBOL */
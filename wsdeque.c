@@ -0,0 +1,338 @@
+/* A work stealing deque of task pointers after Chase and Lev, with the
+ * C11 memory orderings of Le et al. The owner thread pushes and pops at
+ * one end with plain loads and stores and a fence; other threads steal
+ * from the other end with a CAS. The ring doubles when full.
+ * CADT_parallel_for splits a range into tasks on such deques, one per
+ * worker, so idle workers steal halves of ranges from busy ones. */
+
+#define _POSIX_C_SOURCE 200809L
+#include "wsdeque.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define CADT_WSDEQUE_MIN_SLOTS 64
+
+
+static WSBuf_ *wbuf(const int64_t slots) {
+  WSBuf_ *b = (WSBuf_ *)malloc(sizeof(WSBuf_) + slots * sizeof(void *));
+  if (b == NULL) {
+    return NULL;
+  }
+  b->prev = NULL;
+  b->mask = slots - 1;
+  return b;
+}
+
+
+static void *wget(WSBuf_ *b, const int64_t i) {
+  return atomic_load_explicit(&b->slots[i & b->mask], memory_order_relaxed);
+}
+
+
+static void wput(WSBuf_ *b, const int64_t i, void *task) {
+  atomic_store_explicit(&b->slots[i & b->mask], task, memory_order_relaxed);
+}
+
+
+/* copy [top, bottom) into a ring twice as long. owner only */
+static WSBuf_ *wgrow(CADT_WSDeque *const d, WSBuf_ *old, const int64_t top,
+                     const int64_t bottom) {
+  WSBuf_ *b = wbuf((old->mask + 1) * 2);
+  if (b == NULL) {
+    return NULL;
+  }
+  for (int64_t i = top; i < bottom; i++) {
+    wput(b, i, wget(old, i));
+  }
+  b->prev = old;
+  atomic_store_explicit(&d->buf, b, memory_order_release);
+  return b;
+}
+
+
+/*-- interface --*/
+
+/* capacity is a hint, the deque grows as needed */
+CADT_WSDeque *CADT_WSDeque_new(const size_t capacity) {
+  int64_t slots = CADT_WSDEQUE_MIN_SLOTS;
+  while ((size_t)slots < capacity && slots < INT64_MAX / 2) {
+    slots *= 2;
+  }
+  CADT_WSDeque *d = (CADT_WSDeque *)aligned_alloc(_Alignof(CADT_WSDeque),
+                                                  sizeof(CADT_WSDeque));
+  if (d == NULL) {
+    return NULL;
+  }
+  WSBuf_ *b = wbuf(slots);
+  if (b == NULL) {
+    free(d);
+    return NULL;
+  }
+  atomic_init(&d->top, 0);
+  atomic_init(&d->bottom, 0);
+  atomic_init(&d->buf, b);
+  return d;
+}
+
+
+/* owner only. task must not be NULL, false if the ring could not grow */
+bool CADT_WSDeque_push(CADT_WSDeque *d, void *task) {
+  if (d == NULL || task == NULL) {
+    return false;
+  }
+  const int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  const int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  WSBuf_ *buf = atomic_load_explicit(&d->buf, memory_order_relaxed);
+  if (b - t > buf->mask) {
+    buf = wgrow(d, buf, t, b);
+    if (buf == NULL) {
+      return false;
+    }
+  }
+  wput(buf, b, task);
+  /* a release store in place of the paper's release fence: no dearer,
+   * and thread sanitizer can follow it */
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+  return true;
+}
+
+
+/* owner only. the most recently pushed task, NULL if empty */
+void *CADT_WSDeque_pop(CADT_WSDeque *d) {
+  if (d == NULL) {
+    return NULL;
+  }
+  const int64_t b =
+      atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  WSBuf_ *buf = atomic_load_explicit(&d->buf, memory_order_relaxed);
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+  void *task = NULL;
+  if (t <= b) {
+    task = wget(buf, b);
+    if (t == b) {
+      /* the last task, thieves may be after it too */
+      if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                   memory_order_seq_cst,
+                                                   memory_order_relaxed)) {
+        task = NULL;
+      }
+      atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+  } else {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+  return task;
+}
+
+
+/* any thread. the oldest task, NULL if empty or if another thread took it
+ * first */
+void *CADT_WSDeque_steal(CADT_WSDeque *d) {
+  if (d == NULL) {
+    return NULL;
+  }
+  int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  const int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+  if (t >= b) {
+    return NULL;
+  }
+  WSBuf_ *buf = atomic_load_explicit(&d->buf, memory_order_acquire);
+  void *task = wget(buf, t);
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return NULL;
+  }
+  return task;
+}
+
+
+/* a snapshot, it may be stale by the time it returns */
+size_t CADT_WSDeque_size(CADT_WSDeque *d) {
+  if (d == NULL) {
+    return 0;
+  }
+  const int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  const int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+  return b > t ? (size_t)(b - t) : 0;
+}
+
+
+/* no other thread may use d any more */
+void CADT_WSDeque_free(CADT_WSDeque *d) {
+  if (d == NULL) {
+    return;
+  }
+  WSBuf_ *b = atomic_load_explicit(&d->buf, memory_order_relaxed);
+  while (b != NULL) {
+    WSBuf_ *prev = b->prev;
+    free(b);
+    b = prev;
+  }
+  free(d);
+}
+
+
+/*-- parallel for --*/
+
+typedef struct Range_ {
+  size_t lo;
+  size_t hi;
+} Range_;
+
+/* state shared by the workers of one CADT_parallel_for call */
+typedef struct PFor_ {
+  CADT_WSDeque **deques; /* one per worker */
+  size_t nworkers;
+  Range_ *ranges; /* every task is a range carved from here */
+  atomic_size_t nranges;
+  atomic_size_t done; /* indices processed so far */
+  size_t total;
+  size_t grain;
+  CADT_RangeFn fn;
+  void *arg;
+} PFor_;
+
+typedef struct Worker_ {
+  PFor_ *pf;
+  size_t id;
+} Worker_;
+
+
+static Range_ *pfsteal(PFor_ *const pf, const size_t self, uint64_t *rng) {
+  for (size_t i = 0; i < pf->nworkers; i++) {
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 7;
+    *rng ^= *rng << 17;
+    const size_t victim = (size_t)(*rng % pf->nworkers);
+    if (victim == self) {
+      continue;
+    }
+    Range_ *r = (Range_ *)CADT_WSDeque_steal(pf->deques[victim]);
+    if (r != NULL) {
+      return r;
+    }
+  }
+  return NULL;
+}
+
+
+/* keep the left half of r and offer the right half to thieves, until r
+ * is no longer than the grain. then run it. a half that cannot be pushed
+ * is run right away. */
+static void pfrun(PFor_ *const pf, CADT_WSDeque *const own, Range_ *r) {
+  while (r->hi - r->lo > pf->grain) {
+    const size_t mid = r->lo + (r->hi - r->lo) / 2;
+    Range_ *right = &pf->ranges[atomic_fetch_add_explicit(
+        &pf->nranges, 1, memory_order_relaxed)];
+    right->lo = mid;
+    right->hi = r->hi;
+    r->hi = mid;
+    if (!CADT_WSDeque_push(own, right)) {
+      pfrun(pf, own, right);
+    }
+  }
+  pf->fn(r->lo, r->hi, pf->arg);
+  atomic_fetch_add_explicit(&pf->done, r->hi - r->lo, memory_order_release);
+}
+
+
+static void *pfworker(void *arg) {
+  Worker_ *w = (Worker_ *)arg;
+  PFor_ *pf = w->pf;
+  CADT_WSDeque *own = pf->deques[w->id];
+  uint64_t rng = 0x9e3779b97f4a7c15ull * (w->id + 1);
+  while (atomic_load_explicit(&pf->done, memory_order_acquire) < pf->total) {
+    Range_ *r = (Range_ *)CADT_WSDeque_pop(own);
+    if (r == NULL) {
+      r = pfsteal(pf, w->id, &rng);
+    }
+    if (r == NULL) {
+      sched_yield();
+      continue;
+    }
+    pfrun(pf, own, r);
+  }
+  return NULL;
+}
+
+
+/* call fn on disjoint subranges covering [begin, end), each at most grain
+ * long, from nthreads threads including the caller. 0 threads means one
+ * per online cpu. returns once every call has returned, false if the
+ * threads could not be set up, in which case fn was not called. */
+bool CADT_parallel_for(const size_t begin, const size_t end,
+                       const size_t grain, size_t nthreads, CADT_RangeFn fn,
+                       void *arg) {
+  if (fn == NULL || begin > end) {
+    return false;
+  }
+  if (begin == end) {
+    return true;
+  }
+  if (nthreads == 0) {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = n > 0 ? (size_t)n : 1;
+  }
+
+  PFor_ pf;
+  pf.total = end - begin;
+  pf.grain = grain ? grain : 1;
+  pf.nworkers = nthreads;
+  pf.fn = fn;
+  pf.arg = arg;
+  atomic_init(&pf.nranges, 1);
+  atomic_init(&pf.done, 0);
+  /* halving a range longer than the grain leaves pieces of at least
+   * (grain + 1) / 2, which bounds the number of ranges */
+  const size_t half = (pf.grain + 1) / 2;
+  const size_t maxranges = pf.total / half + 2;
+  pf.ranges = (Range_ *)malloc(maxranges * sizeof(Range_));
+  pf.deques = (CADT_WSDeque **)calloc(nthreads, sizeof(CADT_WSDeque *));
+  Worker_ *workers = (Worker_ *)malloc(nthreads * sizeof(Worker_));
+  pthread_t *threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+  bool ok = pf.ranges != NULL && pf.deques != NULL && workers != NULL &&
+            threads != NULL;
+  for (size_t i = 0; ok && i < nthreads; i++) {
+    pf.deques[i] = CADT_WSDeque_new(0);
+    workers[i].pf = &pf;
+    workers[i].id = i;
+    ok = pf.deques[i] != NULL;
+  }
+
+  size_t started = 1;
+  if (ok) {
+    pf.ranges[0].lo = begin;
+    pf.ranges[0].hi = end;
+    ok = CADT_WSDeque_push(pf.deques[0], &pf.ranges[0]);
+  }
+  if (ok) {
+    while (started < nthreads &&
+           pthread_create(&threads[started], NULL, pfworker,
+                          &workers[started]) == 0) {
+      started++;
+    }
+    /* the caller is worker 0, fewer threads than asked still finish */
+    pfworker(&workers[0]);
+    for (size_t i = 1; i < started; i++) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  for (size_t i = 0; pf.deques != NULL && i < nthreads; i++) {
+    CADT_WSDeque_free(pf.deques[i]);
+  }
+  free(pf.deques);
+  free(pf.ranges);
+  free(workers);
+  free(threads);
+  return ok;
+}
+
+#undef CADT_WSDEQUE_MIN_SLOTS
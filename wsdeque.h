@@ -0,0 +1,26 @@
+#ifndef _CADT_WSDEQUE
+#define _CADT_WSDEQUE
+
+#include "allocator.h"
+#include "cadt.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* a ring of task pointers. a buffer that was grown out of stays on the
+ * prev chain until the deque is freed, a thief may still be reading it. */
+typedef struct WSBuf_ {
+  struct WSBuf_ *prev;
+  int64_t mask; /* slots - 1, slots is a power of 2 */
+  _Atomic(void *) slots[];
+} WSBuf_;
+
+/* Chase-Lev deque. the owner pushes and pops at bottom, thieves take from
+ * top. tasks live in [top, bottom). only the pop of the last task and
+ * steals race on top, with a CAS. */
+typedef struct CADT_WSDeque {
+  _Alignas(CADT_CACHELINE) _Atomic int64_t top;
+  _Alignas(CADT_CACHELINE) _Atomic int64_t bottom;
+  _Atomic(WSBuf_ *) buf;
+} CADT_WSDeque;
+
+#endif /* ifndef _CADT_WSDEQUE */